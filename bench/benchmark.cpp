@@ -0,0 +1,425 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "benchmark.h"
+#include "blacklist.h"
+#include "downloader.h"
+#include "galaxyapi.h"
+#include "globalconstants.h"
+#include "globals.h"
+#include "util.h"
+#include "ziputil.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/filtering_streambuf.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/regex.hpp>
+#include <json/json.h>
+#include <rhash.h>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Defined in main.cpp of lgogdownloader, benchmarks use default configuration
+Config Globals::globalConfig;
+ChecksumStore Globals::checksumStore;
+Metrics Globals::metrics;
+EventLog Globals::eventLog;
+Tracer Globals::tracer;
+
+struct benchmarkDefinition
+{
+    const char* name;
+    std::function<void(BenchmarkState&)> function;
+};
+
+bool BenchmarkState::keepRunning()
+{
+    if (!bStarted_)
+    {
+        bStarted_ = true;
+        start_ = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    iterations_++;
+    seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    return seconds_ < min_time_;
+}
+
+// Deterministic pseudo random numbers so that fixtures are the same on every run
+class benchmarkRandom
+{
+    public:
+        uint32_t next()
+        {
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 17;
+            state_ ^= state_ << 5;
+            return state_;
+        }
+    private:
+        uint32_t state_ = 2463534242u;
+};
+
+static std::string hexString(benchmarkRandom& random, const unsigned int& length)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string str(length, '0');
+    for (auto& c : str)
+        c = digits[random.next() & 0x0F];
+    return str;
+}
+
+// Data that compresses roughly as well as typical game data files
+static std::vector<char> makeGameData(const uintmax_t& size)
+{
+    benchmarkRandom random;
+    std::vector<char> data(size);
+    for (uintmax_t i = 0; i < size; ++i)
+    {
+        uint32_t r = random.next();
+        data[i] = (r & 0x300) ? static_cast<char>(i % 64) : static_cast<char>(r);
+    }
+    return data;
+}
+
+static std::string makeGamePath(benchmarkRandom& random, const std::string& separator)
+{
+    static const std::vector<std::string> dirs = { "data", "textures", "sounds", "maps", "models", "scripts", "locale", "movies" };
+    static const std::vector<std::string> extensions = { ".pak", ".dds", ".ogg", ".bin", ".lua", ".dat", ".bik" };
+    std::string path = "game";
+    unsigned int depth = 1 + random.next() % 4;
+    for (unsigned int i = 0; i < depth; ++i)
+        path += separator + dirs[random.next() % dirs.size()] + std::to_string(random.next() % 32);
+    path += separator + "file" + std::to_string(random.next() % 100000) + extensions[random.next() % extensions.size()];
+    return path;
+}
+
+static void writeLE(std::string& str, uint64_t value, const unsigned int& bytes)
+{
+    for (unsigned int i = 0; i < bytes; ++i)
+    {
+        str.push_back(static_cast<char>(value & 0xFF));
+        value >>= 8;
+    }
+}
+
+static void benchmarkChunkHash(BenchmarkState& state)
+{
+    std::vector<char> data = makeGameData(10 << 20);
+    state.setBytesProcessed(data.size());
+    while (state.keepRunning())
+        Util::getChunkHash(reinterpret_cast<unsigned char*>(data.data()), data.size(), RHASH_MD5);
+}
+
+static void benchmarkFileHashRange(BenchmarkState& state)
+{
+    std::vector<char> data = makeGameData(64 << 20);
+    boost::filesystem::path filepath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("lgogdownloader-benchmark-%%%%-%%%%");
+    {
+        std::ofstream ofs(filepath.string(), std::ofstream::out | std::ofstream::binary);
+        ofs.write(data.data(), data.size());
+    }
+
+    state.setBytesProcessed(data.size());
+    while (state.keepRunning())
+        Util::getFileHashRange(filepath.string(), RHASH_MD5);
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(filepath, ec);
+}
+
+static void benchmarkZlibDecompress(BenchmarkState& state)
+{
+    std::vector<char> data = makeGameData(10 << 20);
+    std::vector<char> compressed;
+    {
+        boost::iostreams::filtering_streambuf<boost::iostreams::output> output;
+        output.push(boost::iostreams::zlib_compressor(boost::iostreams::zlib_params(boost::iostreams::zlib::default_compression, boost::iostreams::zlib::deflated, GlobalConstants::ZLIB_WINDOW_SIZE)));
+        output.push(boost::iostreams::back_inserter(compressed));
+        boost::iostreams::write(output, data.data(), data.size());
+    }
+
+    std::vector<char> decompressed;
+    decompressed.reserve(data.size());
+    state.setBytesProcessed(data.size());
+    while (state.keepRunning())
+    {
+        decompressed.clear();
+        boost::iostreams::filtering_streambuf<boost::iostreams::output> output;
+        output.push(boost::iostreams::zlib_decompressor(GlobalConstants::ZLIB_WINDOW_SIZE));
+        output.push(boost::iostreams::back_inserter(decompressed));
+        boost::iostreams::write(output, compressed.data(), compressed.size());
+    }
+}
+
+static void benchmarkReadZipCDEntry(BenchmarkState& state)
+{
+    const unsigned int entries = 100000;
+    benchmarkRandom random;
+    std::string cd;
+    for (unsigned int i = 0; i < entries; ++i)
+    {
+        std::string filename = "data/noarch/" + makeGamePath(random, "/");
+        std::string extra;
+        writeLE(extra, ZIP_EXTENDED_TIMESTAMP, 2);
+        writeLE(extra, 5, 2);
+        writeLE(extra, 1, 1);
+        writeLE(extra, 1500000000 + random.next() % 100000000, 4);
+
+        writeLE(cd, ZIP_CD_HEADER_SIGNATURE, 4);
+        writeLE(cd, 0x031E, 2); // version made by
+        writeLE(cd, 20, 2); // version needed
+        writeLE(cd, 0, 2); // flag
+        writeLE(cd, 8, 2); // compression method
+        writeLE(cd, 0x6000, 2); // mod time
+        writeLE(cd, 0x4A21, 2); // mod date
+        writeLE(cd, random.next(), 4); // crc32
+        writeLE(cd, random.next() % (1 << 24), 4); // compressed size
+        writeLE(cd, random.next() % (1 << 26), 4); // uncompressed size
+        writeLE(cd, filename.size(), 2);
+        writeLE(cd, extra.size(), 2);
+        writeLE(cd, 0, 2); // comment length
+        writeLE(cd, 0, 2); // disk number
+        writeLE(cd, 0, 2); // internal attributes
+        writeLE(cd, 0100644u << 16, 4); // external attributes
+        writeLE(cd, random.next(), 4); // local header offset
+        cd += filename + extra;
+    }
+
+    state.setBytesProcessed(cd.size());
+    state.setItemsProcessed(entries);
+    while (state.keepRunning())
+    {
+        std::istringstream stream(cd);
+        for (unsigned int i = 0; i < entries; ++i)
+            ZipUtil::readZipCDEntry(&stream);
+    }
+}
+
+static void benchmarkBlacklist(BenchmarkState& state)
+{
+    benchmarkRandom random;
+    std::vector<std::string> lines;
+    for (unsigned int i = 0; i < 300; ++i)
+    {
+        std::string gamename = "game_" + std::to_string(i);
+        switch (i % 4)
+        {
+            case 0: // Exact file
+                lines.push_back("Rp " + gamename + "/setup_" + gamename + "_1\\.0\\.exe");
+                break;
+            case 1: // Everything of game
+                lines.push_back("Rp " + gamename + "/.*");
+                break;
+            case 2: // File type
+                lines.push_back("Rp .*_" + std::to_string(i) + "\\.pdf");
+                break;
+            default: // Real regex
+                lines.push_back("Rp " + gamename + "/(patch|setup)_.*_[0-9]+\\.(bin|exe)");
+                break;
+        }
+    }
+    Blacklist blacklist;
+    blacklist.initialize(lines);
+
+    std::vector<std::string> paths;
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        std::string gamename = "game_" + std::to_string(random.next() % 3000);
+        paths.push_back(gamename + "/setup_" + gamename + "_" + std::to_string(random.next() % 10) + ".0.exe");
+    }
+
+    state.setItemsProcessed(paths.size());
+    unsigned int matched = 0;
+    while (state.keepRunning())
+    {
+        for (auto& path : paths)
+            matched += blacklist.isBlacklisted(path);
+    }
+    if (matched == 0)
+        std::cerr << "Blacklist benchmark didn't match any paths" << std::endl;
+}
+
+static void benchmarkDepotManifest(BenchmarkState& state)
+{
+    const unsigned int items = 500000;
+    benchmarkRandom random;
+    std::string manifest = "{\"depot\":{\"items\":[";
+    for (unsigned int i = 0; i < items; ++i)
+    {
+        if (i > 0)
+            manifest += ",";
+        std::string path = makeGamePath(random, "\\\\"); // Escaped backslash
+        manifest += "{\"chunks\":[";
+        unsigned int chunks = 1 + (random.next() % 8 == 0 ? random.next() % 4 : 0);
+        for (unsigned int j = 0; j < chunks; ++j)
+        {
+            if (j > 0)
+                manifest += ",";
+            manifest += "{\"compressedMd5\":\"" + hexString(random, 32) + "\",\"compressedSize\":" + std::to_string(random.next() % (1 << 20))
+                      + ",\"md5\":\"" + hexString(random, 32) + "\",\"size\":" + std::to_string(random.next() % (1 << 20)) + "}";
+        }
+        manifest += "],\"md5\":\"" + hexString(random, 32) + "\",\"path\":\"" + path + "\",\"type\":\"DepotFile\"}";
+    }
+    manifest += "]},\"version\":2}";
+
+    state.setBytesProcessed(manifest.size());
+    state.setItemsProcessed(items);
+    while (state.keepRunning())
+    {
+        std::string error;
+        galaxyAPI::getDepotItemsVectorFromManifest(manifest, false, error);
+        if (!error.empty())
+        {
+            std::cerr << "Failed to parse depot manifest: " << error << std::endl;
+            return;
+        }
+    }
+}
+
+static void benchmarkGameDetailsFromJson(BenchmarkState& state)
+{
+    const unsigned int games = 1000;
+    benchmarkRandom random;
+    Json::Value root(Json::arrayValue);
+    for (unsigned int i = 0; i < games; ++i)
+    {
+        std::string gamename = "game_" + std::to_string(i);
+        Json::Value game;
+        game["gamename"] = gamename;
+        game["title"] = "Game " + std::to_string(i);
+        game["product_id"] = std::to_string(1000000000 + i);
+        game["icon"] = "https://images.gog.com/" + hexString(random, 64) + ".png";
+
+        const std::vector<std::string> nodes = { "installers", "extras", "patches", "languagepacks" };
+        for (auto& node : nodes)
+        {
+            unsigned int count = (node == "installers" || node == "extras") ? 4 + random.next() % 8 : random.next() % 3;
+            for (unsigned int j = 0; j < count; ++j)
+            {
+                Json::Value file;
+                file["id"] = node.substr(0, node.size() - 1) + std::to_string(j);
+                file["name"] = "setup_" + gamename + "_" + std::to_string(j) + ".exe";
+                file["path"] = "/" + gamename + "/setup_" + gamename + "_" + std::to_string(j) + ".exe";
+                file["size"] = std::to_string(random.next());
+                file["updated"] = 0;
+                file["platform"] = 1u << (random.next() % 3);
+                file["language"] = 1u << (random.next() % 4);
+                file["silent"] = 0;
+                file["gamename"] = gamename;
+                file["title"] = "Game " + std::to_string(i);
+                file["type"] = 1u << (random.next() % 4);
+                file["version"] = "1." + std::to_string(j);
+                game[node].append(file);
+            }
+        }
+        root.append(game);
+    }
+
+    state.setItemsProcessed(games);
+    while (state.keepRunning())
+        Downloader::getGameDetailsFromJsonNode(root);
+}
+
+static const std::vector<benchmarkDefinition> BENCHMARKS =
+{
+    { "Util::getChunkHash/md5/10MiB", benchmarkChunkHash },
+    { "Util::getFileHashRange/md5/64MiB", benchmarkFileHashRange },
+    { "zlib_decompressor/10MiB", benchmarkZlibDecompress },
+    { "ZipUtil::readZipCDEntry/100k", benchmarkReadZipCDEntry },
+    { "Blacklist::isBlacklisted/300rules/1k", benchmarkBlacklist },
+    { "galaxyAPI::getDepotItemsVectorFromManifest/500k", benchmarkDepotManifest },
+    { "Downloader::getGameDetailsFromJsonNode/1000", benchmarkGameDetailsFromJson }
+};
+
+static std::string formatRate(const double& rate, const std::string& unit)
+{
+    static const std::vector<std::string> prefixes = { "", "k", "M", "G", "T" };
+    double value = rate;
+    unsigned int i = 0;
+    while (value >= 1000 && i < prefixes.size() - 1)
+    {
+        value /= 1000;
+        ++i;
+    }
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(2) << value << " " << prefixes[i] << unit;
+    return ss.str();
+}
+
+int Benchmark::run(const std::string& filter, const double& min_time)
+{
+    boost::regex expression;
+    try
+    {
+        expression.assign(filter.empty() ? ".*" : filter, boost::regex::perl | boost::regex::icase);
+    }
+    catch (const boost::regex_error& e)
+    {
+        std::cerr << "Invalid benchmark filter: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << std::left << std::setw(56) << "Benchmark" << std::right << std::setw(16) << "ns/op" << std::setw(12) << "Iterations" << std::setw(16) << "Bytes/s" << std::setw(16) << "Items/s" << std::endl;
+    std::cout << std::string(116, '-') << std::endl;
+
+    unsigned int iRun = 0;
+    for (auto& benchmark : BENCHMARKS)
+    {
+        if (!boost::regex_search(benchmark.name, expression))
+            continue;
+
+        BenchmarkState state(min_time);
+        benchmark.function(state);
+        ++iRun;
+        if (state.iterations() == 0)
+            continue;
+
+        double ns_per_op = state.seconds() * 1e9 / state.iterations();
+        double ops_per_second = state.iterations() / state.seconds();
+        std::cout << std::left << std::setw(56) << benchmark.name << std::right
+                  << std::setw(16) << static_cast<uintmax_t>(ns_per_op)
+                  << std::setw(12) << state.iterations()
+                  << std::setw(16) << (state.bytesPerIteration() ? formatRate(ops_per_second * state.bytesPerIteration(), "B/s") : "")
+                  << std::setw(16) << (state.itemsPerIteration() ? formatRate(ops_per_second * state.itemsPerIteration(), "/s") : "")
+                  << std::endl;
+    }
+
+    if (iRun == 0)
+    {
+        std::cerr << "No benchmarks match " << filter << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string filter = ".*";
+    if (argc > 1)
+    {
+        std::string arg = argv[1];
+        if (argc > 2 || arg == "-h" || arg == "--help")
+        {
+            std::cout << "Usage: " << argv[0] << " [regex]" << std::endl
+                      << "Run microbenchmarks whose name matches regex (Perl syntax, case insensitive)" << std::endl;
+            return argc > 2 ? 1 : 0;
+        }
+        filter = arg;
+    }
+
+    rhash_library_init();
+    return Benchmark::run(filter);
+}
@@ -0,0 +1,51 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Runs benchmark loop until minimum time has elapsed
+// Usage:
+//     while (state.keepRunning())
+//         kernel();
+class BenchmarkState
+{
+    public:
+        BenchmarkState(const double& min_time) : min_time_(min_time) {};
+
+        bool keepRunning();
+        void setBytesProcessed(const uintmax_t& bytes_per_iteration) { bytes_per_iteration_ = bytes_per_iteration; }
+        void setItemsProcessed(const uintmax_t& items_per_iteration) { items_per_iteration_ = items_per_iteration; }
+
+        uintmax_t iterations() const { return iterations_; }
+        double seconds() const { return seconds_; }
+        uintmax_t bytesPerIteration() const { return bytes_per_iteration_; }
+        uintmax_t itemsPerIteration() const { return items_per_iteration_; }
+    private:
+        double min_time_;
+        bool bStarted_ = false;
+        double seconds_ = 0;
+        uintmax_t iterations_ = 0;
+        uintmax_t bytes_per_iteration_ = 0;
+        uintmax_t items_per_iteration_ = 0;
+        std::chrono::steady_clock::time_point start_;
+};
+
+// Microbenchmarks of CPU bound code on hot paths using synthetic data
+// Built as lgogdownloader-bench with -DBUILD_BENCHMARKS=ON
+// Runs offline and doesn't need login
+namespace Benchmark
+{
+    // Run benchmarks whose name matches filter regex and print results
+    // Returns 0 on success
+    int run(const std::string& filter, const double& min_time = 1.0);
+}
+
+#endif // BENCHMARK_H
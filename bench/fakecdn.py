@@ -0,0 +1,467 @@
+#!/usr/bin/env python3
+# This program is free software. It comes without any warranty, to
+# the extent permitted by applicable law. You can redistribute it
+# and/or modify it under the terms of the Do What The Fuck You Want
+# To Public License, Version 2, as published by Sam Hocevar. See
+# http://www.wtfpl.net/ for more details.
+
+"""Local stand-in for GOG website, api, content-system and cdn hosts
+
+Serves one synthetic product so that lgogdownloader can download installers,
+repair them and install Galaxy and MojoSetup builds without network access.
+All hosts are served from the same port. Point lgogdownloader at it with
+--connect-to ::127.0.0.1:PORT and --cacert CERT.
+
+Content is generated from a fixed seed at startup:
+  - Galaxy v2 build: builds list, zlib compressed build and depot manifests,
+    secure link and zlib compressed 1 MiB chunks
+  - Windows installer with downlink JSON and checksum XML
+  - Linux MojoSetup installer (shell stub followed by zip) with downlink JSON
+    and checksum XML, served with range requests
+
+Latency, per connection bandwidth, HTTP errors and dropped connections can be
+injected. Errors and drops only affect content (chunks and installers) unless
+--fault-api is given.
+
+Control endpoints on any host:
+  /__stats    request counts and bytes sent per category as JSON
+  /__reset    reset counters
+  /__expected expected output files { relative path: md5 } per scenario
+"""
+
+import argparse
+import hashlib
+import io
+import json
+import random
+import re
+import socketserver
+import ssl
+import sys
+import threading
+import time
+import zipfile
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import urlsplit
+
+PRODUCT_ID = "1207650001"
+SLUG = "bench_game"
+TITLE = "Bench Game"
+INSTALL_DIRECTORY = "Bench Game"
+BUILD_ID = "51000001"
+GALAXY_CHUNK_SIZE = 1 << 20
+XML_CHUNK_SIZE = 10 << 20
+WINDOWS_INSTALLER = "setup_bench_game_1.0.exe"
+LINUX_INSTALLER = "bench_game_1.0.sh"
+
+
+def md5(data):
+    return hashlib.md5(data).hexdigest()
+
+
+def galaxy_path(hash_):
+    return hash_[0:2] + "/" + hash_[2:4] + "/" + hash_
+
+
+def make_data(rng, size, compressibility):
+    """Pseudo-random data where roughly given fraction of each 64 KiB block is zeros"""
+    out = bytearray()
+    block = 64 << 10
+    while len(out) < size:
+        n = min(block, size - len(out))
+        zeros = int(n * compressibility)
+        out += rng.randbytes(n - zeros)
+        out += bytes(zeros)
+    return bytes(out)
+
+
+def make_checksum_xml(name, data):
+    chunks = []
+    for i, start in enumerate(range(0, len(data), XML_CHUNK_SIZE)):
+        end = min(start + XML_CHUNK_SIZE, len(data)) - 1
+        chunks.append('\t<chunk id="%d" from="%d" to="%d" method="md5">%s</chunk>'
+                      % (i, start, end, md5(data[start:end + 1])))
+    return ('<file name="%s" available="1" notavailablemsg="" md5="%s" chunks="%d" timestamp="2024-01-01 00:00:00" total_size="%d">\n%s\n</file>\n'
+            % (name, md5(data), len(chunks), len(data), "\n".join(chunks))).encode()
+
+
+class Catalog:
+    """Synthetic product and every response body that depends on it"""
+
+    def __init__(self, args):
+        rng = random.Random(args.seed)
+        self.meta = {}      # content-system/v2/meta path -> zlib compressed manifest
+        self.chunks = {}    # compressed md5 -> compressed chunk
+        self.files = {}     # installer filename -> data
+        self.xml = {}       # installer filename -> checksum XML
+        self.expected = {"galaxy": {}, "download": {}, "mojosetup": {}}
+
+        # Galaxy build
+        items = []
+        total_size = 0
+        compressed_size = 0
+        for i in range(args.galaxy_files):
+            path = "bin/file%03d.dat" % i
+            data = make_data(rng, args.galaxy_file_size, args.compressibility)
+            chunks = []
+            for start in range(0, len(data), GALAXY_CHUNK_SIZE):
+                chunk = data[start:start + GALAXY_CHUNK_SIZE]
+                compressed = zlib.compress(chunk, 6)
+                self.chunks[md5(compressed)] = compressed
+                chunks.append({"md5": md5(chunk), "size": len(chunk),
+                               "compressedMd5": md5(compressed), "compressedSize": len(compressed)})
+                compressed_size += len(compressed)
+            total_size += len(data)
+            items.append({"type": "DepotFile", "path": path, "chunks": chunks, "md5": md5(data)})
+            self.expected["galaxy"][path] = md5(data)
+
+        depot_hash = self.add_meta({"version": 2, "depot": {"items": items}})
+        build_hash = self.add_meta({
+            "version": 2,
+            "baseProductId": PRODUCT_ID,
+            "buildId": BUILD_ID,
+            "installDirectory": INSTALL_DIRECTORY,
+            "platform": "windows",
+            "products": [{"productId": PRODUCT_ID, "name": TITLE, "script": None, "temp_executable": ""}],
+            "depots": [{"productId": PRODUCT_ID, "languages": ["*"], "manifest": depot_hash,
+                        "size": total_size, "compressedSize": compressed_size}],
+            "dependencies": [],
+        })
+        self.builds = {
+            "total_count": 1, "count": 1,
+            "items": [{
+                "build_id": BUILD_ID, "product_id": PRODUCT_ID, "os": "windows", "branch": None,
+                "version_name": "1.0", "tags": [], "public": True, "date_published": "2024-01-01T00:00:00+0000",
+                "generation": 2, "link": "https://cdn.gog.com/content-system/v2/meta/" + galaxy_path(build_hash),
+            }],
+        }
+
+        # Windows installer
+        data = make_data(rng, args.installer_size, args.compressibility)
+        self.add_installer(WINDOWS_INSTALLER, data)
+        self.expected["download"][SLUG + "/" + WINDOWS_INSTALLER] = md5(data)
+
+        # Linux MojoSetup installer
+        zip_buffer = io.BytesIO()
+        with zipfile.ZipFile(zip_buffer, "w", zipfile.ZIP_DEFLATED, compresslevel=6) as zf:
+            for i in range(args.mojosetup_files):
+                path = "game/file%03d.dat" % i
+                data = make_data(rng, args.mojosetup_file_size, args.compressibility)
+                zf.writestr("data/noarch/" + path, data)
+                self.expected["mojosetup"][path] = md5(data)
+        stub = b"#!/bin/sh\n# MojoSetup installer stub for lgogdownloader benchmarks\nexit 0\n"
+        stub += b"\0" * (8192 - len(stub))
+        self.add_installer(LINUX_INSTALLER, stub + self.rebase_zip(zip_buffer.getvalue(), len(stub)))
+
+        self.product_info = {
+            "id": int(PRODUCT_ID), "title": TITLE, "slug": SLUG,
+            "images": {"icon": "//images.gog.com/bench_icon.png", "logo": "//images.gog.com/bench_logo.jpg"},
+            "dlcs": [],
+            "downloads": {
+                "installers": [
+                    self.installer_node("en1installer0", "windows", WINDOWS_INSTALLER),
+                    self.installer_node("en2installer0", "linux", LINUX_INSTALLER),
+                ],
+                "patches": [], "language_packs": [], "bonus_content": [],
+            },
+        }
+        self.product_list = {
+            "page": 1, "totalPages": 1, "totalProducts": 1, "productsPerPage": 100,
+            "products": [{
+                "id": int(PRODUCT_ID), "slug": SLUG, "title": TITLE, "isNew": False, "dlcCount": 0, "updates": 0,
+                "worksOn": {"Windows": True, "Mac": False, "Linux": True},
+            }],
+        }
+
+    def add_meta(self, manifest):
+        compressed = zlib.compress(json.dumps(manifest).encode(), 6)
+        hash_ = md5(compressed)
+        self.meta[galaxy_path(hash_)] = compressed
+        return hash_
+
+    def add_installer(self, name, data):
+        self.files[name] = data
+        self.xml[name] = make_checksum_xml(name, data)
+
+    def installer_node(self, file_id, os_, name):
+        return {
+            "id": file_id, "name": TITLE, "os": os_, "language": "en", "language_full": "English",
+            "version": "1.0", "total_size": len(self.files[name]),
+            "files": [{"id": file_id, "size": len(self.files[name]),
+                       "downlink": "https://api.gog.com/products/%s/downlink/installer/%s" % (PRODUCT_ID, file_id)}],
+        }
+
+    def downlink(self, file_id):
+        for node in self.product_info["downloads"]["installers"]:
+            if node["id"] == file_id:
+                name = WINDOWS_INSTALLER if node["os"] == "windows" else LINUX_INSTALLER
+                return {"downlink": "https://cdn.gog.com/secure/offline/%s/%s?token=bench" % (SLUG, name),
+                        "checksum": "https://cdn.gog.com/checksum/%s/%s.xml" % (SLUG, name)}
+        return None
+
+    @staticmethod
+    def rebase_zip(data, offset):
+        """Shift offsets of zip so that it can be appended to stub of given size like MojoSetup installers"""
+        eocd = data.rfind(b"PK\x05\x06")
+        count = int.from_bytes(data[eocd + 10:eocd + 12], "little")
+        cd_offset = int.from_bytes(data[eocd + 16:eocd + 20], "little")
+        out = bytearray(data)
+        out[eocd + 16:eocd + 20] = (cd_offset + offset).to_bytes(4, "little")
+        pos = cd_offset
+        for _ in range(count):
+            local_offset = int.from_bytes(out[pos + 42:pos + 46], "little")
+            out[pos + 42:pos + 46] = (local_offset + offset).to_bytes(4, "little")
+            pos += 46 + int.from_bytes(out[pos + 28:pos + 30], "little") \
+                      + int.from_bytes(out[pos + 30:pos + 32], "little") \
+                      + int.from_bytes(out[pos + 32:pos + 34], "little")
+        return bytes(out)
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.reset()
+
+    def reset(self):
+        with self.lock:
+            self.requests = {}
+            self.bytes = {}
+            self.errors = 0
+            self.drops = 0
+            self.unknown = []
+
+    def add(self, category, sent):
+        with self.lock:
+            self.requests[category] = self.requests.get(category, 0) + 1
+            self.bytes[category] = self.bytes.get(category, 0) + sent
+
+    def json(self):
+        with self.lock:
+            return {"requests": dict(self.requests), "bytes": dict(self.bytes), "errors": self.errors,
+                    "drops": self.drops, "unknown": list(self.unknown[-20:])}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        if self.server.args.verbose:
+            sys.stderr.write("%s %s\n" % (self.headers.get("Host", "-"), fmt % args))
+
+    def do_HEAD(self):
+        self.handle_request(send_body=False)
+
+    def do_GET(self):
+        self.handle_request(send_body=True)
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        if length:
+            self.rfile.read(length)
+        self.handle_request(send_body=True)
+
+    def handle_request(self, send_body):
+        url = urlsplit(self.path)
+        host = self.headers.get("Host", "").split(":")[0]
+        category, status, body, content_type = self.route(host, url.path, url.query)
+
+        if category == "control":
+            self.send_body(200, body, content_type, send_body)
+            return
+
+        args = self.server.args
+        rng = self.server.rng
+        is_content = category in ("chunk", "installer")
+        if args.latency > 0:
+            time.sleep(args.latency / 1000.0)
+
+        if status == 200 and (is_content or args.fault_api):
+            with self.server.rng_lock:
+                error = rng.random() < args.error_rate
+                drop = not error and rng.random() < args.drop_rate
+            if error:
+                with self.server.stats.lock:
+                    self.server.stats.errors += 1
+                self.server.stats.add(category, 0)
+                self.send_body(503, b"", "text/plain", send_body)
+                return
+        else:
+            drop = False
+
+        if status != 200:
+            if category == "unknown":
+                with self.server.stats.lock:
+                    self.server.stats.unknown.append(host + self.path)
+            self.server.stats.add(category, 0)
+            self.send_body(status, body, content_type, send_body)
+            return
+
+        # Range requests are used by repair and MojoSetup installs
+        start, end = 0, len(body) - 1
+        status = 200
+        match = re.match(r"bytes=(\d*)-(\d*)$", self.headers.get("Range", ""))
+        if match and body:
+            if match.group(1):
+                start = int(match.group(1))
+                if match.group(2):
+                    end = min(int(match.group(2)), len(body) - 1)
+            elif match.group(2):
+                start = max(0, len(body) - int(match.group(2)))
+            if start > end:
+                self.send_body(416, b"", "text/plain", send_body, {"Content-Range": "bytes */%d" % len(body)})
+                return
+            status = 206
+
+        headers = {"Content-Range": "bytes %d-%d/%d" % (start, end, len(body))} if status == 206 else {}
+        headers["Accept-Ranges"] = "bytes"
+        sent = self.send_body(status, memoryview(body)[start:end + 1], content_type, send_body, headers,
+                              bandwidth=args.bandwidth if is_content else 0, drop=drop)
+        self.server.stats.add(category, sent)
+
+    def send_body(self, status, body, content_type, send_body, headers=None, bandwidth=0, drop=False):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        for key, value in (headers or {}).items():
+            self.send_header(key, value)
+        self.end_headers()
+        if not send_body:
+            return 0
+
+        # Dropped connection ends after random part of body
+        limit = len(body)
+        if drop and len(body) > 1:
+            with self.server.rng_lock:
+                limit = self.server.rng.randrange(1, len(body))
+
+        sent = 0
+        block = 64 << 10
+        started = time.monotonic()
+        try:
+            while sent < limit:
+                n = min(block, limit - sent)
+                self.wfile.write(body[sent:sent + n])
+                sent += n
+                if bandwidth > 0:
+                    delay = sent / bandwidth - (time.monotonic() - started)
+                    if delay > 0:
+                        time.sleep(delay)
+            self.wfile.flush()
+        except (BrokenPipeError, ConnectionResetError, ssl.SSLError):
+            self.close_connection = True
+            return sent
+
+        if limit < len(body):
+            with self.server.stats.lock:
+                self.server.stats.drops += 1
+            self.close_connection = True
+        return sent
+
+    def route(self, host, path, query):
+        catalog = self.server.catalog
+        js = lambda obj: json.dumps(obj).encode()
+
+        if path == "/__stats":
+            return "control", 200, js(self.server.stats.json()), "application/json"
+        if path == "/__reset":
+            self.server.stats.reset()
+            return "control", 200, b"{}", "application/json"
+        if path == "/__expected":
+            return "control", 200, js(catalog.expected), "application/json"
+
+        if host == "www.gog.com" or host == "embed.gog.com":
+            if path == "/account":
+                return "api", 200, b"<html><body>account</body></html>", "text/html"
+            if path == "/user/data/games":
+                return "api", 200, js({"owned": [int(PRODUCT_ID)]}), "application/json"
+            if path == "/account/getFilteredProducts":
+                return "api", 200, js(catalog.product_list), "application/json"
+            if path == "/userData.json":
+                return "api", 200, js({"isLoggedIn": True, "userId": "1", "username": "bench"}), "application/json"
+            if path == "/account/gameDetails/%s.json" % PRODUCT_ID:
+                return "api", 200, js({"title": TITLE, "dlcs": []}), "application/json"
+
+        if host == "api.gog.com":
+            if path == "/products/" + PRODUCT_ID:
+                return "api", 200, js(catalog.product_info), "application/json"
+            match = re.match(r"/products/%s/downlink/installer/(\w+)$" % PRODUCT_ID, path)
+            if match and catalog.downlink(match.group(1)):
+                return "api", 200, js(catalog.downlink(match.group(1))), "application/json"
+
+        if host == "content-system.gog.com":
+            match = re.match(r"/products/%s/os/(\w+)/builds$" % PRODUCT_ID, path)
+            if match:
+                # Linux has no Galaxy builds so that lgogdownloader installs from MojoSetup installer
+                return "api", 200, js(catalog.builds if match.group(1) == "windows" else {}), "application/json"
+            if path == "/products/%s/secure_link" % PRODUCT_ID:
+                return "api", 200, js({
+                    "product_id": int(PRODUCT_ID), "type": "depot",
+                    "urls": [{"endpoint_name": "bench", "url_format": "{base_url}{path}",
+                              "parameters": {"base_url": "https://cdn.gog.com/content-system/v2/store", "path": "/" + PRODUCT_ID},
+                              "priority": 1, "max_fails": 100, "supports_generation": [2], "fallback_only": False}],
+                }), "application/json"
+
+        if host == "cdn.gog.com":
+            if path.startswith("/content-system/v2/meta/") and path[len("/content-system/v2/meta/"):] in catalog.meta:
+                return "manifest", 200, catalog.meta[path[len("/content-system/v2/meta/"):]], "application/octet-stream"
+            match = re.match(r"/content-system/v2/store/%s/\w\w/\w\w/(\w+)$" % PRODUCT_ID, path)
+            if match and match.group(1) in catalog.chunks:
+                return "chunk", 200, catalog.chunks[match.group(1)], "application/octet-stream"
+            match = re.match(r"/secure/offline/%s/([^/]+)$" % SLUG, path)
+            if match and match.group(1) in catalog.files:
+                return "installer", 200, catalog.files[match.group(1)], "application/octet-stream"
+            match = re.match(r"/checksum/%s/([^/]+)\.xml$" % SLUG, path)
+            if match and match.group(1) in catalog.xml:
+                return "xml", 200, catalog.xml[match.group(1)], "application/xml"
+
+        return "unknown", 404, b"", "text/plain"
+
+
+class Server(ThreadingHTTPServer):
+    daemon_threads = True
+    request_queue_size = 128
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Fake GOG API and CDN for lgogdownloader benchmarks")
+    parser.add_argument("--port", type=int, default=0, help="Port to listen on, 0 picks free port")
+    parser.add_argument("--cert", help="TLS certificate (PEM), serves plain HTTP if not set")
+    parser.add_argument("--key", help="TLS private key (PEM)")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--galaxy-files", type=int, default=16)
+    parser.add_argument("--galaxy-file-size", type=int, default=16 << 20)
+    parser.add_argument("--installer-size", type=int, default=256 << 20)
+    parser.add_argument("--mojosetup-files", type=int, default=64)
+    parser.add_argument("--mojosetup-file-size", type=int, default=4 << 20)
+    parser.add_argument("--compressibility", type=float, default=0.5, help="Fraction of generated data that is zeros")
+    parser.add_argument("--latency", type=float, default=0, help="Delay before every response in milliseconds")
+    parser.add_argument("--bandwidth", type=float, default=0, help="Bandwidth limit per connection in bytes/s for content")
+    parser.add_argument("--error-rate", type=float, default=0, help="Fraction of content requests answered with 503")
+    parser.add_argument("--drop-rate", type=float, default=0, help="Fraction of content responses cut off mid-body")
+    parser.add_argument("--fault-api", action="store_true", help="Inject errors and drops to API and manifest requests too")
+    parser.add_argument("--verbose", action="store_true", help="Log every request to stderr")
+    args = parser.parse_args()
+
+    server = Server(("127.0.0.1", args.port), Handler)
+    server.args = args
+    server.catalog = Catalog(args)
+    server.stats = Stats()
+    server.rng = random.Random(args.seed)
+    server.rng_lock = threading.Lock()
+    if args.cert:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(args.cert, args.key)
+        # Handshake is done by handler thread on first read so that slow client doesn't block accept
+        server.socket = context.wrap_socket(server.socket, server_side=True, do_handshake_on_connect=False)
+
+    # Driver reads port from first line
+    print("listening on %d" % server.server_address[1], flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+# This program is free software. It comes without any warranty, to
+# the extent permitted by applicable law. You can redistribute it
+# and/or modify it under the terms of the Do What The Fuck You Want
+# To Public License, Version 2, as published by Sam Hocevar. See
+# http://www.wtfpl.net/ for more details.
+
+"""Throughput benchmark of lgogdownloader against local fake GOG CDN
+
+Starts fakecdn.py with a self-signed certificate for gog.com hosts, runs
+lgogdownloader scenarios against it with --connect-to and reports for each
+scenario: wall time, MB/s of content received, CPU seconds per GB, peak RSS,
+request counts per category and whether output files match.
+
+Scenarios:
+  download   --download of Windows installer
+  repair     --repair --download after corrupting downloaded installer
+  galaxy     --galaxy-install of Windows Galaxy build
+  mojosetup  --galaxy-install of Linux build from MojoSetup installer
+
+Arguments after "--" are passed to every lgogdownloader run so that tuning
+flags can be compared, e.g.
+  run.py --binary build/lgogdownloader -- --threads 8 --chunk-size 20
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import shutil
+import ssl
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+
+SCENARIOS = ["download", "repair", "galaxy", "mojosetup"]
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def make_certificate(workdir):
+    cert = os.path.join(workdir, "cert.pem")
+    key = os.path.join(workdir, "key.pem")
+    subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "2",
+                    "-keyout", key, "-out", cert, "-subj", "/CN=gog.com",
+                    "-addext", "subjectAltName=DNS:gog.com,DNS:*.gog.com"],
+                   check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return cert, key
+
+
+def write_tokens(config_dir):
+    # Login check only needs unexpired Galaxy token and website account page
+    os.makedirs(config_dir, exist_ok=True)
+    with open(os.path.join(config_dir, "galaxy_tokens.json"), "w") as f:
+        json.dump({"access_token": "bench", "refresh_token": "bench", "user_id": "1",
+                   "expires_in": 3600, "expires_at": int(time.time()) + 7 * 24 * 3600}, f)
+
+
+class FakeCDN:
+    def __init__(self, args, cert, key):
+        cmd = [sys.executable, os.path.join(BENCH_DIR, "fakecdn.py"), "--cert", cert, "--key", key]
+        for option in ("seed", "galaxy_files", "galaxy_file_size", "installer_size", "mojosetup_files",
+                       "mojosetup_file_size", "compressibility", "latency", "bandwidth", "error_rate", "drop_rate"):
+            cmd += ["--" + option.replace("_", "-"), str(getattr(args, option))]
+        if args.fault_api:
+            cmd.append("--fault-api")
+        self.process = subprocess.Popen(cmd, stdout=subprocess.PIPE, text=True)
+        line = self.process.stdout.readline()
+        if not line.startswith("listening on "):
+            raise RuntimeError("fakecdn.py failed to start")
+        self.port = int(line.split()[-1])
+        self.context = ssl.create_default_context(cafile=cert)
+        self.context.check_hostname = False
+
+    def get(self, path):
+        with urllib.request.urlopen("https://127.0.0.1:%d%s" % (self.port, path), context=self.context) as response:
+            return json.load(response)
+
+    def stop(self):
+        self.process.terminate()
+        self.process.wait()
+
+
+def run_lgogdownloader(binary, arguments, env, log):
+    """Run lgogdownloader and return exit code, wall time and resource usage of that process only"""
+    started = time.monotonic()
+    process = subprocess.Popen([binary] + arguments, env=env, stdin=subprocess.DEVNULL, stdout=log, stderr=log)
+    _, status, rusage = os.wait4(process.pid, 0)
+    process.returncode = os.waitstatus_to_exitcode(status)
+    return process.returncode, time.monotonic() - started, rusage
+
+
+def verify(directory, expected):
+    """Count expected files that are missing or differ, files are found by relative path anywhere under directory"""
+    found = {}
+    for root, _, files in os.walk(directory):
+        for name in files:
+            path = os.path.join(root, name)
+            for relative in expected:
+                if path.endswith("/" + relative):
+                    found[relative] = path
+    bad = 0
+    for relative, md5 in expected.items():
+        if relative not in found:
+            bad += 1
+            continue
+        h = hashlib.md5()
+        with open(found[relative], "rb") as f:
+            for block in iter(lambda: f.read(1 << 20), b""):
+                h.update(block)
+        if h.hexdigest() != md5:
+            bad += 1
+    return bad
+
+
+def corrupt(directory, expected, count):
+    """Overwrite bytes in downloaded installers so that repair has chunks to fix"""
+    for root, _, files in os.walk(directory):
+        for name in files:
+            path = os.path.join(root, name)
+            if any(path.endswith("/" + relative) for relative in expected):
+                size = os.path.getsize(path)
+                with open(path, "r+b") as f:
+                    for i in range(count):
+                        f.seek(size * (2 * i + 1) // (2 * count))
+                        f.write(b"\xff" * 16)
+
+
+def scenario_arguments(scenario):
+    if scenario in ("download", "repair"):
+        arguments = ["--game", "^bench_game$", "--platform", "w", "--language", "en", "--exclude", "e,p,l"]
+        return arguments + (["--repair", "--download"] if scenario == "repair" else ["--download"])
+    if scenario == "galaxy":
+        return ["--galaxy-install", "1207650001/0", "--galaxy-platform", "w", "--galaxy-no-dependencies"]
+    return ["--galaxy-install", "1207650001/0", "--galaxy-platform", "l", "--platform", "l"]
+
+
+def format_size(value):
+    return "%.1f" % (value / (1 << 20))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--binary", required=True, help="lgogdownloader binary")
+    parser.add_argument("--scenarios", default=",".join(SCENARIOS), help="Comma separated list of scenarios")
+    parser.add_argument("--repeat", type=int, default=1, help="Number of runs per scenario")
+    parser.add_argument("--workdir", help="Directory for config, cache and downloads (default: temporary directory)")
+    parser.add_argument("--keep", action="store_true", help="Don't delete work directory")
+    parser.add_argument("--json", help="Write results to file as JSON")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--galaxy-files", type=int, default=16)
+    parser.add_argument("--galaxy-file-size", type=int, default=16 << 20)
+    parser.add_argument("--installer-size", type=int, default=256 << 20)
+    parser.add_argument("--mojosetup-files", type=int, default=64)
+    parser.add_argument("--mojosetup-file-size", type=int, default=4 << 20)
+    parser.add_argument("--compressibility", type=float, default=0.5)
+    parser.add_argument("--latency", type=float, default=0, help="Delay before every response in milliseconds")
+    parser.add_argument("--bandwidth", type=float, default=0, help="Bandwidth limit per connection in bytes/s")
+    parser.add_argument("--error-rate", type=float, default=0, help="Fraction of content requests answered with 503")
+    parser.add_argument("--drop-rate", type=float, default=0, help="Fraction of content responses cut off mid-body")
+    parser.add_argument("--fault-api", action="store_true", help="Inject faults to API requests too")
+    parser.add_argument("extra", nargs=argparse.REMAINDER, help="Arguments passed to lgogdownloader after --")
+    args = parser.parse_args()
+
+    extra = args.extra[1:] if args.extra[:1] == ["--"] else args.extra
+    scenarios = [s for s in args.scenarios.split(",") if s]
+    for scenario in scenarios:
+        if scenario not in SCENARIOS:
+            parser.error("unknown scenario: " + scenario)
+
+    workdir = args.workdir or tempfile.mkdtemp(prefix="lgogdownloader-bench-")
+    os.makedirs(workdir, exist_ok=True)
+    binary = os.path.abspath(args.binary)
+    cert, key = make_certificate(workdir)
+    cdn = FakeCDN(args, cert, key)
+    expected = cdn.get("/__expected")
+
+    results = []
+    try:
+        for scenario in scenarios:
+            for run in range(args.repeat):
+                # Every run starts from empty config, cache and download directory
+                # except repair which needs downloaded files
+                rundir = os.path.join(workdir, "%s-%d" % (scenario, run))
+                shutil.rmtree(rundir, ignore_errors=True)
+                env = dict(os.environ, XDG_CONFIG_HOME=os.path.join(rundir, "config"),
+                           XDG_CACHE_HOME=os.path.join(rundir, "cache"), HOME=rundir)
+                write_tokens(os.path.join(rundir, "config", "lgogdownloader"))
+                output = os.path.join(rundir, "output")
+                common = ["--connect-to", "::127.0.0.1:%d" % cdn.port, "--cacert", cert,
+                          "--directory", output, "--no-color", "--no-unicode"] + extra
+
+                log = open(os.path.join(rundir, "lgogdownloader.log"), "w")
+                expected_files = expected["mojosetup" if scenario == "mojosetup" else "galaxy" if scenario == "galaxy" else "download"]
+                if scenario == "repair":
+                    rc, _, _ = run_lgogdownloader(binary, common + scenario_arguments("download"), env, log)
+                    if rc != 0:
+                        print("repair: initial download failed, see " + log.name, file=sys.stderr)
+                    corrupt(output, expected_files, 4)
+
+                cdn.get("/__reset")
+                rc, seconds, rusage = run_lgogdownloader(binary, common + scenario_arguments(scenario), env, log)
+                log.close()
+                stats = cdn.get("/__stats")
+
+                content_bytes = sum(v for k, v in stats["bytes"].items() if k in ("chunk", "installer"))
+                cpu = rusage.ru_utime + rusage.ru_stime
+                result = {
+                    "scenario": scenario, "run": run, "exit_code": rc, "seconds": seconds,
+                    "content_bytes": content_bytes,
+                    "mb_per_s": content_bytes / (1 << 20) / seconds if seconds > 0 else 0,
+                    "cpu_seconds": cpu,
+                    "cpu_seconds_per_gb": cpu / (content_bytes / (1 << 30)) if content_bytes else 0,
+                    "peak_rss_mb": rusage.ru_maxrss / 1024,
+                    "requests": stats["requests"], "injected_errors": stats["errors"], "injected_drops": stats["drops"],
+                    "unknown_requests": stats["unknown"], "bad_files": verify(output, expected_files),
+                }
+                results.append(result)
+                if not args.keep and not args.workdir:
+                    shutil.rmtree(rundir, ignore_errors=True)
+    finally:
+        cdn.stop()
+        if not args.keep and not args.workdir:
+            shutil.rmtree(workdir, ignore_errors=True)
+
+    print("%-10s %4s %8s %9s %9s %10s %9s %9s %6s  %s"
+          % ("scenario", "rc", "time s", "MiB", "MiB/s", "CPU s/GiB", "RSS MiB", "requests", "bad", "requests per category"))
+    for r in results:
+        print("%-10s %4d %8.2f %9s %9.1f %10.2f %9.1f %9d %6d  %s"
+              % (r["scenario"], r["exit_code"], r["seconds"], format_size(r["content_bytes"]), r["mb_per_s"],
+                 r["cpu_seconds_per_gb"], r["peak_rss_mb"], sum(r["requests"].values()), r["bad_files"],
+                 " ".join("%s=%d" % kv for kv in sorted(r["requests"].items()))))
+        if r["unknown_requests"]:
+            print("  unknown requests: " + " ".join(r["unknown_requests"]))
+    if args.error_rate or args.drop_rate:
+        print("injected errors: %d, dropped connections: %d"
+              % (sum(r["injected_errors"] for r in results), sum(r["injected_drops"] for r in results)))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=2)
+
+    return 1 if any(r["exit_code"] != 0 or r["bad_files"] for r in results) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -9,6 +9,7 @@
 
 #include <boost/regex.hpp>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class Config;
@@ -17,23 +18,46 @@ class gameFile;
 class BlacklistItem {
     public:
         unsigned int linenr; // where the blacklist item is defined in blacklist.txt
-        unsigned int flags;
+        unsigned int flags = 0;
         std::string source; // source representation of the item
         boost::regex regex;
 };
 
+// Items that are plain literals (optionally anchored) are indexed in hash maps
+// keyed by the literal and looked up once per distinct literal length.
+// Remaining expressions are merged into a single alternation so that a path
+// which is not blacklisted is rejected with one regex search.
 class Blacklist
 {
     public:
         Blacklist() {};
 
         void initialize(const std::vector<std::string>& lines);
-        bool isBlacklisted(const std::string& path);
+        bool isBlacklisted(const std::string& path) const;
+        // Returns first item in file order that matches path, nullptr if none matches
+        const BlacklistItem* getMatchingItem(const std::string& path) const;
 
         std::vector<BlacklistItem>::size_type size() const { return blacklist_.size(); }
-        bool empty() { return blacklist_.empty(); }
+        bool empty() const { return blacklist_.empty(); }
     private:
+        typedef std::unordered_map<std::string, std::size_t> literalIndex;
+
+        void addToIndex(const std::size_t& index);
+        std::size_t findLiteral(const std::string& path) const;
+
         std::vector<BlacklistItem> blacklist_;
+
+        literalIndex exact_;
+        literalIndex prefix_;
+        literalIndex suffix_;
+        std::vector<std::pair<std::string, std::size_t>> substring_;
+        std::vector<std::string::size_type> prefix_lengths_;
+        std::vector<std::string::size_type> suffix_lengths_;
+
+        std::vector<std::size_t> regex_items_;   // items that must be evaluated with regex, in file order
+        std::vector<std::size_t> separate_items_; // regex items evaluated one by one if merging fails
+        bool bCombined_ = false;
+        boost::regex combined_;
 };
 
 #endif // BLACKLIST_H_
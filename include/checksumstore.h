@@ -0,0 +1,129 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef CHECKSUMSTORE_H
+#define CHECKSUMSTORE_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct checksumChunk
+{
+    uintmax_t from = 0;
+    uintmax_t to = 0;
+    std::string md5;
+};
+
+struct checksumEntry
+{
+    std::string name;
+    uintmax_t total_size = 0;
+    std::string md5;
+    std::vector<checksumChunk> chunks;
+    // Attributes of <file> element in original order
+    // Values of name, chunks, total_size and md5 are taken from members above when XML is made
+    std::vector<std::pair<std::string, std::string>> attributes;
+};
+
+// Store for GOG XML checksum data
+//
+// Replaces one XML file per downloaded file with two append-only logs in XML directory:
+//   checksums.idx: one line per record { key, name, total_size, md5, chunk count, chunk offset, chunk length, attributes }
+//   checksums.chunks: chunk tables { from-to:md5 ... } referenced by index records
+// Key is path of the XML file relative to XML directory without ".xml" extension.
+// Index log is read to hash map when store is opened so that status checks don't
+// need to open any files. Chunk tables are read only when requested.
+// Attributes field is "name=value&name=value" list of <file> attributes with '%', '&', '=', tab
+// and newline percent-encoded. Records without it are written by older versions.
+// Later records replace earlier ones and record with name "-" deletes the key.
+// XML files written by older versions are used if key is not found in store.
+//
+// Appends and compaction are serialized between processes with flock on checksums.lock
+// which is never replaced. Compaction writes logs of next generation (checksums.N.idx and
+// checksums.N.chunks), switches to them by renaming checksums.gen and then unlinks old logs.
+// Processes notice unlinked logs and reopen them so index and chunk log always belong to
+// same generation.
+//
+// Store is opened on first use. Files are created only when something is written.
+class ChecksumStore
+{
+    public:
+        ChecksumStore() {};
+        ~ChecksumStore();
+
+        // Set directory of the store, files are opened on first use
+        void setDirectory(const std::string& directory);
+        // Open store and create files if they don't exist
+        bool open(const std::string& directory);
+        void close();
+        bool isOpen() const { return index_fd_ >= 0; }
+
+        // Functions below take path of the XML file
+        bool exists(const std::string& xml_filepath);
+        bool getEntry(const std::string& xml_filepath, checksumEntry& entry, const bool& bWithChunks = false);
+        std::string getXML(const std::string& xml_filepath);
+        // XML data that can't be parsed or is outside store directory is written to XML file
+        bool saveXML(const std::string& xml_filepath, const std::string& xml_data);
+        bool save(const std::string& xml_filepath, const checksumEntry& entry);
+        bool remove(const std::string& xml_filepath);
+
+        // Import XML files from store directory for keys that are not in store and compact logs
+        // Returns number of imported files
+        unsigned int importXML(const std::function<void(const std::string&)>& callback = nullptr);
+        // Write every entry as XML file to directory, returns number of exported files
+        unsigned int exportXML(const std::string& directory, const std::function<void(const std::string&)>& callback = nullptr);
+        // Rewrite logs without replaced and deleted records
+        // Logs are left unchanged if chunk table of any record can't be read
+        bool compact();
+
+        static bool parseXML(const std::string& xml_data, checksumEntry& entry);
+        static std::string makeXML(const checksumEntry& entry);
+    private:
+        struct indexRecord
+        {
+            std::string name;
+            uintmax_t total_size = 0;
+            std::string md5;
+            uintmax_t chunk_count = 0;
+            uintmax_t chunk_offset = 0;
+            uintmax_t chunk_length = 0;
+            std::string attributes;
+        };
+
+        bool getKey(const std::string& xml_filepath, std::string& key) const;
+        bool find(const std::string& key, indexRecord& record, std::vector<checksumChunk>* chunks = nullptr);
+        bool readChunkTable(const indexRecord& record, std::string& table) const;
+        bool readChunks(const indexRecord& record, std::vector<checksumChunk>& chunks) const;
+        bool append(const std::string& key, const checksumEntry* entry);
+        bool ensureOpen(const bool& bWrite);
+        bool openLogs(const bool& bWrite, const bool& bCreate);
+        bool isReplaced() const;
+        uintmax_t readGeneration() const;
+        std::string getLogPath(const uintmax_t& generation, const std::string& extension) const;
+        void refresh();
+        void parseIndexRecord(const std::string& line);
+        void closeLogs();
+        void closeFiles();
+
+        std::string directory_;
+        int lock_fd_ = -1;
+        int index_fd_ = -1;
+        int chunks_fd_ = -1;
+        uintmax_t generation_ = 0;
+        bool writable_ = false;
+        bool read_only_ = false; // Store can't be written, don't try to open it for writing again
+        bool missing_ = false; // Store doesn't exist, don't try to open it for reading again
+        uintmax_t index_size_ = 0;
+        std::unordered_map<std::string, indexRecord> index_;
+        std::mutex mtx_;
+};
+
+#endif // CHECKSUMSTORE_H
@@ -0,0 +1,77 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef CHUNKCACHE_H
+#define CHUNKCACHE_H
+
+#include "galaxychunktable.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+const unsigned int CHUNKCACHE_DOWNLOAD = 0; // Caller must download the chunk and call complete() or abort()
+const unsigned int CHUNKCACHE_MEMORY   = 1; // Compressed chunk data was returned from memory
+const unsigned int CHUNKCACHE_FILE     = 2; // Uncompressed chunk data can be read from a file that was already written
+
+struct chunkRegion
+{
+    std::string filepath;
+    uintmax_t offset = 0;
+};
+
+// Tracks Galaxy chunks (by md5_compressed) that occur more than once in a build.
+// The planner registers every chunk occurrence with addReference() and calls
+// finalize() to drop chunks that occur only once.
+// Download threads call acquire() before downloading a chunk. If the chunk is
+// being downloaded by another thread the call blocks until that download has
+// finished so that each unique chunk is fetched only once.
+// Compressed data is kept in memory while there are pending references, limited
+// by an LRU on total size. Evicted chunks can still be read back from the file
+// region where they were written.
+class ChunkCache
+{
+    public:
+        ChunkCache() {};
+
+        // Returns true for the first occurrence of chunk
+        bool addReference(const galaxyChunkDigest& md5_compressed);
+        void finalize();
+        void clear();
+        void setMaxSize(const uintmax_t& iMaxSize);
+
+        unsigned int acquire(const galaxyChunkDigest& md5_compressed, std::string& data, chunkRegion& region);
+        // Chunk is available, data may be NULL if compressed data is not available (chunk was copied from file)
+        void complete(const galaxyChunkDigest& md5_compressed, const char* data, const uintmax_t& size, const chunkRegion& region);
+        void abort(const galaxyChunkDigest& md5_compressed);
+        // Point regions of renamed file to its new path
+        void renameFile(const std::string& from_filepath, const std::string& to_filepath);
+    private:
+        struct cacheEntry
+        {
+            unsigned int references = 0; // pending references
+            bool bInFlight = false;
+            bool bHasData = false;
+            std::string data;
+            std::list<galaxyChunkDigest>::iterator lru_it;
+            chunkRegion region;
+            bool bHasRegion = false;
+        };
+
+        void evict(cacheEntry& entry);
+
+        std::mutex mtx_;
+        std::condition_variable cv_;
+        std::unordered_map<galaxyChunkDigest, cacheEntry, galaxyChunkDigestHash> entries_;
+        std::list<galaxyChunkDigest> lru_; // most recently used first
+        uintmax_t size_ = 0;
+        uintmax_t max_size_ = 256 << 20;
+};
+
+#endif // CHUNKCACHE_H
@@ -0,0 +1,62 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+struct chunkStoreScanResult
+{
+    uintmax_t chunks = 0;
+    uintmax_t size = 0;
+    uintmax_t invalid = 0;
+    uintmax_t removed = 0;
+};
+
+// Local content addressed store for compressed Galaxy chunks.
+// Chunks are stored as <directory>/ab/cd/<md5_compressed> and are verified
+// against their name whenever they are read.
+// Files are written to temporary file and renamed into place so the store can
+// be shared between processes and hosts (NFS).
+// Modification time is used as last access time for LRU eviction because
+// atime is often disabled.
+class ChunkStore
+{
+    public:
+        ChunkStore() {};
+
+        // iMaxSize = 0 means unlimited
+        void init(const std::string& directory, const uintmax_t& iMaxSize = 0, const bool& bReadOnly = false);
+        bool isEnabled() const { return !directory_.empty(); }
+        bool isReadOnly() const { return read_only_; }
+
+        std::string getChunkPath(const std::string& md5_compressed) const;
+        // Read and verify chunk, returns false if chunk is not in store or fails hash check
+        bool get(const std::string& md5_compressed, std::string& data);
+        // Add chunk that has already been verified by caller
+        bool put(const std::string& md5_compressed, const char* data, const uintmax_t& size);
+
+        // Verify all chunks in store, invalid chunks and leftover temporary files are deleted unless store is read-only
+        // Callback is called with path of every invalid chunk
+        chunkStoreScanResult check(const std::function<void(const std::string&)>& callback = nullptr);
+    private:
+        void walk(const std::function<void(const std::string&, const std::string&)>& f) const;
+        void evict();
+
+        std::string directory_;
+        uintmax_t max_size_ = 0;
+        bool read_only_ = false;
+
+        std::mutex mtx_;
+        bool size_known_ = false;
+        uintmax_t size_ = 0;
+};
+
+#endif // CHUNKSTORE_H
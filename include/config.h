@@ -12,6 +12,7 @@
 #include <json/json.h>
 #include <mutex>
 #include <ctime>
+#include <memory>
 
 #include "blacklist.h"
 
@@ -224,6 +225,8 @@ struct CurlConfig
     long int iLowSpeedTimeout;
     long int iLowSpeedTimeoutRate;
     std::string sInterface;
+    std::vector<std::string> vConnectTo;
+    std::shared_ptr<curl_slist> connectTo; // curl_slist of vConnectTo, shared by copies because curl doesn't copy the list
 };
 
 class Config
@@ -249,6 +252,8 @@ class Config
 
         bool bUnicode; // use Unicode in console output
         bool bColor;   // use colors
+        bool bHeadlessProgress; // stdout is not a terminal
+        bool bHeadlessStderr; // stderr is not a terminal
         bool bReport;
         bool bRespectUmask;
         bool bPlatformDetection;
@@ -259,11 +264,14 @@ class Config
         bool bUseFastCheck;
         bool bTrustAPIForExtras;
         bool bGalaxyListCDNs;
+        bool bGalaxyChunkStoreReadOnly;
 
         // Cache
         bool bUseCache;
         bool bUpdateCache;
+        bool bUpdateCacheIncremental;
         int iCacheValid;
+        int iCacheGameTTL;
 
         // Download with file id options
         std::string sFileIdString;
@@ -280,6 +288,7 @@ class Config
         std::string sCacheDirectory;
         std::string sXMLDirectory;
         std::string sConfigDirectory;
+        std::string sGalaxyChunkStoreDirectory;
 
         // File paths
         std::string sConfigFilePath;
@@ -288,6 +297,9 @@ class Config
         std::string sGameHasDLCListFilePath;
         std::string sReportFilePath;
         std::string sTransformConfigFilePath;
+        std::string sMetricsFilePath;
+        std::string sEventLogFilePath;
+        std::string sTraceFilePath;
 
         std::string sXMLFile;
 
@@ -323,11 +335,18 @@ class Config
         int iWait;
         size_t iChunkSize;
         int iProgressInterval;
+        unsigned int iHeadlessProgressInterval; // seconds, 0 = no status line
         int iMsgLevel;
         unsigned int iListFormat;
         unsigned int iUnitFormat;
+        unsigned int iGalaxyChunkStoreSize; // MiB, 0 = unlimited
+        unsigned int iMetricsInterval; // seconds
 
         Json::Value transformationsJSON;
 };
 
+// Read-only copy of Config shared by worker threads
+// Created once per phase instead of copying Config for every thread
+typedef std::shared_ptr<const Config> ConfigSnapshot;
+
 #endif // CONFIG_H__
@@ -0,0 +1,61 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef DEPOTMANIFESTPARSER_H
+#define DEPOTMANIFESTPARSER_H
+
+#include "galaxyapi.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Streaming parser for Galaxy v2 depot manifests
+//
+// Reads manifest JSON in a single pass and fills galaxyDepotItem records
+// directly without building Json::Value tree of the whole depot.
+// Only depot.items and depot.smallFilesContainer are read, other values are
+// skipped without copying.
+// Chunks are appended to chunk table and items get a range of the table.
+// Callback is called for every item that has chunks array. Small files
+// container is passed with isSmallFilesContainer set. Item can be moved from
+// in callback.
+class DepotManifestParser
+{
+    public:
+        DepotManifestParser(const char* data, const size_t& size, const std::shared_ptr<GalaxyChunkTable>& table) : pos_(data), end_(data + size), table_(table) {};
+
+        bool parse(const std::function<void(galaxyDepotItem&)>& callback);
+        const std::string& getError() const { return error_; }
+    private:
+        bool parseDepot(const std::function<void(galaxyDepotItem&)>& callback);
+        bool parseItem(galaxyDepotItem& item, bool& bHasChunks);
+        bool parseChunks(galaxyDepotItem& item);
+        bool parseChunk(uintmax_t& size_compressed, uintmax_t& size_uncompressed);
+        bool parseSfcRef(galaxyDepotItem& item);
+
+        template <typename F> bool parseObject(F f);
+        template <typename F> bool parseArray(F f);
+        bool parseString(std::string& str);
+        bool parseStringValue(std::string& str);
+        bool parseUIntValue(uintmax_t& value);
+        bool skipValue(const unsigned int& depth = 0);
+        bool skipLiteral(const char* literal);
+
+        void skipWhitespace();
+        bool consume(const char& c);
+        bool fail(const std::string& msg);
+
+        const char* pos_;
+        const char* end_;
+        std::shared_ptr<GalaxyChunkTable> table_;
+        std::string md5_compressed_;
+        std::string md5_uncompressed_;
+        std::string error_;
+};
+
+#endif // DEPOTMANIFESTPARSER_H
@@ -0,0 +1,46 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef DIRECTORYCACHE_H
+#define DIRECTORYCACHE_H
+
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+// Set of directories that are known to exist.
+// Used by download threads to avoid serializing on a single mutex and
+// repeating exists/is_directory/create_directories calls for every file.
+// The set is split into shards so that threads only contend when they
+// happen to look up paths that hash to the same shard.
+class DirectoryCache
+{
+    public:
+        DirectoryCache() {};
+
+        // Make sure that directory exists, creating missing parent directories as needed
+        // Returns 0 on success, ENOTDIR if path (or a parent) exists but is not a directory
+        // and errno value from mkdir for other errors
+        int create(const std::string& path);
+        void clear();
+    private:
+        static const unsigned int SHARD_COUNT = 64;
+
+        struct Shard
+        {
+            std::mutex m;
+            std::unordered_set<std::string> dirs;
+        };
+
+        Shard& getShard(const std::string& path);
+        bool contains(const std::string& path);
+        void insert(const std::string& path);
+        int makeDirectory(const std::string& path);
+
+        Shard shards_[SHARD_COUNT];
+};
+
+#endif // DIRECTORYCACHE_H
@@ -57,9 +57,6 @@ class Timer
 struct xferInfo
 {
     unsigned int tid;
-    CURL* curlhandle;
-    Timer timer;
-    std::deque< std::pair<time_t, uintmax_t> > TimeAndSize;
     curl_off_t offset;
     bool isChunk = false;
     curl_off_t chunk_file_total = 0;
@@ -79,6 +76,7 @@ typedef struct
     time_t timestamp;
 
     std::string installer_url;
+    std::string installer_path; // Verified local installer that is used instead of installer_url
 
     // For split file handling
     bool isSplitFile = false;
@@ -90,6 +88,25 @@ typedef struct
 
 typedef std::map<std::string,std::vector<zipFileEntry>> splitFilesMap;
 
+// Size limits of MojoSetup spans
+// Span size is chosen per install between min and max so that every thread gets several spans
+const off_t MOJOSETUP_SPAN_MIN_SIZE = 8 << 20;  // 8MiB
+const off_t MOJOSETUP_SPAN_MAX_SIZE = 64 << 20; // 64MiB
+const off_t MOJOSETUP_MAX_SPAN_GAP  = 1 << 20;  // Unneeded data downloaded instead of starting new request
+const off_t MOJOSETUP_TEMPFILE_MIN_SIZE = 32 << 20; // Larger remote entries are downloaded to temporary file so that next run can continue them
+
+// Contiguous entries of MojoSetup installer that are downloaded with one range request
+// or read from local installer
+struct mojoSetupSpan
+{
+    std::string installer_url;
+    std::string installer_path;
+    off_t start_offset = 0;
+    off_t end_offset = 0;
+    off_t comp_size = 0;
+    std::vector<zipFileEntry> entries;
+};
+
 class Downloader
 {
     public:
@@ -116,6 +133,7 @@ class Downloader
         void updateCache();
         int downloadFileWithId(const std::string& fileid_string, const std::string& output_filepath);
         void showWishlist();
+        static std::vector<gameDetails> getGameDetailsFromJsonNode(const Json::Value& root, const int& recursion_level = 0);
         CURL* curlhandle;
         Timer timer;
         ProgressBar* progressbar;
@@ -125,6 +143,7 @@ class Downloader
         void galaxyInstallGame(const std::string& product_id, const std::string& build_id = std::string(), const unsigned int& iGalaxyArch = GlobalConstants::ARCH_X64);
         void galaxyInstallGameById(const std::string& product_id, const std::string& build_id = std::string(), const unsigned int& iGalaxyArch = GlobalConstants::ARCH_X64);
         void galaxyListCDNs(const std::string& product_id, const std::string& build_id = std::string());
+        void galaxyCheckChunkStore();
         void galaxyListCDNsById(const std::string& product_id, const std::string& build_id = std::string());
         void galaxyShowBuilds(const std::string& product_id, const std::string& build_id = std::string());
         void galaxyShowCloudSaves(const std::string& product_id, const std::string& build_id = std::string());
@@ -149,18 +168,19 @@ class Downloader
         void addStatusLine(const std::string& statusCode, const std::string& gamename, const std::string& filepath, const uintmax_t& filesize, const std::string& localHash);
         int loadGameDetailsCache();
         int saveGameDetailsCache();
-        std::vector<gameDetails> getGameDetailsFromJsonNode(Json::Value root, const int& recursion_level = 0);
+        int saveGameDetailsCache(const Json::Value& games_json, const Json::Value& game_state);
         static std::string getSerialsFromJSON(const Json::Value& json);
         void saveSerials(const std::string& serials, const std::string& filepath);
         static std::string getChangelogFromJSON(const Json::Value& json);
         void saveJsonFile(const std::string& json, const std::string& filepath);
         void saveChangelog(const std::string& changelog, const std::string& filepath);
-        static void processDownloadQueue(Config conf, const unsigned int& tid);
-        static void processCloudSaveDownloadQueue(Config conf, const unsigned int& tid);
-        static void processCloudSaveUploadQueue(Config conf, const unsigned int& tid);
+        static void processDownloadQueue(ConfigSnapshot conf, const unsigned int& tid);
+        static void processCloudSaveDownloadQueue(ConfigSnapshot conf, const unsigned int& tid);
+        static void processCloudSaveUploadQueue(ConfigSnapshot conf, const unsigned int& tid);
         static int progressCallbackForThread(void *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow);
         template <typename T> void printProgress(const ThreadSafeQueue<T>& download_queue);
-        static void getGameDetailsThread(Config config, const unsigned int& tid);
+        template <typename T> void printProgressHeadless(const ThreadSafeQueue<T>& download_queue);
+        static void getGameDetailsThread(ConfigSnapshot config, const unsigned int& tid);
         void printGameDetailsAsText(gameDetails& game);
         void printGameFileDetailsAsText(gameFile& gf);
 
@@ -169,14 +189,16 @@ class Downloader
         static size_t readData(void *ptr, size_t size, size_t nmemb, FILE *stream);
 
         std::vector<std::string> galaxyGetOrphanedFiles(const std::vector<galaxyDepotItem>& items, const std::string& install_path);
-        static void processGalaxyDownloadQueue(const std::string& install_path, Config conf, const unsigned int& tid);
+        static void processGalaxyDownloadQueue(const std::string& install_path, ConfigSnapshot conf, const unsigned int& tid);
         void galaxyInstallGame_MojoSetupHack(const std::string& product_id);
         void galaxyInstallGame_MojoSetupHack_CombineSplitFiles(const splitFilesMap& mSplitFiles, const bool& bAppendtoFirst = false);
-        static void processGalaxyDownloadQueue_MojoSetupHack(Config conf, const unsigned int& tid);
+        static void processGalaxyDownloadQueue_MojoSetupHack(ConfigSnapshot conf, const unsigned int& tid);
+        static std::vector<mojoSetupSpan> mojoSetupPlanSpans(std::vector<zipFileEntry> vEntries, const off_t& max_span_size);
         int mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEntry>& vFiles);
         std::string getGalaxyInstallDirectory(galaxyAPI *galaxyHandle, const Json::Value& manifest);
         bool galaxySelectProductIdHelper(const std::string& product_id, std::string& selected_product);
         std::vector<galaxyDepotItem> galaxyGetDepotItemVectorFromJson(const Json::Value& json, const unsigned int& iGalaxyArch = GlobalConstants::ARCH_X64);
+        std::vector<std::vector<galaxyDepotItem>> galaxyGetDepotItems(const std::vector<std::pair<Json::Value, bool>>& depots, const std::string& sLanguageRegex, const std::string& sGalaxyArch);
         int galaxyGetBuildIndexWithBuildId(Json::Value json, const std::string& build_id = std::string());
         Json::Value sortGalaxyProductBuilds(Json::Value json, const std::string& sorting_order = "none");
 
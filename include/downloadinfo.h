@@ -8,7 +8,11 @@
 #define DOWNLOADINFO_H
 
 #include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <mutex>
+#include <string>
 
 const unsigned int DLSTATUS_NOTSTARTED = 0;
 const unsigned int DLSTATUS_STARTING   = 1 << 0;
@@ -17,19 +21,27 @@ const unsigned int DLSTATUS_FINISHED   = 1 << 2;
 
 struct progressInfo
 {
-    curl_off_t dlnow;
-    curl_off_t dltotal;
-    double rate;
-    double rate_avg;
+    curl_off_t dlnow = 0;
+    curl_off_t dltotal = 0;
+    double rate = 0;
+    double rate_avg = 0;
+    unsigned int transfer = 0;
 };
 
+// Progress of one worker thread
+// Worker thread is the only writer. Progress is published with a seqlock so
+// that progress callback never blocks and reader always gets matching dlnow
+// and dltotal. Filename is only copied by reader when it has changed.
 class DownloadInfo
 {
     public:
         void setFilename(const std::string& filename_)
         {
             std::unique_lock<std::mutex> lock(m);
+            if (filename == filename_)
+                return;
             filename = filename_;
+            filename_version.fetch_add(1, std::memory_order_release);
         }
 
         std::string getFilename()
@@ -38,41 +50,71 @@ class DownloadInfo
             return filename;
         }
 
-        void setStatus(const unsigned int& status_)
+        // Copy filename if it has changed since version
+        // Returns true and updates version if filename was copied
+        bool getFilenameIfChanged(std::string& filename_, unsigned int& version)
         {
+            if (filename_version.load(std::memory_order_acquire) == version)
+                return false;
+
             std::unique_lock<std::mutex> lock(m);
-            status = status_;
+            filename_ = filename;
+            version = filename_version.load(std::memory_order_relaxed);
+            return true;
         }
 
-        unsigned int getStatus()
+        void setStatus(const unsigned int& status_)
         {
-            std::unique_lock<std::mutex> lock(m);
-            return status;
+            status.store(status_, std::memory_order_release);
         }
 
-        void setProgressInfo(const progressInfo& info)
+        unsigned int getStatus() const
         {
-            std::unique_lock<std::mutex> lock(m);
-            progress_info = info;
+            return status.load(std::memory_order_acquire);
         }
 
-        progressInfo getProgressInfo()
+        void setProgress(const curl_off_t& dlnow_, const curl_off_t& dltotal_)
         {
-            std::unique_lock<std::mutex> lock(m);
-            return progress_info;
+            unsigned int seq_ = seq.load(std::memory_order_relaxed);
+            seq.store(seq_ + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            dlnow.store(dlnow_, std::memory_order_relaxed);
+            dltotal.store(dltotal_, std::memory_order_relaxed);
+            seq.store(seq_ + 2, std::memory_order_release);
+        }
+
+        // Start of new transfer, resets rate estimation of reader
+        void beginTransfer()
+        {
+            transfer.fetch_add(1, std::memory_order_release);
+        }
+
+        // Rate is not set here, use ProgressRate to estimate it
+        progressInfo getProgressInfo() const
+        {
+            progressInfo info;
+            unsigned int seq_begin, seq_end;
+            do
+            {
+                seq_begin = seq.load(std::memory_order_acquire);
+                info.dlnow = dlnow.load(std::memory_order_relaxed);
+                info.dltotal = dltotal.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                seq_end = seq.load(std::memory_order_relaxed);
+            } while ((seq_begin & 1) || seq_begin != seq_end);
+            info.transfer = transfer.load(std::memory_order_acquire);
+
+            return info;
         }
 
         DownloadInfo()=default;
 
         DownloadInfo(const DownloadInfo& other)
         {
-            std::lock_guard<std::mutex> guard(other.m);
-            filename = other.filename;
-            status = other.status;
-            progress_info = other.progress_info;
+            *this = other;
         }
 
-        DownloadInfo& operator= (DownloadInfo& other)
+        DownloadInfo& operator= (const DownloadInfo& other)
         {
             if(&other == this)
                 return *this;
@@ -81,15 +123,66 @@ class DownloadInfo
             std::unique_lock<std::mutex> lock2(other.m, std::defer_lock);
             std::lock(lock1, lock2);
             filename = other.filename;
-            status = other.status;
-            progress_info = other.progress_info;
+            filename_version.store(other.filename_version.load());
+            status.store(other.status.load());
+            progressInfo info = other.getProgressInfo();
+            this->setProgress(info.dlnow, info.dltotal);
+            transfer.store(info.transfer);
             return *this;
         }
     private:
+        // Padding keeps counters of different threads on separate cache lines
+        // alignas isn't used because std::allocator ignores over-alignment before C++17
+        char padding_begin[64];
+        std::atomic<unsigned int> seq { 0 };
+        std::atomic<curl_off_t> dlnow { 0 };
+        std::atomic<curl_off_t> dltotal { 0 };
+        std::atomic<unsigned int> transfer { 0 };
+        std::atomic<unsigned int> status { DLSTATUS_NOTSTARTED };
+        std::atomic<unsigned int> filename_version { 0 };
+        char padding_end[64];
+
         std::string filename;
-        unsigned int status;
-        progressInfo progress_info;
         mutable std::mutex m;
 };
 
+// Download rate estimation done by progress reporter
+// Keeps samples of last 10 seconds for current rate and first sample of
+// transfer for average rate. Samples are reset when worker begins new transfer.
+class ProgressRate
+{
+    public:
+        void update(progressInfo& info)
+        {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (samples.empty() || info.transfer != transfer || info.dlnow < samples.back().second)
+            {
+                samples.clear();
+                transfer = info.transfer;
+                start = std::make_pair(now, info.dlnow);
+            }
+
+            samples.push_back(std::make_pair(now, info.dlnow));
+            while (samples.size() > 2 && now - samples.front().first > std::chrono::seconds(10))
+                samples.pop_front();
+
+            info.rate_avg = rateBetween(start, samples.back());
+            info.rate = rateBetween(samples.front(), samples.back());
+        }
+    private:
+        typedef std::pair<std::chrono::steady_clock::time_point, curl_off_t> sample;
+
+        static double rateBetween(const sample& first, const sample& last)
+        {
+            double seconds = std::chrono::duration<double>(last.first - first.first).count();
+            if (seconds <= 0)
+                return 0;
+            return (last.second - first.second) / seconds;
+        }
+
+        unsigned int transfer = 0;
+        sample start;
+        std::deque<sample> samples;
+};
+
 #endif // DOWNLOADINFO_H
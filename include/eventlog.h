@@ -0,0 +1,85 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <curl/curl.h>
+
+// Result and timings of processing one file
+// Times are in seconds. Transfer times are sums over all transfers of the file
+// including retries and chunks.
+// Status stays "incomplete" if processing ends without setting it, files that
+// are intentionally not downloaded (blacklisted, already complete) are "skipped".
+struct fileEvent
+{
+    std::string queue;
+    std::string file;
+    std::string host;
+    std::string status = "incomplete";
+    uintmax_t bytes = 0;
+    uintmax_t resume_offset = 0;
+    unsigned int transfers = 0;
+    unsigned int retries = 0;
+    double metadata = 0;
+    double connect = 0;
+    double ttfb = 0;
+    double transfer = 0;
+    double hash = 0;
+    double write = 0;
+    double total = 0;
+};
+
+// Event of the file that current thread is working on
+// Constructor makes it current event of the thread and destructor writes it to
+// Globals::eventLog, so every exit path of per-file code gets logged.
+// Does nothing if event log is not open.
+class ScopedFileEvent
+{
+    public:
+        ScopedFileEvent(const std::string& queue, const std::string& file);
+        ~ScopedFileEvent();
+
+        // Set metadata time to time since start, call before first transfer
+        void metadataDone();
+
+        fileEvent event;
+    private:
+        bool active_ = false;
+        ScopedFileEvent* previous_ = nullptr;
+        std::chrono::steady_clock::time_point start_;
+};
+
+// JSON lines log of file events
+class EventLog
+{
+    public:
+        EventLog() {};
+        ~EventLog() { this->close(); }
+
+        bool open(const std::string& filepath);
+        void close();
+        bool isOpen() const { return bOpen_; }
+        void write(const fileEvent& event);
+
+        // Functions below add to current event of the thread and do nothing if there is none
+        static bool hasCurrent();
+        static void addTransfer(CURL* curlhandle);
+        static void addRetry();
+        static void addHashTime(const double& seconds);
+        static void addWriteTime(const double& seconds);
+    private:
+        std::mutex mtx_;
+        std::ofstream ofs_;
+        bool bOpen_ = false;
+};
+
+#endif // EVENTLOG_H
@@ -12,6 +12,7 @@
 #include "config.h"
 #include "util.h"
 #include "gamedetails.h"
+#include "galaxychunktable.h"
 
 #include <iostream>
 #include <vector>
@@ -19,20 +20,10 @@
 #include <curl/curl.h>
 #include <sys/time.h>
 
-struct galaxyDepotItemChunk
-{
-    std::string md5_compressed;
-    std::string md5_uncompressed;
-    uintmax_t size_compressed;
-    uintmax_t size_uncompressed;
-    uintmax_t offset_compressed;
-    uintmax_t offset_uncompressed;
-};
-
 struct galaxyDepotItem
 {
     std::string path;
-    std::vector<galaxyDepotItemChunk> chunks;
+    galaxyChunkRange chunks;
     uintmax_t totalSizeCompressed;
     uintmax_t totalSizeUncompressed;
     std::string md5;
@@ -42,12 +33,14 @@ struct galaxyDepotItem
     bool isInSFC = false;
     uintmax_t sfc_offset;
     uintmax_t sfc_size;
+    galaxyChunkRange oldChunks; // Chunks of previously installed build, used for delta updates
+    uintmax_t totalSizeDownload = 0; // Compressed size of chunks that are expected to be downloaded for this item
 };
 
 class galaxyAPI
 {
     public:
-        galaxyAPI(CurlConfig& conf);
+        galaxyAPI(const CurlConfig& conf);
         virtual ~galaxyAPI();
         int init();
 
@@ -59,6 +52,7 @@ class galaxyAPI
         Json::Value getManifestV1(const std::string& product_id, const std::string& build_id, const std::string& manifest_id = "repository", const std::string& platform = "windows");
         Json::Value getManifestV1(const std::string& manifest_url);
         Json::Value getManifestV2(std::string manifest_hash, const bool& is_dependency = false);
+        std::string getManifestV2Data(std::string manifest_hash, const bool& is_dependency = false);
         Json::Value getCloudPathAsJson(const std::string &clientId);
         Json::Value getSecureLink(const std::string& product_id, const std::string& path);
         Json::Value getDependencyLink(const std::string& path);
@@ -66,6 +60,7 @@ class galaxyAPI
         Json::Value getResponseJson(const std::string& url, const char *encoding = nullptr);
         std::string hashToGalaxyPath(const std::string& hash);
         std::vector<galaxyDepotItem> getDepotItemsVector(const std::string& hash, const bool& is_dependency = false);
+        static std::vector<galaxyDepotItem> getDepotItemsVectorFromManifest(const std::string& manifest, const bool& is_dependency, std::string& error);
         Json::Value getProductInfo(const std::string& product_id);
         gameDetails productInfoJsonToGameDetails(const Json::Value& json, const DownloadConfig& dlConf);
         Json::Value getUserData();
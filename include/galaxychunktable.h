@@ -0,0 +1,94 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef GALAXYCHUNKTABLE_H
+#define GALAXYCHUNKTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Binary MD5 digest of a chunk
+struct galaxyChunkDigest
+{
+    uint8_t bytes[16] = {};
+
+    bool operator==(const galaxyChunkDigest& other) const { return std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+    bool operator!=(const galaxyChunkDigest& other) const { return !(*this == other); }
+    bool operator<(const galaxyChunkDigest& other) const { return std::memcmp(bytes, other.bytes, sizeof(bytes)) < 0; }
+
+    std::string hex() const;
+    // returns false if string is not 32 hex digits
+    static bool fromHex(const std::string& hex, galaxyChunkDigest& digest);
+};
+
+struct galaxyChunkDigestHash
+{
+    size_t operator()(const galaxyChunkDigest& digest) const
+    {
+        // MD5 is uniformly distributed so any bytes of it are a good hash
+        size_t hash;
+        std::memcpy(&hash, digest.bytes, sizeof(hash));
+        return hash;
+    }
+};
+
+// Chunks of all items in a depot as structure of arrays
+// Items refer to their chunks with galaxyChunkRange instead of having a vector
+// of chunks each, so that planners iterate contiguous arrays and copying an
+// item doesn't copy its chunks.
+// Chunk sizes are 32-bit, Galaxy chunks are at most 10 MiB uncompressed.
+class GalaxyChunkTable
+{
+    public:
+        GalaxyChunkTable() {};
+
+        // returns false if hash is not valid MD5 or size doesn't fit in 32 bits
+        bool add(const std::string& md5_compressed, const std::string& md5_uncompressed, const uintmax_t& size_compressed, const uintmax_t& size_uncompressed, const uintmax_t& offset_compressed, const uintmax_t& offset_uncompressed);
+        void shrink_to_fit();
+        size_t size() const { return size_compressed_.size(); }
+
+        const galaxyChunkDigest& md5Compressed(const size_t& i) const { return md5_compressed_[i]; }
+        const galaxyChunkDigest& md5Uncompressed(const size_t& i) const { return md5_uncompressed_[i]; }
+        uint32_t sizeCompressed(const size_t& i) const { return size_compressed_[i]; }
+        uint32_t sizeUncompressed(const size_t& i) const { return size_uncompressed_[i]; }
+        uint64_t offsetCompressed(const size_t& i) const { return offset_compressed_[i]; }
+        uint64_t offsetUncompressed(const size_t& i) const { return offset_uncompressed_[i]; }
+    private:
+        std::vector<galaxyChunkDigest> md5_compressed_;
+        std::vector<galaxyChunkDigest> md5_uncompressed_;
+        std::vector<uint32_t> size_compressed_;
+        std::vector<uint32_t> size_uncompressed_;
+        std::vector<uint64_t> offset_compressed_;
+        std::vector<uint64_t> offset_uncompressed_;
+};
+
+// Chunks of one item, index 0 is the first chunk of the item
+class galaxyChunkRange
+{
+    public:
+        galaxyChunkRange() {};
+        galaxyChunkRange(const std::shared_ptr<const GalaxyChunkTable>& table, const size_t& first, const size_t& count) : table_(table), first_(first), count_(count) {};
+
+        bool empty() const { return count_ == 0; }
+        size_t size() const { return count_; }
+
+        const galaxyChunkDigest& md5Compressed(const size_t& i) const { return table_->md5Compressed(first_ + i); }
+        const galaxyChunkDigest& md5Uncompressed(const size_t& i) const { return table_->md5Uncompressed(first_ + i); }
+        uint32_t sizeCompressed(const size_t& i) const { return table_->sizeCompressed(first_ + i); }
+        uint32_t sizeUncompressed(const size_t& i) const { return table_->sizeUncompressed(first_ + i); }
+        uint64_t offsetCompressed(const size_t& i) const { return table_->offsetCompressed(first_ + i); }
+        uint64_t offsetUncompressed(const size_t& i) const { return table_->offsetUncompressed(first_ + i); }
+    private:
+        std::shared_ptr<const GalaxyChunkTable> table_;
+        size_t first_ = 0;
+        size_t count_ = 0;
+};
+
+#endif // GALAXYCHUNKTABLE_H
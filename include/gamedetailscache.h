@@ -0,0 +1,63 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef GAMEDETAILSCACHE_H
+#define GAMEDETAILSCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <json/json.h>
+
+// Binary game details cache
+//
+// Layout (native byte order, checked with byte order mark):
+//   header, includes size and modification time of JSON cache it was written from
+//   index: one entry per game { gamename string id, record size, record offset }
+//   records: game details JSON nodes encoded as tagged binary values
+//   string table: { uint32 length, bytes } entries, string id is offset in table
+//
+// The file is mapped with mmap and only the index is read when it is opened.
+// Records are decoded to Json::Value on request so that filtering by gamename
+// doesn't need to touch the details of other games.
+// JSON cache is the primary cache, binary cache is not used if JSON cache has
+// been modified or removed after binary cache was written.
+class GameDetailsCache
+{
+    public:
+        GameDetailsCache() {};
+        ~GameDetailsCache();
+
+        // Write "games" array from JSON cache to binary cache file
+        // json_filepath is the file cache_json was written to
+        static bool save(const std::string& filepath, const Json::Value& cache_json, const std::string& json_filepath);
+
+        // returns 0 if successful
+        // returns 1 if cache file doesn't exist
+        // returns 2 if file is not valid binary cache
+        // returns 5 if cache version doesn't match
+        // returns 6 if JSON cache doesn't match the one binary cache was written from
+        int open(const std::string& filepath, const std::string& json_filepath);
+        void close();
+
+        const std::string& getDate() const { return date_; }
+        uint32_t size() const { return game_count_; }
+        std::string getGamename(const uint32_t& index) const;
+        bool getGameJson(const uint32_t& index, Json::Value& json) const;
+    private:
+        bool getString(const uint32_t& id, std::string& str) const;
+        bool decodeValue(const unsigned char*& pos, const unsigned char* end, Json::Value& value, const unsigned int& depth) const;
+
+        const unsigned char* data_ = nullptr;
+        size_t size_ = 0;
+        uint32_t game_count_ = 0;
+        const unsigned char* index_ = nullptr;
+        const unsigned char* strings_ = nullptr;
+        uint64_t strings_size_ = 0;
+        std::string date_;
+};
+
+#endif // GAMEDETAILSCACHE_H
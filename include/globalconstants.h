@@ -13,6 +13,7 @@
 namespace GlobalConstants
 {
     const int GAMEDETAILS_CACHE_VERSION = 7;
+    const unsigned int GAMEDETAILS_BINARY_CACHE_VERSION = 2;
     const int ZLIB_WINDOW_SIZE = 15;
 
     // Unit formatting
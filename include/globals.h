@@ -8,6 +8,10 @@
 #define GLOBALS_H_INCLUDED
 
 #include "config.h"
+#include "checksumstore.h"
+#include "metrics.h"
+#include "eventlog.h"
+#include "tracer.h"
 #include <iostream>
 #include <vector>
 
@@ -16,6 +20,10 @@ namespace Globals
     extern GalaxyConfig galaxyConf;
     extern Config globalConfig;
     extern std::vector<std::string> vOwnedGamesIds;
+    extern ChecksumStore checksumStore;
+    extern Metrics metrics;
+    extern EventLog eventLog;
+    extern Tracer tracer;
 }
 
 #endif // GLOBALS_H_INCLUDED
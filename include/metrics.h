@@ -0,0 +1,87 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <curl/curl.h>
+
+typedef std::vector<std::pair<std::string, std::string>> metricLabels;
+
+// Counters and histograms for transfers, API requests and disk operations
+//
+// Metrics are written to file in Prometheus text format so that node_exporter
+// textfile collector can read them. File is replaced atomically every interval
+// and once more when writer is stopped.
+// All functions do nothing until metrics are enabled.
+class Metrics
+{
+    public:
+        Metrics() {};
+        ~Metrics();
+
+        void enable() { enabled_ = true; }
+        bool isEnabled() const { return enabled_; }
+
+        void addCounter(const std::string& name, const metricLabels& labels, const double& value);
+        void observe(const std::string& name, const metricLabels& labels, const double& value);
+
+        // Record bytes, time, host and result of finished curl_easy_perform
+        void transfer(CURL* curlhandle, const std::string& queue, const CURLcode& result);
+        void retry(const std::string& queue, const CURLcode& result, const long int& response_code);
+        void apiRequest(const std::string& api, const std::string& url, const double& seconds, const CURLcode& result);
+        void hash(const double& seconds, const uintmax_t& bytes);
+        void diskWrite(const double& seconds, const uintmax_t& bytes);
+
+        std::string format();
+        bool writeFile(const std::string& filepath);
+        void startWriter(const std::string& filepath, const unsigned int& interval);
+        void stopWriter();
+
+        // Endpoint label for url, path segments that look like ids are replaced with "{id}"
+        static std::string endpoint(const std::string& url);
+        static std::string host(const std::string& url);
+    private:
+        struct metricSeries
+        {
+            double value = 0;
+            std::vector<uint64_t> buckets;
+            double sum = 0;
+            uint64_t count = 0;
+        };
+
+        struct metricFamily
+        {
+            std::string type;
+            std::string help;
+            std::vector<double> buckets;
+            std::map<std::string, metricSeries> series;
+        };
+
+        metricFamily* getFamily(const std::string& name);
+        static std::string labelString(const metricLabels& labels);
+
+        std::atomic<bool> enabled_ { false };
+        std::mutex mtx_;
+        std::map<std::string, metricFamily> families_;
+
+        std::thread writer_;
+        std::mutex writer_mtx_;
+        std::condition_variable writer_cv_;
+        bool writer_stop_ = false;
+        std::string filepath_;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,66 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef ORPHANSCANNER_H
+#define ORPHANSCANNER_H
+
+#include "blacklist.h"
+#include "patternmatcher.h"
+#include "threadsafequeue.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+const unsigned int ORPHANSCAN_ORPHAN        = 1 << 0;
+const unsigned int ORPHANSCAN_IGNORELISTED  = 1 << 1;
+const unsigned int ORPHANSCAN_BLACKLISTED   = 1 << 2;
+const unsigned int ORPHANSCAN_ERROR         = 1 << 3;
+
+struct orphanScanResult
+{
+    unsigned int type;
+    std::string path;
+    unsigned int linenr = 0; // matching blacklist or ignorelist line
+};
+
+// Finds files on disk that are not in the set of expected paths.
+// Expected paths are kept in a hash set and the directories are walked
+// once with readdir using d_type, split into jobs per top-level
+// subdirectory that are processed by worker threads.
+class OrphanScanner
+{
+    public:
+        OrphanScanner(const Blacklist& blacklist, const Blacklist& ignorelist, const std::size_t& iPrefixLength, const std::string& sOrphanRegex = std::string());
+
+        void addExpectedPath(const std::string& path);
+        void addDirectory(const std::string& path);
+
+        // Walk directories using iThreads worker threads.
+        // Results are streamed to callback from the calling thread as they are found.
+        void scan(const unsigned int& iThreads, const std::function<void(const orphanScanResult&)>& callback);
+    private:
+        void processFile(const std::string& filepath);
+        void walkDirectory(const std::string& path);
+        void scanThread();
+
+        Blacklist blacklist_;
+        Blacklist ignorelist_;
+        std::size_t prefix_length_;
+        std::shared_ptr<const PatternMatcher> orphan_filter_;
+
+        std::unordered_set<std::string> expected_;
+        std::vector<std::string> directories_;
+
+        ThreadSafeQueue<std::string> jobs_;
+        ThreadSafeQueue<orphanScanResult> results_;
+        std::atomic<unsigned int> running_threads_;
+};
+
+#endif // ORPHANSCANNER_H
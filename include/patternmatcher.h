@@ -0,0 +1,60 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef PATTERNMATCHER_H
+#define PATTERNMATCHER_H
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <boost/regex.hpp>
+
+const unsigned int PATTERN_DEFAULT = 0;
+const unsigned int PATTERN_ICASE   = 1 << 0;
+
+// Compiled form of a user supplied regular expression (Perl syntax)
+// Patterns that are plain literals, or an anchored group of literal alternatives
+// like "^(en|eng|english)$", are matched with string compares and a hash set.
+// Everything else falls back to boost::regex.
+// search() has the same semantics as boost::regex_search.
+class PatternMatcher
+{
+    public:
+        enum MatchMode
+        {
+            MODE_ALL,       // matches everything (empty pattern or ".*")
+            MODE_EXACT,     // ^(lit1|lit2)$
+            MODE_PREFIX,    // ^(lit1|lit2)
+            MODE_SUFFIX,    // (lit1|lit2)$
+            MODE_SUBSTRING, // (lit1|lit2)
+            MODE_REGEX
+        };
+
+        PatternMatcher(const std::string& pattern, const unsigned int& flags = PATTERN_DEFAULT);
+
+        bool search(const std::string& str) const;
+        bool usesRegex() const { return mode_ == MODE_REGEX; }
+        MatchMode mode() const { return mode_; }
+        const std::vector<std::string>& literals() const { return literals_; }
+        const std::string& source() const { return source_; }
+
+        // Return compiled matcher for pattern
+        // Matchers are compiled only once and shared by all callers
+        static std::shared_ptr<const PatternMatcher> get(const std::string& pattern, const unsigned int& flags = PATTERN_DEFAULT);
+    private:
+        bool analyze(const std::string& pattern);
+        std::string foldCase(const std::string& str) const;
+
+        std::string source_;
+        unsigned int flags_;
+        MatchMode mode_;
+        std::vector<std::string> literals_;
+        std::unordered_set<std::string> literal_set_;
+        boost::regex regex_;
+};
+
+#endif // PATTERNMATCHER_H
@@ -0,0 +1,75 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct traceEvent
+{
+    const char* name;
+    std::string detail;
+    int64_t start_us;
+    int64_t duration_us;
+};
+
+struct traceThread
+{
+    unsigned int tid = 0;
+    std::string name;
+    std::mutex mtx;
+    std::vector<traceEvent> events;
+};
+
+// Records spans of time per thread and writes them in Chrome trace event
+// format that can be opened in Perfetto or chrome://tracing
+// Every thread appends to its own buffer so recording doesn't contend
+// between threads. Trace is written when tracer is stopped.
+class Tracer
+{
+    public:
+        Tracer() {};
+        ~Tracer();
+
+        void start(const std::string& filepath);
+        bool stop();
+        bool isEnabled() const { return enabled_; }
+
+        void setThreadName(const std::string& name);
+        void add(const char* name, const std::string& detail, const std::chrono::steady_clock::time_point& start, const std::chrono::steady_clock::time_point& end);
+    private:
+        traceThread* getThread();
+
+        std::atomic<bool> enabled_ { false };
+        std::string filepath_;
+        std::chrono::steady_clock::time_point epoch_;
+        std::mutex mtx_;
+        std::vector<std::shared_ptr<traceThread>> threads_;
+};
+
+// Span from construction to destruction
+// Name must be string literal, detail is copied only if tracer is enabled.
+class TraceSpan
+{
+    public:
+        TraceSpan(const char* name);
+        TraceSpan(const char* name, const std::string& detail);
+        ~TraceSpan();
+    private:
+        const char* name_;
+        std::string detail_;
+        bool bEnabled_;
+        std::chrono::steady_clock::time_point start_;
+};
+
+#endif // TRACER_H
@@ -39,6 +39,7 @@ struct gameItem
     std::vector<std::string> dlcnames;
     Json::Value gamedetailsjson;
     int updates = 0;
+    int dlccount = 0;
     bool isnew;
 };
 
@@ -11,9 +11,12 @@
 #include <ctime>
 #include <string>
 #include <iostream>
+#include <vector>
 #include <boost/filesystem.hpp>
+#include <zlib.h>
 
 #define ZIP_LOCAL_HEADER_SIGNATURE  0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE       30
 #define ZIP_CD_HEADER_SIGNATURE     0x02014b50
 #define ZIP_EOCD_HEADER_SIGNATURE   0x06054b50
 #define ZIP_EOCD_HEADER_SIGNATURE64 0x06064b50
@@ -104,6 +107,51 @@ namespace ZipUtil
     int extractStream(std::istream* input_stream, std::ostream* output_stream);
     boost::filesystem::perms getBoostFilePermission(const uint16_t& attributes);
     bool isSymlink(const uint16_t& attributes);
+
+    // Extracts zip entry from data that starts at its local file header
+    // Data can be written in pieces as it is received. Uncompressed data is
+    // written to output stream and CRC32 is calculated on the fly so entry
+    // doesn't need to be stored before extraction.
+    // Compressed size is taken from central directory because local header
+    // doesn't have it when data descriptor is used.
+    class EntryExtractor
+    {
+        public:
+            EntryExtractor(std::ostream* output_stream, const uint64_t& comp_size);
+            ~EntryExtractor();
+
+            /* Returns 0 if successful
+               returns 1 if local file header is not valid
+               returns 2 if compression method is unsupported
+               returns 3 if writing to output stream failed
+               returns 4 if zlib error
+               Data after end of compressed data is ignored */
+            int write(const char* data, const size_t& size);
+
+            bool isFinished() const { return bFinished; }
+            uint32_t getCRC32() const { return crc32; }
+            uint64_t getUncompressedSize() const { return uncomp_size; }
+        private:
+            EntryExtractor(const EntryExtractor&) = delete;
+            EntryExtractor& operator=(const EntryExtractor&) = delete;
+
+            int parseHeader();
+            bool writeOutput(const char* data, const size_t& size);
+
+            std::ostream* output;
+            uint64_t comp_remaining;
+            uint64_t uncomp_size = 0;
+            uint32_t crc32 = 0;
+            uint16_t compression_method = 0;
+            std::string header;
+            size_t header_size = ZIP_LOCAL_HEADER_SIZE;
+            bool bHeaderDone = false;
+            bool bFinished = false;
+            bool bZlibInit = false;
+            int result = 0;
+            z_stream zs;
+            std::vector<char> buffer;
+    };
 }
 
 #endif // ZIPUTIL_H
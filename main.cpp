@@ -15,9 +15,14 @@
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 #include <signal.h>
+#include <unistd.h>
 
 namespace bpo = boost::program_options;
 Config Globals::globalConfig;
+ChecksumStore Globals::checksumStore;
+Metrics Globals::metrics;
+EventLog Globals::eventLog;
+Tracer Globals::tracer;
 
 template<typename T> void set_vm_value(std::map<std::string, bpo::variable_value>& vm, const std::string& option, const T& value)
 {
@@ -191,6 +196,9 @@ int main(int argc, char *argv[])
     bool bClearUpdateNotifications = false;
     bool bList = false;
     bool bCheckLoginStatus = false;
+    bool bGalaxyChunkStoreCheck = false;
+    bool bChecksumStoreImport = false;
+    std::string sChecksumStoreExport;
     try
     {
         bool bInsecure = false;
@@ -239,6 +247,9 @@ int main(int argc, char *argv[])
             ("reset-config", bpo::value<bool>(&Globals::globalConfig.bResetConfig)->zero_tokens()->default_value(false), "Reset config settings to default")
             ("report", bpo::value<std::string>(&Globals::globalConfig.sReportFilePath)->implicit_value("lgogdownloader-report.log"), "Save report of downloaded/repaired files to specified file\nDefault filename: lgogdownloader-report.log")
             ("update-cache", bpo::value<bool>(&Globals::globalConfig.bUpdateCache)->zero_tokens()->default_value(false), "Update game details cache")
+            ("update-cache-incremental", bpo::value<bool>(&Globals::globalConfig.bUpdateCacheIncremental)->zero_tokens()->default_value(false), "Update game details cache incrementally\nOnly games that are new, have changed in account or whose details are older than --cache-game-ttl are refetched")
+            ("checksum-store-import", bpo::value<bool>(&bChecksumStoreImport)->zero_tokens()->default_value(false), "Import GOG XML files in --xml-directory to checksum store\nChecksum data is kept in checksums.idx and checksums.chunks in --xml-directory. XML files created by older versions are used until they are imported")
+            ("checksum-store-export", bpo::value<std::string>(&sChecksumStoreExport)->default_value(""), "Export checksum store as GOG XML files to directory")
             ("no-platform-detection", bpo::value<bool>(&bNoPlatformDetection)->zero_tokens()->default_value(false), "Don't try to detect supported platforms from game shelf.\nSkips the initial fast platform detection and detects the supported platforms from game details which is slower but more accurate.\nUseful in case platform identifier is missing for some games in the game shelf.\nUsing --platform with --list doesn't work with this option.")
             ("download-file", bpo::value<std::string>(&Globals::globalConfig.sFileIdString)->default_value(""), "Download files using fileid\n\nFormat:\n\"gamename/fileid\"\n\"gamename/dlc_gamename/fileid\"\n\"gogdownloader://gamename/fileid\"\n\"gogdownloader://gamename/dlc_name/fileid\"\n\nMultiple files:\n\"gamename1/fileid1,gamename2/fileid2,gamename2/dlcname/fileid1\"\n\nThis option ignores all subdir options. The files are downloaded to directory specified with --directory option.")
             ("output-file,o", bpo::value<std::string>(&Globals::globalConfig.sOutputFilename)->default_value(""), "Set filename of file downloaded with --download-file.")
@@ -283,6 +294,7 @@ int main(int argc, char *argv[])
             ("subdir-game", bpo::value<std::string>(&Globals::globalConfig.dirConf.sGameSubdir)->default_value("%gamename%"), ("Set subdirectory for game" + subdir_help_text).c_str())
             ("use-cache", bpo::value<bool>(&Globals::globalConfig.bUseCache)->zero_tokens()->default_value(false), ("Use game details cache"))
             ("cache-valid", bpo::value<int>(&Globals::globalConfig.iCacheValid)->default_value(2880), ("Set how long cached game details are valid (in minutes)\nDefault: 2880 minutes (48 hours)"))
+            ("cache-game-ttl", bpo::value<int>(&Globals::globalConfig.iCacheGameTTL)->default_value(10080), ("Set how long details of a single game are reused by --update-cache-incremental (in minutes)\nDefault: 10080 minutes (7 days)"))
             ("save-serials", bpo::value<bool>(&Globals::globalConfig.dlConf.bSaveSerials)->zero_tokens()->default_value(false), "Save serial numbers when downloading")
             ("save-game-details-json", bpo::value<bool>(&Globals::globalConfig.dlConf.bSaveGameDetailsJson)->zero_tokens()->default_value(false), "Save game details JSON data as-is to \"game-details.json\"")
             ("save-product-json", bpo::value<bool>(&Globals::globalConfig.dlConf.bSaveProductJson)->zero_tokens()->default_value(false), "Save product info JSON data from the API as-is to \"product.json\"")
@@ -296,6 +308,7 @@ int main(int argc, char *argv[])
             ("threads", bpo::value<unsigned int>(&Globals::globalConfig.iThreads)->default_value(4), "Number of download threads")
             ("info-threads", bpo::value<unsigned int>(&Globals::globalConfig.iInfoThreads)->default_value(4), "Number of threads for getting product info")
             ("progress-interval", bpo::value<int>(&Globals::globalConfig.iProgressInterval)->default_value(100), "Set interval for progress bar update (milliseconds)\nValue must be between 1 and 10000")
+            ("headless-progress-interval", bpo::value<unsigned int>(&Globals::globalConfig.iHeadlessProgressInterval)->default_value(60), "Set interval for status line printed instead of progress bars when output is not a terminal (seconds)\n0 = print only messages")
             ("lowspeed-timeout", bpo::value<long int>(&Globals::globalConfig.curlConf.iLowSpeedTimeout)->default_value(30), "Set time in number seconds that the transfer speed should be below the rate set with --lowspeed-rate for it to considered too slow and aborted")
             ("lowspeed-rate", bpo::value<long int>(&Globals::globalConfig.curlConf.iLowSpeedTimeoutRate)->default_value(200), "Set average transfer speed in bytes per second that the transfer should be below during time specified with --lowspeed-timeout for it to be considered too slow and aborted")
             ("include-hidden-products", bpo::value<bool>(&Globals::globalConfig.bIncludeHiddenProducts)->zero_tokens()->default_value(false), "Include games that have been set hidden in account page")
@@ -306,6 +319,13 @@ int main(int argc, char *argv[])
             ("trust-api-for-extras", bpo::value<bool>(&Globals::globalConfig.bTrustAPIForExtras)->zero_tokens()->default_value(false), "Trust API responses for extras to be correct.")
             ("interface", bpo::value<std::string>(&Globals::globalConfig.curlConf.sInterface)->default_value(""), "Perform operations using a specified network interface")
             ("unit-format", bpo::value<std::string>(&sUnitFormat)->default_value("IEC"), "Select unit format to use: IEC or SI")
+            ("galaxy-chunk-store", bpo::value<std::string>(&Globals::globalConfig.sGalaxyChunkStoreDirectory)->default_value(""), "Set directory for local Galaxy chunk store\nChunks are reused by --galaxy-install before downloading them from CDN\nDirectory can be shared between hosts")
+            ("galaxy-chunk-store-size", bpo::value<unsigned int>(&Globals::globalConfig.iGalaxyChunkStoreSize)->default_value(0), "Set maximum size of Galaxy chunk store (in MiB)\nLeast recently used chunks are deleted when limit is exceeded\n0 = unlimited")
+            ("galaxy-chunk-store-read-only", bpo::value<bool>(&Globals::globalConfig.bGalaxyChunkStoreReadOnly)->zero_tokens()->default_value(false), "Don't add chunks to Galaxy chunk store\nUse this when chunk store is shared and populated by another host")
+            ("metrics-file", bpo::value<std::string>(&Globals::globalConfig.sMetricsFilePath)->default_value(""), "Write transfer and API statistics to file in Prometheus text format\nFile is updated periodically and can be read by node_exporter textfile collector")
+            ("event-log", bpo::value<std::string>(&Globals::globalConfig.sEventLogFilePath)->default_value(""), "Append result and timings of every downloaded or repaired file to file as JSON lines")
+            ("trace", bpo::value<std::string>(&Globals::globalConfig.sTraceFilePath)->default_value(""), "Write timeline of login, API requests, downloads, hashing and disk writes to file in Chrome trace event format\nTrace can be opened in Perfetto or chrome://tracing")
+            ("metrics-interval", bpo::value<unsigned int>(&Globals::globalConfig.iMetricsInterval)->default_value(15), "Set interval for updating --metrics-file (seconds)")
         ;
 
         options_cli_no_cfg_hidden.add_options()
@@ -325,11 +345,13 @@ int main(int argc, char *argv[])
             ("galaxy-platform", bpo::value<std::string>(&sGalaxyPlatform)->default_value("w"), galaxy_platform_text.c_str())
             ("galaxy-language", bpo::value<std::string>(&sGalaxyLanguage)->default_value("en"), galaxy_language_text.c_str())
             ("galaxy-arch", bpo::value<std::string>(&sGalaxyArch)->default_value("x64"), galaxy_arch_text.c_str())
+            ("connect-to", bpo::value<std::vector<std::string>>(&Globals::globalConfig.curlConf.vConnectTo)->multitoken(), "Connect to another host and port instead of the one in URL\nUses the same format as curl: HOST:PORT:CONNECT-TO-HOST:CONNECT-TO-PORT\nUseful for measuring performance against local server\n Example: --connect-to cdn.gog.com:443:127.0.0.1:8443")
             ("galaxy-no-dependencies", bpo::value<bool>(&bNoGalaxyDependencies)->zero_tokens()->default_value(false), "Don't download dependencies during --galaxy-install")
             ("subdir-galaxy-install", bpo::value<std::string>(&Globals::globalConfig.dirConf.sGalaxyInstallSubdir)->default_value("%install_dir%"), galaxy_install_subdir_text.c_str())
             ("galaxy-cdn-priority", bpo::value<std::string>(&sGalaxyCDN)->default_value("edgecast,akamai_edgecast_proxy,fastly"), galaxy_cdn_priority_text.c_str())
             ("galaxy-list-cdns", bpo::value<std::string>(&galaxy_product_id_list_cdns)->default_value(""), "List available CDNs for game using product id [product_id/build_index] or gamename regex [gamename/build_id]\nBuild index is used to select a build and defaults to 0 if not specified.\n\nExample: 12345/2 selects build 2 for product 12345")
             ("galaxy-lowercase-path", bpo::value<bool>(&Globals::globalConfig.dlConf.bGalaxyLowercasePath)->zero_tokens()->default_value(false), "Make filepath lowercase for Windows game files")
+            ("galaxy-chunk-store-check", bpo::value<bool>(&bGalaxyChunkStoreCheck)->zero_tokens()->default_value(false), "Check integrity of Galaxy chunk store set with --galaxy-chunk-store\nInvalid chunks are deleted unless --galaxy-chunk-store-read-only is used")
         ;
 
         options_cli_all.add(options_cli_no_cfg).add(options_cli_cfg).add(options_cli_experimental);
@@ -527,7 +549,16 @@ int main(int argc, char *argv[])
         }
 
         Globals::globalConfig.curlConf.bVerifyPeer = !bInsecure;
+        if (!Globals::globalConfig.curlConf.vConnectTo.empty())
+        {
+            curl_slist* connect_to = NULL;
+            for (auto str : Globals::globalConfig.curlConf.vConnectTo)
+                connect_to = curl_slist_append(connect_to, str.c_str());
+            Globals::globalConfig.curlConf.connectTo.reset(connect_to, curl_slist_free_all);
+        }
         Globals::globalConfig.bColor = !bNoColor;
+        Globals::globalConfig.bHeadlessProgress = !isatty(STDOUT_FILENO);
+        Globals::globalConfig.bHeadlessStderr = !isatty(STDERR_FILENO);
         Globals::globalConfig.bUnicode = !bNoUnicode;
         Globals::globalConfig.dlConf.bDuplicateHandler = !bNoDuplicateHandler;
         Globals::globalConfig.dlConf.bRemoteXML = !bNoRemoteXML;
@@ -535,6 +566,8 @@ int main(int argc, char *argv[])
         Globals::globalConfig.bPlatformDetection = !bNoPlatformDetection;
         Globals::globalConfig.dlConf.bGalaxyDependencies = !bNoGalaxyDependencies;
         Globals::globalConfig.bUseFastCheck = !bNoFastStatusCheck;
+        if (Globals::globalConfig.bUpdateCacheIncremental)
+            Globals::globalConfig.bUpdateCache = true;
 
         for (auto i = unrecognized_options_cli.begin(); i != unrecognized_options_cli.end(); ++i)
             if (i->compare(0, GlobalConstants::PROTOCOL_PREFIX.length(), GlobalConstants::PROTOCOL_PREFIX) == 0)
@@ -628,6 +661,18 @@ int main(int argc, char *argv[])
             Globals::globalConfig.sXMLDirectory.assign(Globals::globalConfig.sXMLDirectory.begin(), Globals::globalConfig.sXMLDirectory.end()-1);
     }
 
+    // Checksum store is opened on first use
+    Globals::checksumStore.setDirectory(Globals::globalConfig.sXMLDirectory);
+
+    if (!Globals::globalConfig.sMetricsFilePath.empty())
+        Globals::metrics.startWriter(Globals::globalConfig.sMetricsFilePath, Globals::globalConfig.iMetricsInterval);
+
+    if (!Globals::globalConfig.sEventLogFilePath.empty() && !Globals::eventLog.open(Globals::globalConfig.sEventLogFilePath))
+        std::cerr << "Failed to open event log " << Globals::globalConfig.sEventLogFilePath << std::endl;
+
+    if (!Globals::globalConfig.sTraceFilePath.empty())
+        Globals::tracer.start(Globals::globalConfig.sTraceFilePath);
+
     // Create GOG XML for a file
     if (!Globals::globalConfig.sXMLFile.empty() && (Globals::globalConfig.sXMLFile != "automatic"))
     {
@@ -635,6 +680,20 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    if (bChecksumStoreImport)
+    {
+        unsigned int iImported = Globals::checksumStore.importXML();
+        std::cout << "Imported " << iImported << " XML files to checksum store" << std::endl;
+        return 0;
+    }
+
+    if (!sChecksumStoreExport.empty())
+    {
+        unsigned int iExported = Globals::checksumStore.exportXML(sChecksumStoreExport);
+        std::cout << "Exported " << iExported << " XML files to " << sChecksumStoreExport << std::endl;
+        return 0;
+    }
+
     // Make sure that directory has trailing slash
     ensure_trailing_slash(Globals::globalConfig.dirConf.sDirectory, "./");
     ensure_trailing_slash(Globals::globalConfig.dirConf.sWinePrefix, "./");
@@ -888,6 +947,8 @@ int main(int argc, char *argv[])
         }
         downloader.galaxyListCDNs(product_id, build_id);
     }
+    else if (bGalaxyChunkStoreCheck)
+        downloader.galaxyCheckChunkStore();
     else if (!galaxy_product_cloud_saves.empty()) {
         std::string build_id;
         std::vector<std::string> tokens = Util::tokenize(galaxy_product_cloud_saves, "/");
@@ -7,7 +7,9 @@
 #include "blacklist.h"
 #include "config.h"
 #include "util.h"
+#include "patternmatcher.h"
 
+#include <algorithm>
 #include <iostream>
 #include <utility>
 
@@ -56,17 +58,152 @@ void Blacklist::initialize(const std::vector<std::string>& lines) {
             item.source.assign(s.substr(i).c_str());
             item.regex.assign(item.source, rx_flags);
             blacklist_.push_back(std::move(item));
+            this->addToIndex(blacklist_.size() - 1);
         } else {
             std::cout << "unknown expression type in blacklist line " << linenr << std::endl;
         }
     }
+
+    std::sort(prefix_lengths_.begin(), prefix_lengths_.end());
+    prefix_lengths_.erase(std::unique(prefix_lengths_.begin(), prefix_lengths_.end()), prefix_lengths_.end());
+    std::sort(suffix_lengths_.begin(), suffix_lengths_.end());
+    suffix_lengths_.erase(std::unique(suffix_lengths_.begin(), suffix_lengths_.end()), suffix_lengths_.end());
+
+    // Merge remaining expressions into one alternation
+    std::string combined;
+    for (auto index : regex_items_)
+        combined += (combined.empty() ? "" : "|") + std::string("(?:") + blacklist_[index].source + ")";
+
+    bCombined_ = false;
+    if (!combined.empty())
+    {
+        try
+        {
+            combined_.assign(combined, boost::regex::normal | boost::regex::nosubs);
+            bCombined_ = true;
+        }
+        catch (const boost::regex_error& e)
+        {
+            // Evaluate items one by one
+            separate_items_.insert(separate_items_.end(), regex_items_.begin(), regex_items_.end());
+            std::sort(separate_items_.begin(), separate_items_.end());
+            regex_items_.clear();
+        }
+    }
+}
+
+void Blacklist::addToIndex(const std::size_t& index)
+{
+    const BlacklistItem& item = blacklist_[index];
+
+    PatternMatcher matcher(item.source);
+    PatternMatcher::MatchMode mode = matcher.mode();
+    if (mode == PatternMatcher::MODE_REGEX || mode == PatternMatcher::MODE_ALL)
+    {
+        regex_items_.push_back(index);
+        return;
+    }
+
+    // Only the first line for each literal is kept so that lookups return the first matching line
+    for (auto literal : matcher.literals())
+    {
+        if (mode == PatternMatcher::MODE_EXACT)
+            exact_.insert(std::make_pair(literal, index));
+        else if (mode == PatternMatcher::MODE_PREFIX)
+        {
+            prefix_.insert(std::make_pair(literal, index));
+            prefix_lengths_.push_back(literal.size());
+        }
+        else if (mode == PatternMatcher::MODE_SUFFIX)
+        {
+            suffix_.insert(std::make_pair(literal, index));
+            suffix_lengths_.push_back(literal.size());
+        }
+        else
+            substring_.push_back(std::make_pair(literal, index));
+    }
 }
 
-bool Blacklist::isBlacklisted(const std::string& path) {
-    for (auto it = blacklist_.begin(); it != blacklist_.end(); ++it) {
-        const BlacklistItem& item = *it;
-        if (item.flags & BLFLAG_RX && boost::regex_search(path, item.regex))
+// Returns index of first literal item matching path or blacklist_.size() if none matches
+std::size_t Blacklist::findLiteral(const std::string& path) const
+{
+    std::size_t first = blacklist_.size();
+
+    literalIndex::const_iterator it = exact_.find(path);
+    if (it != exact_.end())
+        first = std::min(first, it->second);
+
+    for (auto len : prefix_lengths_)
+    {
+        if (len > path.size())
+            break;
+        it = prefix_.find(path.substr(0, len));
+        if (it != prefix_.end())
+            first = std::min(first, it->second);
+    }
+
+    for (auto len : suffix_lengths_)
+    {
+        if (len > path.size())
+            break;
+        it = suffix_.find(path.substr(path.size() - len));
+        if (it != suffix_.end())
+            first = std::min(first, it->second);
+    }
+
+    for (auto substring : substring_)
+    {
+        if (substring.second < first && path.find(substring.first) != std::string::npos)
+            first = substring.second;
+    }
+
+    return first;
+}
+
+bool Blacklist::isBlacklisted(const std::string& path) const {
+    if (blacklist_.empty())
+        return false;
+
+    if (this->findLiteral(path) < blacklist_.size())
+        return true;
+
+    if (bCombined_ && boost::regex_search(path, combined_))
+        return true;
+
+    for (auto index : separate_items_) {
+        if (boost::regex_search(path, blacklist_[index].regex))
             return true;
     }
+
     return false;
 }
+
+const BlacklistItem* Blacklist::getMatchingItem(const std::string& path) const {
+    if (blacklist_.empty())
+        return nullptr;
+
+    std::size_t first = this->findLiteral(path);
+
+    // Merged expression tells if any regex item matches, find out which one
+    if (bCombined_ && boost::regex_search(path, combined_)) {
+        for (auto index : regex_items_) {
+            if (index >= first)
+                break;
+            if (boost::regex_search(path, blacklist_[index].regex)) {
+                first = index;
+                break;
+            }
+        }
+    }
+
+    for (auto index : separate_items_) {
+        if (index >= first)
+            break;
+        if (boost::regex_search(path, blacklist_[index].regex)) {
+            first = index;
+            break;
+        }
+    }
+
+    return (first < blacklist_.size()) ? &blacklist_[first] : nullptr;
+}
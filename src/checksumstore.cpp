@@ -0,0 +1,879 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "checksumstore.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#include <tinyxml2.h>
+
+static const std::string CHECKSUMSTORE_LOG_NAME = "checksums";
+static const std::string CHECKSUMSTORE_INDEX_EXT = ".idx";
+static const std::string CHECKSUMSTORE_CHUNKS_EXT = ".chunks";
+static const std::string CHECKSUMSTORE_LOCK_FILE = "checksums.lock";
+static const std::string CHECKSUMSTORE_GENERATION_FILE = "checksums.gen";
+static const std::string CHECKSUMSTORE_DELETED = "-";
+static const unsigned int CHECKSUMSTORE_OPEN_RETRIES = 10;
+
+static std::vector<std::string> splitString(const std::string& str, const char& delim)
+{
+    std::vector<std::string> tokens;
+    size_t pos = 0, end;
+    while ((end = str.find(delim, pos)) != std::string::npos)
+    {
+        tokens.push_back(str.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    tokens.push_back(str.substr(pos));
+    return tokens;
+}
+
+static bool parseUInt(const std::string& str, uintmax_t& value)
+{
+    if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    errno = 0;
+    value = std::strtoull(str.c_str(), NULL, 10);
+    return errno == 0;
+}
+
+static bool isValidField(const std::string& str)
+{
+    return str.find_first_of("\t\n") == std::string::npos;
+}
+
+static bool writeAll(const int& fd, const std::string& data)
+{
+    size_t written = 0;
+    while (written < data.size())
+    {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        written += n;
+    }
+    return true;
+}
+
+static std::string makeChunkTable(const std::vector<checksumChunk>& chunks)
+{
+    std::string table;
+    for (auto chunk : chunks)
+    {
+        if (!table.empty())
+            table += " ";
+        table += std::to_string(chunk.from) + "-" + std::to_string(chunk.to) + ":" + chunk.md5;
+    }
+    table += "\n";
+    return table;
+}
+
+static bool isEntryAttribute(const std::string& name)
+{
+    return name == "name" || name == "chunks" || name == "total_size" || name == "md5";
+}
+
+static std::string encodeAttribute(const std::string& str)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string encoded;
+    for (auto c : str)
+    {
+        if (c == '%' || c == '&' || c == '=' || c == '\t' || c == '\n' || c == '\r')
+        {
+            encoded += '%';
+            encoded += hex[static_cast<unsigned char>(c) >> 4];
+            encoded += hex[static_cast<unsigned char>(c) & 0xF];
+        }
+        else
+            encoded += c;
+    }
+    return encoded;
+}
+
+static bool decodeAttribute(const std::string& str, std::string& decoded)
+{
+    decoded.clear();
+    for (size_t i = 0; i < str.size(); ++i)
+    {
+        if (str[i] != '%')
+        {
+            decoded += str[i];
+            continue;
+        }
+        if (i + 2 >= str.size() || !std::isxdigit(static_cast<unsigned char>(str[i+1])) || !std::isxdigit(static_cast<unsigned char>(str[i+2])))
+            return false;
+        decoded += static_cast<char>(std::stoi(str.substr(i + 1, 2), nullptr, 16));
+        i += 2;
+    }
+    return true;
+}
+
+// Values of entry members are not duplicated, only their position is stored
+static std::string makeAttributeList(const std::vector<std::pair<std::string, std::string>>& attributes)
+{
+    std::string list;
+    for (auto attribute : attributes)
+    {
+        if (!list.empty())
+            list += "&";
+        list += encodeAttribute(attribute.first) + "=";
+        if (!isEntryAttribute(attribute.first))
+            list += encodeAttribute(attribute.second);
+    }
+    return list;
+}
+
+static bool parseAttributeList(const std::string& list, std::vector<std::pair<std::string, std::string>>& attributes)
+{
+    attributes.clear();
+    if (list.empty())
+        return true;
+
+    for (auto token : splitString(list, '&'))
+    {
+        std::pair<std::string, std::string> attribute;
+        size_t eq = token.find('=');
+        if (eq == std::string::npos || !decodeAttribute(token.substr(0, eq), attribute.first) || !decodeAttribute(token.substr(eq + 1), attribute.second))
+            return false;
+        attributes.push_back(attribute);
+    }
+    return true;
+}
+
+static bool readFile(const std::string& filepath, std::string& data)
+{
+    std::ifstream ifs(filepath, std::ifstream::in | std::ifstream::binary);
+    if (!ifs)
+        return false;
+    data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool writeFile(const std::string& filepath, const std::string& data)
+{
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(boost::filesystem::path(filepath).parent_path(), ec);
+    std::ofstream ofs(filepath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!ofs)
+        return false;
+    ofs << data;
+    ofs.close();
+    return !ofs.fail();
+}
+
+ChecksumStore::~ChecksumStore()
+{
+    this->closeFiles();
+}
+
+void ChecksumStore::setDirectory(const std::string& directory)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    this->closeFiles();
+
+    directory_ = directory;
+    while (directory_.size() > 1 && directory_.back() == '/')
+        directory_.pop_back();
+    read_only_ = false;
+    missing_ = false;
+}
+
+bool ChecksumStore::open(const std::string& directory)
+{
+    this->setDirectory(directory);
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    return this->ensureOpen(true);
+}
+
+void ChecksumStore::close()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    this->closeFiles();
+}
+
+void ChecksumStore::closeLogs()
+{
+    if (index_fd_ >= 0)
+        ::close(index_fd_);
+    if (chunks_fd_ >= 0)
+        ::close(chunks_fd_);
+    index_fd_ = -1;
+    chunks_fd_ = -1;
+    writable_ = false;
+    index_size_ = 0;
+    index_.clear();
+}
+
+void ChecksumStore::closeFiles()
+{
+    this->closeLogs();
+    if (lock_fd_ >= 0)
+        ::close(lock_fd_);
+    lock_fd_ = -1;
+}
+
+std::string ChecksumStore::getLogPath(const uintmax_t& generation, const std::string& extension) const
+{
+    if (generation == 0)
+        return directory_ + "/" + CHECKSUMSTORE_LOG_NAME + extension;
+    return directory_ + "/" + CHECKSUMSTORE_LOG_NAME + "." + std::to_string(generation) + extension;
+}
+
+uintmax_t ChecksumStore::readGeneration() const
+{
+    std::string data;
+    uintmax_t generation = 0;
+    if (readFile(directory_ + "/" + CHECKSUMSTORE_GENERATION_FILE, data))
+    {
+        while (!data.empty() && data.back() == '\n')
+            data.pop_back();
+        if (!parseUInt(data, generation))
+            generation = 0;
+    }
+    return generation;
+}
+
+// Logs have been unlinked by compaction in this or other process
+// Called with mtx_ locked
+bool ChecksumStore::isReplaced() const
+{
+    struct stat st;
+    return index_fd_ >= 0 && fstat(index_fd_, &st) == 0 && st.st_nlink == 0;
+}
+
+// Open logs of current generation
+// Files are created only if bCreate is set, which requires lock_fd_ to be locked so that generation can't change
+// Called with mtx_ locked
+bool ChecksumStore::openLogs(const bool& bWrite, const bool& bCreate)
+{
+    this->closeLogs();
+
+    int flags = (bWrite ? (O_RDWR | O_APPEND) : O_RDONLY) | O_CLOEXEC;
+    if (bCreate)
+        flags |= O_CREAT;
+
+    // Without lock compaction can switch generation between reading generation and opening logs
+    for (unsigned int i = 0; i < CHECKSUMSTORE_OPEN_RETRIES; ++i)
+    {
+        generation_ = this->readGeneration();
+        index_fd_ = ::open(this->getLogPath(generation_, CHECKSUMSTORE_INDEX_EXT).c_str(), flags, 0644);
+        chunks_fd_ = ::open(this->getLogPath(generation_, CHECKSUMSTORE_CHUNKS_EXT).c_str(), flags, 0644);
+        if (index_fd_ >= 0 && chunks_fd_ >= 0 && !this->isReplaced())
+        {
+            writable_ = bWrite;
+            this->refresh();
+            return true;
+        }
+
+        bool bMissing = (errno == ENOENT);
+        this->closeLogs();
+        if (bCreate || (bMissing && generation_ == this->readGeneration()))
+            break;
+    }
+
+    return false;
+}
+
+// Open store for reading or writing on first use
+// Reading never creates files so that commands which only check files leave XML directory untouched
+// Called with mtx_ locked
+bool ChecksumStore::ensureOpen(const bool& bWrite)
+{
+    if (index_fd_ >= 0 && (writable_ || !bWrite || read_only_))
+        return writable_ || !bWrite;
+    if (directory_.empty())
+        return false;
+
+    if (!bWrite)
+    {
+        if (missing_)
+            return false;
+        if (!this->openLogs(false, false))
+            missing_ = true;
+        return this->isOpen();
+    }
+
+    if (read_only_)
+        return false;
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(directory_, ec);
+
+    bool bResult = false;
+    if (lock_fd_ < 0)
+        lock_fd_ = ::open((directory_ + "/" + CHECKSUMSTORE_LOCK_FILE).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd_ >= 0 && flock(lock_fd_, LOCK_EX) == 0)
+    {
+        bResult = this->openLogs(true, true);
+        flock(lock_fd_, LOCK_UN);
+    }
+
+    if (!bResult)
+    {
+        // Existing store on read-only filesystem
+        std::cerr << "Failed to open checksum store in " << directory_ << " for writing, using XML files" << std::endl;
+        read_only_ = true;
+        if (lock_fd_ >= 0)
+            ::close(lock_fd_);
+        lock_fd_ = -1;
+        missing_ = !this->openLogs(false, false);
+    }
+    else
+        missing_ = false;
+
+    return bResult;
+}
+
+bool ChecksumStore::getKey(const std::string& xml_filepath, std::string& key) const
+{
+    if (directory_.empty())
+        return false;
+
+    std::string prefix = directory_ + "/";
+    if (xml_filepath.compare(0, prefix.size(), prefix) != 0)
+        return false;
+
+    std::string relative_path = xml_filepath.substr(prefix.size());
+    if (relative_path.size() <= 4 || relative_path.compare(relative_path.size() - 4, 4, ".xml") != 0)
+        return false;
+    relative_path.erase(relative_path.size() - 4);
+
+    // Normalize empty path components caused by empty gamename
+    key.clear();
+    for (auto component : splitString(relative_path, '/'))
+    {
+        if (component.empty() || component == ".")
+            continue;
+        if (component == "..")
+            return false;
+        if (!key.empty())
+            key += "/";
+        key += component;
+    }
+
+    return !key.empty() && isValidField(key);
+}
+
+// Read records appended by this and other processes since last refresh
+// Called with mtx_ locked
+void ChecksumStore::refresh()
+{
+    struct stat st;
+    if (index_fd_ < 0 || fstat(index_fd_, &st) != 0)
+        return;
+
+    // Logs were compacted, reload index from logs of new generation
+    if (st.st_nlink == 0)
+    {
+        this->openLogs(writable_, false);
+        return;
+    }
+
+    if (static_cast<uintmax_t>(st.st_size) <= index_size_)
+        return;
+
+    std::string buffer(st.st_size - index_size_, '\0');
+    size_t bytes_read = 0;
+    while (bytes_read < buffer.size())
+    {
+        ssize_t n = pread(index_fd_, &buffer[bytes_read], buffer.size() - bytes_read, index_size_ + bytes_read);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        bytes_read += n;
+    }
+    buffer.resize(bytes_read);
+
+    // Incomplete record at the end is parsed on next refresh
+    size_t pos = 0, end;
+    while ((end = buffer.find('\n', pos)) != std::string::npos)
+    {
+        this->parseIndexRecord(buffer.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    index_size_ += pos;
+}
+
+void ChecksumStore::parseIndexRecord(const std::string& line)
+{
+    std::vector<std::string> fields = splitString(line, '\t');
+    if (fields.size() == 2 && fields[1] == CHECKSUMSTORE_DELETED)
+    {
+        index_.erase(fields[0]);
+        return;
+    }
+
+    indexRecord record;
+    if ((fields.size() != 7 && fields.size() != 8) || fields[0].empty())
+        return;
+    if (!parseUInt(fields[2], record.total_size) || !parseUInt(fields[4], record.chunk_count) || !parseUInt(fields[5], record.chunk_offset) || !parseUInt(fields[6], record.chunk_length))
+        return;
+    record.name = fields[1];
+    record.md5 = fields[3];
+    if (fields.size() == 8)
+        record.attributes = fields[7];
+
+    index_[fields[0]] = record;
+}
+
+// Chunks are read with the same lock so that chunk offsets of the record refer to the open chunk log
+bool ChecksumStore::find(const std::string& key, indexRecord& record, std::vector<checksumChunk>* chunks)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!this->ensureOpen(false))
+        return false;
+    this->refresh();
+
+    auto it = index_.find(key);
+    if (it == index_.end())
+        return false;
+
+    record = it->second;
+    if (chunks)
+        return this->readChunks(record, *chunks);
+    return true;
+}
+
+bool ChecksumStore::readChunkTable(const indexRecord& record, std::string& table) const
+{
+    table.assign(record.chunk_length, '\0');
+    size_t bytes_read = 0;
+    while (bytes_read < table.size())
+    {
+        ssize_t n = pread(chunks_fd_, &table[bytes_read], table.size() - bytes_read, record.chunk_offset + bytes_read);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        bytes_read += n;
+    }
+
+    return !table.empty() && table.back() == '\n';
+}
+
+bool ChecksumStore::readChunks(const indexRecord& record, std::vector<checksumChunk>& chunks) const
+{
+    chunks.clear();
+    if (record.chunk_length == 0)
+        return record.chunk_count == 0;
+
+    std::string buffer;
+    if (!this->readChunkTable(record, buffer))
+        return false;
+    buffer.pop_back();
+
+    if (!buffer.empty())
+    {
+        for (auto token : splitString(buffer, ' '))
+        {
+            checksumChunk chunk;
+            size_t dash = token.find('-');
+            size_t colon = token.find(':');
+            if (dash == std::string::npos || colon == std::string::npos || colon < dash)
+                return false;
+            if (!parseUInt(token.substr(0, dash), chunk.from) || !parseUInt(token.substr(dash + 1, colon - dash - 1), chunk.to))
+                return false;
+            chunk.md5 = token.substr(colon + 1);
+            chunks.push_back(chunk);
+        }
+    }
+
+    return chunks.size() == record.chunk_count;
+}
+
+// Append record to logs, entry == nullptr deletes the key
+bool ChecksumStore::append(const std::string& key, const checksumEntry* entry)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!this->ensureOpen(true))
+        return false;
+
+    std::string record = key + "\t";
+    std::string chunk_table;
+    if (entry)
+    {
+        for (auto chunk : entry->chunks)
+        {
+            if (chunk.md5.find_first_of(" \n") != std::string::npos)
+                return false;
+        }
+        chunk_table = makeChunkTable(entry->chunks);
+    }
+
+    // Lock file serializes appends and compaction between processes so that chunk offsets stay valid
+    if (flock(lock_fd_, LOCK_EX) != 0)
+        return false;
+
+    // Don't append to logs that were replaced by compaction after they were opened
+    if (this->isReplaced() && !this->openLogs(true, true))
+    {
+        flock(lock_fd_, LOCK_UN);
+        return false;
+    }
+
+    bool bResult = false;
+    struct stat st_index, st_chunks;
+    if (fstat(index_fd_, &st_index) == 0 && fstat(chunks_fd_, &st_chunks) == 0)
+    {
+        if (entry)
+        {
+            record += entry->name + "\t" + std::to_string(entry->total_size) + "\t" + entry->md5 + "\t"
+                    + std::to_string(entry->chunks.size()) + "\t" + std::to_string(st_chunks.st_size) + "\t" + std::to_string(chunk_table.size()) + "\t"
+                    + makeAttributeList(entry->attributes);
+        }
+        else
+            record += CHECKSUMSTORE_DELETED;
+        record += "\n";
+
+        // Terminate record left incomplete by interrupted write so that it doesn't corrupt this one
+        char last_char = '\n';
+        if (st_index.st_size > 0 && pread(index_fd_, &last_char, 1, st_index.st_size - 1) == 1 && last_char != '\n')
+            record = "\n" + record;
+
+        if (!entry || writeAll(chunks_fd_, chunk_table))
+            bResult = writeAll(index_fd_, record);
+    }
+    this->refresh();
+
+    flock(lock_fd_, LOCK_UN);
+    return bResult;
+}
+
+bool ChecksumStore::exists(const std::string& xml_filepath)
+{
+    std::string key;
+    indexRecord record;
+    if (this->getKey(xml_filepath, key) && this->find(key, record))
+        return true;
+
+    boost::system::error_code ec;
+    return boost::filesystem::exists(xml_filepath, ec);
+}
+
+bool ChecksumStore::getEntry(const std::string& xml_filepath, checksumEntry& entry, const bool& bWithChunks)
+{
+    std::string key;
+    indexRecord record;
+    if (this->getKey(xml_filepath, key) && this->find(key, record, bWithChunks ? &entry.chunks : nullptr))
+    {
+        entry.name = record.name;
+        entry.total_size = record.total_size;
+        entry.md5 = record.md5;
+        if (!bWithChunks)
+            entry.chunks.clear();
+        return parseAttributeList(record.attributes, entry.attributes);
+    }
+
+    std::string xml_data;
+    if (!readFile(xml_filepath, xml_data))
+        return false;
+
+    return parseXML(xml_data, entry);
+}
+
+std::string ChecksumStore::getXML(const std::string& xml_filepath)
+{
+    std::string xml_data;
+    std::string key;
+    indexRecord record;
+    if (this->getKey(xml_filepath, key) && this->find(key, record))
+    {
+        checksumEntry entry;
+        if (this->getEntry(xml_filepath, entry, true))
+            xml_data = makeXML(entry);
+        return xml_data;
+    }
+
+    readFile(xml_filepath, xml_data);
+    return xml_data;
+}
+
+bool ChecksumStore::saveXML(const std::string& xml_filepath, const std::string& xml_data)
+{
+    checksumEntry entry;
+    if (parseXML(xml_data, entry) && this->save(xml_filepath, entry))
+        return true;
+
+    return writeFile(xml_filepath, xml_data);
+}
+
+bool ChecksumStore::save(const std::string& xml_filepath, const checksumEntry& entry)
+{
+    std::string key;
+    if (!this->getKey(xml_filepath, key))
+        return false;
+
+    if (!isValidField(entry.name) || !isValidField(entry.md5) || entry.name == CHECKSUMSTORE_DELETED)
+        return false;
+
+    return this->append(key, &entry);
+}
+
+bool ChecksumStore::remove(const std::string& xml_filepath)
+{
+    bool bRemoved = false;
+    std::string key;
+    indexRecord record;
+    if (this->getKey(xml_filepath, key) && this->find(key, record))
+        bRemoved = this->append(key, nullptr);
+
+    boost::system::error_code ec;
+    if (boost::filesystem::remove(xml_filepath, ec))
+        bRemoved = true;
+
+    return bRemoved;
+}
+
+unsigned int ChecksumStore::importXML(const std::function<void(const std::string&)>& callback)
+{
+    unsigned int imported = 0;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!this->ensureOpen(true))
+            return imported;
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::recursive_directory_iterator it(directory_, ec), end;
+    for (; !ec && it != end; it.increment(ec))
+    {
+        std::string filepath = it->path().string();
+        std::string key;
+        indexRecord record;
+        if (!boost::filesystem::is_regular_file(it->path(), ec) || !this->getKey(filepath, key) || this->find(key, record))
+            continue;
+
+        std::string xml_data;
+        checksumEntry entry;
+        if (!readFile(filepath, xml_data) || !parseXML(xml_data, entry))
+            continue;
+
+        if (this->save(filepath, entry))
+        {
+            imported++;
+            if (callback)
+                callback(filepath);
+        }
+    }
+
+    this->compact();
+
+    return imported;
+}
+
+unsigned int ChecksumStore::exportXML(const std::string& directory, const std::function<void(const std::string&)>& callback)
+{
+    unsigned int exported = 0;
+    std::vector<std::string> keys;
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!this->ensureOpen(false))
+            return exported;
+        this->refresh();
+        for (auto it : index_)
+            keys.push_back(it.first);
+    }
+
+    for (auto key : keys)
+    {
+        checksumEntry entry;
+        if (!this->getEntry(directory_ + "/" + key + ".xml", entry, true))
+            continue;
+
+        std::string filepath = directory + "/" + key + ".xml";
+        if (writeFile(filepath, makeXML(entry)))
+        {
+            exported++;
+            if (callback)
+                callback(filepath);
+        }
+    }
+
+    return exported;
+}
+
+bool ChecksumStore::compact()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (!this->ensureOpen(true))
+        return false;
+
+    // Lock is held until logs of new generation are open so that no other process can append to old logs
+    if (flock(lock_fd_, LOCK_EX) != 0)
+        return false;
+    if (this->isReplaced() && !this->openLogs(true, true))
+    {
+        flock(lock_fd_, LOCK_UN);
+        return false;
+    }
+    this->refresh();
+
+    uintmax_t old_generation = generation_;
+    uintmax_t new_generation = generation_ + 1;
+    std::string index_path = this->getLogPath(new_generation, CHECKSUMSTORE_INDEX_EXT);
+    std::string chunks_path = this->getLogPath(new_generation, CHECKSUMSTORE_CHUNKS_EXT);
+    std::string generation_path = directory_ + "/" + CHECKSUMSTORE_GENERATION_FILE;
+    std::ofstream ofs_index(index_path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    std::ofstream ofs_chunks(chunks_path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    bool bResult = ofs_index && ofs_chunks;
+
+    // Chunk tables are copied as they are, record is rewritten only if its chunk table is valid
+    std::vector<std::string> unreadable_keys;
+    uintmax_t chunk_offset = 0;
+    for (auto it = index_.begin(); bResult && it != index_.end(); ++it)
+    {
+        std::string chunk_table;
+        std::vector<checksumChunk> chunks;
+        if (!this->readChunks(it->second, chunks) || (it->second.chunk_length > 0 && !this->readChunkTable(it->second, chunk_table)))
+        {
+            unreadable_keys.push_back(it->first);
+            continue;
+        }
+
+        ofs_chunks << chunk_table;
+        ofs_index << it->first << "\t" << it->second.name << "\t" << it->second.total_size << "\t" << it->second.md5 << "\t"
+                  << it->second.chunk_count << "\t" << chunk_offset << "\t" << chunk_table.size() << "\t" << it->second.attributes << "\n";
+        chunk_offset += chunk_table.size();
+    }
+    ofs_index.close();
+    ofs_chunks.close();
+    bResult = bResult && !ofs_index.fail() && !ofs_chunks.fail();
+
+    // Keep old logs instead of dropping records that can't be rewritten
+    if (!unreadable_keys.empty())
+    {
+        std::cerr << "Checksum store compaction skipped, chunk table of " << unreadable_keys.size() << " record(s) can't be read:" << std::endl;
+        for (auto key : unreadable_keys)
+            std::cerr << "\t" << key << std::endl;
+        bResult = false;
+    }
+
+    // Renaming generation file switches every process to new logs at once
+    // Old logs are unlinked after the switch so that other processes notice the change and reopen
+    if (bResult)
+        bResult = writeFile(generation_path + ".tmp", std::to_string(new_generation) + "\n") && std::rename((generation_path + ".tmp").c_str(), generation_path.c_str()) == 0;
+
+    if (bResult)
+    {
+        std::remove(this->getLogPath(old_generation, CHECKSUMSTORE_CHUNKS_EXT).c_str());
+        std::remove(this->getLogPath(old_generation, CHECKSUMSTORE_INDEX_EXT).c_str());
+    }
+    else
+    {
+        std::remove((generation_path + ".tmp").c_str());
+        std::remove(index_path.c_str());
+        std::remove(chunks_path.c_str());
+    }
+
+    // Reopen logs and reload index
+    if (!this->openLogs(true, true))
+        bResult = false;
+    flock(lock_fd_, LOCK_UN);
+
+    return bResult;
+}
+
+bool ChecksumStore::parseXML(const std::string& xml_data, checksumEntry& entry)
+{
+    tinyxml2::XMLDocument xml;
+    if (xml.Parse(xml_data.c_str(), xml_data.size()) != tinyxml2::XML_SUCCESS)
+        return false;
+
+    tinyxml2::XMLElement *fileElem = xml.FirstChildElement("file");
+    if (!fileElem)
+        return false;
+
+    const char* name = fileElem->Attribute("name");
+    const char* md5 = fileElem->Attribute("md5");
+    const char* total_size = fileElem->Attribute("total_size");
+    entry.name = name ? name : "";
+    entry.md5 = md5 ? md5 : "";
+    entry.total_size = 0;
+    if (total_size && !parseUInt(total_size, entry.total_size))
+        return false;
+
+    entry.attributes.clear();
+    for (const tinyxml2::XMLAttribute *attr = fileElem->FirstAttribute(); attr; attr = attr->Next())
+        entry.attributes.push_back(std::make_pair(std::string(attr->Name()), std::string(attr->Value())));
+
+    entry.chunks.clear();
+    tinyxml2::XMLElement *chunkElem = fileElem->FirstChildElement("chunk");
+    while (chunkElem)
+    {
+        checksumChunk chunk;
+        const char* from = chunkElem->Attribute("from");
+        const char* to = chunkElem->Attribute("to");
+        const char* hash = chunkElem->GetText();
+        if (!from || !to || !hash || !parseUInt(from, chunk.from) || !parseUInt(to, chunk.to))
+            return false;
+        chunk.md5 = hash;
+        entry.chunks.push_back(chunk);
+        chunkElem = chunkElem->NextSiblingElement("chunk");
+    }
+
+    return true;
+}
+
+std::string ChecksumStore::makeXML(const checksumEntry& entry)
+{
+    tinyxml2::XMLDocument xml;
+    tinyxml2::XMLElement *fileElem = xml.NewElement("file");
+
+    // Attributes are written in original order, entry members replace stored values
+    std::vector<std::pair<std::string, std::string>> attributes = entry.attributes;
+    for (auto name : { "name", "chunks", "total_size", "md5" })
+    {
+        bool bFound = false;
+        for (auto attribute : attributes)
+            bFound = bFound || attribute.first == name;
+        if (!bFound)
+            attributes.push_back(std::make_pair(std::string(name), std::string()));
+    }
+
+    for (auto attribute : attributes)
+    {
+        if (attribute.first == "name")
+            fileElem->SetAttribute("name", entry.name.c_str());
+        else if (attribute.first == "chunks")
+            fileElem->SetAttribute("chunks", static_cast<unsigned int>(entry.chunks.size()));
+        else if (attribute.first == "total_size")
+            fileElem->SetAttribute("total_size", std::to_string(entry.total_size).c_str());
+        else if (attribute.first == "md5")
+            fileElem->SetAttribute("md5", entry.md5.c_str());
+        else
+            fileElem->SetAttribute(attribute.first.c_str(), attribute.second.c_str());
+    }
+
+    for (unsigned int i = 0; i < entry.chunks.size(); ++i)
+    {
+        tinyxml2::XMLElement *chunkElem = xml.NewElement("chunk");
+        chunkElem->SetAttribute("id", i);
+        chunkElem->SetAttribute("from", std::to_string(entry.chunks[i].from).c_str());
+        chunkElem->SetAttribute("to", std::to_string(entry.chunks[i].to).c_str());
+        chunkElem->SetAttribute("method", "md5");
+        chunkElem->LinkEndChild(xml.NewText(entry.chunks[i].md5.c_str()));
+        fileElem->LinkEndChild(chunkElem);
+    }
+    xml.LinkEndChild(fileElem);
+
+    tinyxml2::XMLPrinter printer;
+    xml.Print(&printer);
+    return std::string(printer.CStr());
+}
@@ -0,0 +1,134 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "chunkcache.h"
+
+bool ChunkCache::addReference(const galaxyChunkDigest& md5_compressed)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    cacheEntry& entry = entries_[md5_compressed];
+    entry.references++;
+    return entry.references == 1;
+}
+
+void ChunkCache::finalize()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (auto it = entries_.begin(); it != entries_.end(); )
+    {
+        if (it->second.references < 2)
+            it = entries_.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ChunkCache::clear()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    entries_.clear();
+    lru_.clear();
+    size_ = 0;
+}
+
+void ChunkCache::setMaxSize(const uintmax_t& iMaxSize)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    max_size_ = iMaxSize;
+}
+
+void ChunkCache::evict(cacheEntry& entry)
+{
+    if (!entry.bHasData)
+        return;
+
+    size_ -= entry.data.size();
+    lru_.erase(entry.lru_it);
+    std::string().swap(entry.data);
+    entry.bHasData = false;
+}
+
+unsigned int ChunkCache::acquire(const galaxyChunkDigest& md5_compressed, std::string& data, chunkRegion& region)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto it = entries_.find(md5_compressed);
+    if (it == entries_.end())
+        return CHUNKCACHE_DOWNLOAD; // Chunk is used only once
+
+    cacheEntry& entry = it->second;
+    while (entry.bInFlight)
+        cv_.wait(lock);
+
+    if (entry.references > 0)
+        entry.references--;
+
+    if (entry.bHasData)
+    {
+        data = entry.data;
+        if (entry.references == 0)
+            this->evict(entry);
+        else
+            lru_.splice(lru_.begin(), lru_, entry.lru_it);
+        return CHUNKCACHE_MEMORY;
+    }
+
+    if (entry.bHasRegion)
+    {
+        region = entry.region;
+        return CHUNKCACHE_FILE;
+    }
+
+    entry.bInFlight = true;
+    return CHUNKCACHE_DOWNLOAD;
+}
+
+void ChunkCache::complete(const galaxyChunkDigest& md5_compressed, const char* data, const uintmax_t& size, const chunkRegion& region)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto it = entries_.find(md5_compressed);
+    if (it == entries_.end())
+        return;
+
+    cacheEntry& entry = it->second;
+    entry.bInFlight = false;
+    entry.region = region;
+    entry.bHasRegion = true;
+
+    if (data != NULL && !entry.bHasData && entry.references > 0 && size <= max_size_)
+    {
+        entry.data.assign(data, size);
+        entry.bHasData = true;
+        lru_.push_front(md5_compressed);
+        entry.lru_it = lru_.begin();
+        size_ += size;
+
+        while (size_ > max_size_ && !lru_.empty())
+            this->evict(entries_[lru_.back()]);
+    }
+
+    cv_.notify_all();
+}
+
+void ChunkCache::abort(const galaxyChunkDigest& md5_compressed)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto it = entries_.find(md5_compressed);
+    if (it == entries_.end())
+        return;
+
+    it->second.bInFlight = false;
+    cv_.notify_all();
+}
+
+void ChunkCache::renameFile(const std::string& from_filepath, const std::string& to_filepath)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (auto& it : entries_)
+    {
+        if (it.second.bHasRegion && it.second.region.filepath == from_filepath)
+            it.second.region.filepath = to_filepath;
+    }
+}
@@ -0,0 +1,221 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "chunkstore.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+#include <utime.h>
+#include <boost/filesystem.hpp>
+
+static bool isValidChunkName(const std::string& name)
+{
+    if (name.size() != 32)
+        return false;
+    return name.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+void ChunkStore::init(const std::string& directory, const uintmax_t& iMaxSize, const bool& bReadOnly)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    directory_ = directory;
+    while (directory_.size() > 1 && directory_.back() == '/')
+        directory_.pop_back();
+    max_size_ = iMaxSize;
+    read_only_ = bReadOnly;
+    size_known_ = false;
+    size_ = 0;
+}
+
+std::string ChunkStore::getChunkPath(const std::string& md5_compressed) const
+{
+    return directory_ + "/" + md5_compressed.substr(0, 2) + "/" + md5_compressed.substr(2, 2) + "/" + md5_compressed;
+}
+
+bool ChunkStore::get(const std::string& md5_compressed, std::string& data)
+{
+    if (!this->isEnabled() || !isValidChunkName(md5_compressed))
+        return false;
+
+    std::string filepath = this->getChunkPath(md5_compressed);
+    std::ifstream ifs(filepath, std::ifstream::in | std::ifstream::binary);
+    if (!ifs)
+        return false;
+
+    ifs.seekg(0, ifs.end);
+    std::streamoff filesize = ifs.tellg();
+    ifs.seekg(0, ifs.beg);
+    if (filesize <= 0)
+        return false;
+
+    data.resize(filesize);
+    ifs.read(&data[0], filesize);
+    bool bReadOK = (ifs.gcount() == filesize);
+    ifs.close();
+
+    if (!bReadOK || Util::getChunkHash((unsigned char*)&data[0], data.size(), RHASH_MD5) != md5_compressed)
+    {
+        data.clear();
+        if (!read_only_)
+            std::remove(filepath.c_str());
+        return false;
+    }
+
+    // Update modification time for LRU eviction
+    if (!read_only_)
+        utime(filepath.c_str(), NULL);
+
+    return true;
+}
+
+bool ChunkStore::put(const std::string& md5_compressed, const char* data, const uintmax_t& size)
+{
+    if (!this->isEnabled() || read_only_ || !isValidChunkName(md5_compressed))
+        return false;
+
+    std::string filepath = this->getChunkPath(md5_compressed);
+    if (access(filepath.c_str(), F_OK) == 0)
+        return true;
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(boost::filesystem::path(filepath).parent_path(), ec);
+    if (ec)
+        return false;
+
+    // Unique temporary file name so that concurrent writers on different threads or hosts don't collide
+    std::string filepath_tmp = filepath + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::ofstream ofs(filepath_tmp, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!ofs)
+        return false;
+    ofs.write(data, size);
+    ofs.close();
+    if (!ofs || std::rename(filepath_tmp.c_str(), filepath.c_str()) != 0)
+    {
+        std::remove(filepath_tmp.c_str());
+        return false;
+    }
+
+    if (max_size_ > 0)
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (!size_known_)
+        {
+            size_ = 0;
+            this->walk([this](const std::string& path, const std::string& name)
+            {
+                if (isValidChunkName(name))
+                    size_ += boost::filesystem::file_size(path);
+            });
+            size_known_ = true;
+        }
+        else
+            size_ += size;
+
+        if (size_ > max_size_)
+            this->evict();
+    }
+
+    return true;
+}
+
+void ChunkStore::walk(const std::function<void(const std::string&, const std::string&)>& f) const
+{
+    boost::system::error_code ec;
+    if (!boost::filesystem::is_directory(directory_, ec))
+        return;
+
+    boost::filesystem::recursive_directory_iterator it(directory_, ec), end;
+    for (; !ec && it != end; it.increment(ec))
+    {
+        try
+        {
+            if (boost::filesystem::is_regular_file(it->status()))
+                f(it->path().string(), it->path().filename().string());
+        }
+        catch (const boost::filesystem::filesystem_error& e)
+        {
+            // File was removed by another process during walk
+            continue;
+        }
+    }
+}
+
+// Delete least recently used chunks until store is at 90% of maximum size
+// Called with mtx_ locked
+void ChunkStore::evict()
+{
+    std::vector<std::tuple<std::time_t, std::string, uintmax_t>> chunks;
+    uintmax_t total_size = 0;
+    this->walk([&](const std::string& path, const std::string& name)
+    {
+        if (!isValidChunkName(name))
+            return;
+        uintmax_t filesize = boost::filesystem::file_size(path);
+        chunks.push_back(std::make_tuple(boost::filesystem::last_write_time(path), path, filesize));
+        total_size += filesize;
+    });
+
+    std::sort(chunks.begin(), chunks.end());
+    uintmax_t target_size = max_size_ - max_size_ / 10;
+    for (auto it = chunks.begin(); it != chunks.end() && total_size > target_size; ++it)
+    {
+        if (std::remove(std::get<1>(*it).c_str()) == 0)
+            total_size -= std::get<2>(*it);
+    }
+    size_ = total_size;
+}
+
+chunkStoreScanResult ChunkStore::check(const std::function<void(const std::string&)>& callback)
+{
+    chunkStoreScanResult result;
+    std::unique_lock<std::mutex> lock(mtx_);
+    this->walk([&](const std::string& path, const std::string& name)
+    {
+        bool bValid = false;
+        uintmax_t filesize = boost::filesystem::file_size(path);
+        if (isValidChunkName(name) && path == this->getChunkPath(name))
+        {
+            std::string data;
+            std::ifstream ifs(path, std::ifstream::in | std::ifstream::binary);
+            if (ifs)
+            {
+                data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+                bValid = (!data.empty() && Util::getChunkHash((unsigned char*)&data[0], data.size(), RHASH_MD5) == name);
+            }
+        }
+
+        if (bValid)
+        {
+            result.chunks++;
+            result.size += filesize;
+            return;
+        }
+
+        // Temporary file may belong to download that is still in progress on another host
+        if (name.find(".tmp") != std::string::npos && boost::filesystem::last_write_time(path) > time(NULL) - 24*60*60)
+            return;
+
+        result.invalid++;
+        if (callback)
+            callback(path);
+        if (!read_only_ && std::remove(path.c_str()) == 0)
+            result.removed++;
+    });
+
+    if (!read_only_)
+    {
+        size_ = result.size;
+        size_known_ = true;
+    }
+
+    return result;
+}
@@ -0,0 +1,417 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "depotmanifestparser.h"
+
+#include <cstdlib>
+#include <cstring>
+
+static const unsigned int MANIFEST_MAX_DEPTH = 512;
+
+static void appendUtf8(std::string& str, const uint32_t& cp)
+{
+    if (cp < 0x80)
+        str.push_back(static_cast<char>(cp));
+    else if (cp < 0x800)
+    {
+        str.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else if (cp < 0x10000)
+    {
+        str.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else
+    {
+        str.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+static bool parseHex4(const char* p, uint32_t& value)
+{
+    value = 0;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        char c = p[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return false;
+    }
+    return true;
+}
+
+bool DepotManifestParser::fail(const std::string& msg)
+{
+    if (error_.empty())
+        error_ = msg;
+    return false;
+}
+
+void DepotManifestParser::skipWhitespace()
+{
+    while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t'))
+        ++pos_;
+}
+
+bool DepotManifestParser::consume(const char& c)
+{
+    if (pos_ < end_ && *pos_ == c)
+    {
+        ++pos_;
+        return true;
+    }
+    return false;
+}
+
+template <typename F> bool DepotManifestParser::parseObject(F f)
+{
+    skipWhitespace();
+    if (!consume('{'))
+        return fail("expected object");
+    skipWhitespace();
+    if (consume('}'))
+        return true;
+
+    std::string key;
+    while (true)
+    {
+        skipWhitespace();
+        if (!parseString(key))
+            return false;
+        skipWhitespace();
+        if (!consume(':'))
+            return fail("expected ':' after \"" + key + "\"");
+        skipWhitespace();
+        if (!f(key))
+            return false;
+        skipWhitespace();
+        if (consume(','))
+            continue;
+        if (consume('}'))
+            return true;
+        return fail("expected ',' or '}' in object");
+    }
+}
+
+template <typename F> bool DepotManifestParser::parseArray(F f)
+{
+    skipWhitespace();
+    if (!consume('['))
+        return fail("expected array");
+    skipWhitespace();
+    if (consume(']'))
+        return true;
+
+    while (true)
+    {
+        skipWhitespace();
+        if (!f())
+            return false;
+        skipWhitespace();
+        if (consume(','))
+            continue;
+        if (consume(']'))
+            return true;
+        return fail("expected ',' or ']' in array");
+    }
+}
+
+bool DepotManifestParser::parseString(std::string& str)
+{
+    str.clear();
+    if (!consume('"'))
+        return fail("expected string");
+
+    while (pos_ < end_)
+    {
+        // Copy runs of unescaped characters at once
+        const char* run = pos_;
+        while (pos_ < end_ && *pos_ != '"' && *pos_ != '\\')
+            ++pos_;
+        str.append(run, pos_ - run);
+
+        if (pos_ >= end_)
+            break;
+        if (*pos_++ == '"')
+            return true;
+
+        if (pos_ >= end_)
+            break;
+        char c = *pos_++;
+        switch (c)
+        {
+            case '"': str.push_back('"'); break;
+            case '\\': str.push_back('\\'); break;
+            case '/': str.push_back('/'); break;
+            case 'b': str.push_back('\b'); break;
+            case 'f': str.push_back('\f'); break;
+            case 'n': str.push_back('\n'); break;
+            case 'r': str.push_back('\r'); break;
+            case 't': str.push_back('\t'); break;
+            case 'u':
+            {
+                uint32_t cp;
+                if (end_ - pos_ < 4 || !parseHex4(pos_, cp))
+                    return fail("invalid unicode escape");
+                pos_ += 4;
+                // Surrogate pair
+                if (cp >= 0xD800 && cp <= 0xDBFF)
+                {
+                    uint32_t low;
+                    if (end_ - pos_ < 6 || pos_[0] != '\\' || pos_[1] != 'u' || !parseHex4(pos_ + 2, low) || low < 0xDC00 || low > 0xDFFF)
+                        return fail("invalid unicode surrogate pair");
+                    pos_ += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(str, cp);
+                break;
+            }
+            default:
+                return fail("invalid escape sequence");
+        }
+    }
+
+    return fail("unterminated string");
+}
+
+bool DepotManifestParser::parseStringValue(std::string& str)
+{
+    if (pos_ < end_ && *pos_ == 'n')
+    {
+        str.clear();
+        return skipLiteral("null");
+    }
+    return parseString(str);
+}
+
+bool DepotManifestParser::parseUIntValue(uintmax_t& value)
+{
+    if (pos_ < end_ && *pos_ == 'n')
+    {
+        value = 0;
+        return skipLiteral("null");
+    }
+
+    const char* start = pos_;
+    value = 0;
+    while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9')
+        value = value * 10 + (*pos_++ - '0');
+
+    if (pos_ == start)
+        return fail("expected unsigned integer");
+
+    // Sizes are integers but accept real notation like jsoncpp does
+    if (pos_ < end_ && (*pos_ == '.' || *pos_ == 'e' || *pos_ == 'E'))
+    {
+        std::string number(start, pos_);
+        while (pos_ < end_ && std::strchr("0123456789.eE+-", *pos_))
+            number.push_back(*pos_++);
+        value = static_cast<uintmax_t>(std::strtod(number.c_str(), NULL));
+    }
+
+    return true;
+}
+
+bool DepotManifestParser::skipLiteral(const char* literal)
+{
+    size_t length = std::strlen(literal);
+    if (static_cast<size_t>(end_ - pos_) < length || std::strncmp(pos_, literal, length) != 0)
+        return fail("invalid literal");
+    pos_ += length;
+    return true;
+}
+
+bool DepotManifestParser::skipValue(const unsigned int& depth)
+{
+    if (depth > MANIFEST_MAX_DEPTH)
+        return fail("maximum nesting depth exceeded");
+
+    skipWhitespace();
+    if (pos_ >= end_)
+        return fail("unexpected end of data");
+
+    switch (*pos_)
+    {
+        case '{':
+            return parseObject([&](const std::string&) { return skipValue(depth + 1); });
+        case '[':
+            return parseArray([&]() { return skipValue(depth + 1); });
+        case '"':
+        {
+            ++pos_;
+            while (pos_ < end_ && *pos_ != '"')
+            {
+                if (*pos_ == '\\')
+                    ++pos_;
+                ++pos_;
+            }
+            if (pos_ >= end_)
+                return fail("unterminated string");
+            ++pos_;
+            return true;
+        }
+        case 't':
+            return skipLiteral("true");
+        case 'f':
+            return skipLiteral("false");
+        case 'n':
+            return skipLiteral("null");
+        default:
+        {
+            const char* start = pos_;
+            while (pos_ < end_ && std::strchr("0123456789.eE+-", *pos_))
+                ++pos_;
+            if (pos_ == start)
+                return fail("unexpected character");
+            return true;
+        }
+    }
+}
+
+bool DepotManifestParser::parseChunk(uintmax_t& size_compressed, uintmax_t& size_uncompressed)
+{
+    md5_compressed_.clear();
+    md5_uncompressed_.clear();
+    return parseObject([&](const std::string& key)
+    {
+        if (key == "compressedMd5")
+            return parseStringValue(md5_compressed_);
+        else if (key == "md5")
+            return parseStringValue(md5_uncompressed_);
+        else if (key == "compressedSize")
+            return parseUIntValue(size_compressed);
+        else if (key == "size")
+            return parseUIntValue(size_uncompressed);
+        return skipValue();
+    });
+}
+
+bool DepotManifestParser::parseChunks(galaxyDepotItem& item)
+{
+    size_t first = table_->size();
+    bool bResult = parseArray([&]()
+    {
+        uintmax_t size_compressed = 0;
+        uintmax_t size_uncompressed = 0;
+        if (!parseChunk(size_compressed, size_uncompressed))
+            return false;
+
+        if (!table_->add(md5_compressed_, md5_uncompressed_, size_compressed, size_uncompressed, item.totalSizeCompressed, item.totalSizeUncompressed))
+            return fail("invalid chunk (" + md5_compressed_ + ")");
+
+        item.totalSizeCompressed += size_compressed;
+        item.totalSizeUncompressed += size_uncompressed;
+        return true;
+    });
+
+    item.chunks = galaxyChunkRange(table_, first, table_->size() - first);
+    return bResult;
+}
+
+bool DepotManifestParser::parseSfcRef(galaxyDepotItem& item)
+{
+    item.isInSFC = true;
+    return parseObject([&](const std::string& key)
+    {
+        if (key == "offset")
+            return parseUIntValue(item.sfc_offset);
+        else if (key == "size")
+            return parseUIntValue(item.sfc_size);
+        return skipValue();
+    });
+}
+
+bool DepotManifestParser::parseItem(galaxyDepotItem& item, bool& bHasChunks)
+{
+    return parseObject([&](const std::string& key)
+    {
+        if (key == "path")
+            return parseStringValue(item.path);
+        else if (key == "md5")
+            return parseStringValue(item.md5);
+        else if (key == "sfcRef" && pos_ < end_ && *pos_ == '{')
+            return parseSfcRef(item);
+        else if (key == "chunks" && pos_ < end_ && *pos_ == '[')
+        {
+            bHasChunks = true;
+            return parseChunks(item);
+        }
+        return skipValue();
+    });
+}
+
+bool DepotManifestParser::parseDepot(const std::function<void(galaxyDepotItem&)>& callback)
+{
+    auto newItem = []()
+    {
+        galaxyDepotItem item;
+        item.totalSizeCompressed = 0;
+        item.totalSizeUncompressed = 0;
+        item.sfc_offset = 0;
+        item.sfc_size = 0;
+        return item;
+    };
+
+    return parseObject([&](const std::string& key)
+    {
+        if (key == "items" && pos_ < end_ && *pos_ == '[')
+        {
+            return parseArray([&]()
+            {
+                galaxyDepotItem item = newItem();
+                bool bHasChunks = false;
+                if (!parseItem(item, bHasChunks))
+                    return false;
+                if (bHasChunks)
+                    callback(item);
+                return true;
+            });
+        }
+        else if (key == "smallFilesContainer" && pos_ < end_ && *pos_ == '{')
+        {
+            galaxyDepotItem item = newItem();
+            item.isSmallFilesContainer = true;
+            bool bHasChunks = false;
+            if (!parseItem(item, bHasChunks))
+                return false;
+            if (bHasChunks)
+                callback(item);
+            return true;
+        }
+        return skipValue();
+    });
+}
+
+bool DepotManifestParser::parse(const std::function<void(galaxyDepotItem&)>& callback)
+{
+    error_.clear();
+    bool bResult = parseObject([&](const std::string& key)
+    {
+        if (key == "depot" && pos_ < end_ && *pos_ == '{')
+            return parseDepot(callback);
+        return skipValue();
+    });
+
+    if (bResult)
+    {
+        skipWhitespace();
+        if (pos_ != end_)
+            return fail("trailing data after manifest");
+    }
+
+    return bResult;
+}
@@ -0,0 +1,94 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "directorycache.h"
+#include "tracer.h"
+
+#include <cerrno>
+#include <functional>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+DirectoryCache::Shard& DirectoryCache::getShard(const std::string& path)
+{
+    return shards_[std::hash<std::string>()(path) % SHARD_COUNT];
+}
+
+bool DirectoryCache::contains(const std::string& path)
+{
+    Shard& shard = this->getShard(path);
+    std::unique_lock<std::mutex> lock(shard.m);
+    return shard.dirs.count(path) > 0;
+}
+
+void DirectoryCache::insert(const std::string& path)
+{
+    Shard& shard = this->getShard(path);
+    std::unique_lock<std::mutex> lock(shard.m);
+    shard.dirs.insert(path);
+}
+
+void DirectoryCache::clear()
+{
+    for (unsigned int i = 0; i < SHARD_COUNT; ++i)
+    {
+        std::unique_lock<std::mutex> lock(shards_[i].m);
+        shards_[i].dirs.clear();
+    }
+}
+
+int DirectoryCache::makeDirectory(const std::string& path)
+{
+    // mkdir is atomic so there is no need to lock here.
+    // If another thread creates the directory first we get EEXIST.
+    if (mkdir(path.c_str(), 0777) == 0)
+        return 0;
+
+    int err = errno;
+    if (err == EEXIST)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+            return 0;
+        return ENOTDIR;
+    }
+
+    return err;
+}
+
+int DirectoryCache::create(const std::string& path)
+{
+    if (path.empty() || path == "/")
+        return 0;
+
+    if (this->contains(path))
+        return 0;
+
+    TraceSpan span("create directory", path);
+
+    int res = this->makeDirectory(path);
+    if (res == ENOENT)
+    {
+        // Parent directory is missing, create it first
+        std::string::size_type pos = path.find_last_not_of('/');
+        if (pos != std::string::npos)
+            pos = path.find_last_of('/', pos);
+
+        if (pos == std::string::npos)
+            return res;
+
+        res = this->create(pos == 0 ? "/" : path.substr(0, pos));
+        if (res != 0)
+            return res;
+
+        res = this->makeDirectory(path);
+    }
+
+    if (res == 0)
+        this->insert(path);
+
+    return res;
+}
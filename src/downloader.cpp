@@ -10,6 +10,12 @@
 #include "downloadinfo.h"
 #include "message.h"
 #include "ziputil.h"
+#include "directorycache.h"
+#include "orphanscanner.h"
+#include "patternmatcher.h"
+#include "chunkcache.h"
+#include "chunkstore.h"
+#include "gamedetailscache.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -17,6 +23,9 @@
 #include <iostream>
 #include <sstream>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <fstream>
 #include <iomanip>
 #include <boost/filesystem.hpp>
@@ -29,7 +38,11 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <map>
+#include <set>
+#include <unordered_set>
 
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/iostreams/copy.hpp>
@@ -54,8 +67,10 @@ ThreadSafeQueue<gameFile> createXMLQueue;
 ThreadSafeQueue<gameItem> gameItemQueue;
 ThreadSafeQueue<gameDetails> gameDetailsQueue;
 ThreadSafeQueue<galaxyDepotItem> dlQueueGalaxy;
-ThreadSafeQueue<zipFileEntry> dlQueueGalaxy_MojoSetupHack;
-std::mutex mtx_create_directories; // Mutex for creating directories in Downloader::processDownloadQueue
+ThreadSafeQueue<mojoSetupSpan> dlQueueGalaxy_MojoSetupHack;
+DirectoryCache dirCache; // Directories created by download threads
+ChunkCache galaxyChunkCache; // Galaxy chunks that are used by more than one file
+ChunkStore galaxyChunkStore; // Local chunk store shared between games and builds
 std::atomic<unsigned long long> iTotalRemainingBytes(0);
 
 std::string username() {
@@ -200,6 +215,8 @@ bool Downloader::isLoggedIn()
 */
 int Downloader::init()
 {
+    TraceSpan span("init");
+
     if (!gogGalaxy->init())
     {
         if (gogGalaxy->refreshLogin())
@@ -242,6 +259,7 @@ int Downloader::init()
 */
 int Downloader::login()
 {
+    TraceSpan span("login");
     std::string email;
     std::string password;
     bool headless = false;
@@ -384,6 +402,7 @@ void Downloader::clearUpdateNotifications()
 
 void Downloader::getGameList()
 {
+    TraceSpan span("getGameList");
     gameItems = gogWebsite->getGames();
 }
 
@@ -393,6 +412,8 @@ void Downloader::getGameList()
 */
 int Downloader::getGameDetails()
 {
+    TraceSpan span("getGameDetails");
+
     // Set default game specific directory options to values from config
     DirectoryConfig dirConfDefault = Globals::globalConfig.dirConf;
 
@@ -443,13 +464,12 @@ int Downloader::getGameDetails()
 
         // Create threads
         unsigned int threads = std::min(Globals::globalConfig.iInfoThreads, static_cast<unsigned int>(gameItemQueue.size()));
+        ConfigSnapshot config = std::make_shared<const Config>(Globals::globalConfig);
         std::vector<std::thread> vThreads;
+        vDownloadInfo.resize(threads);
         for (unsigned int i = 0; i < threads; ++i)
         {
-            DownloadInfo dlInfo;
-            dlInfo.setStatus(DLSTATUS_NOTSTARTED);
-            vDownloadInfo.push_back(dlInfo);
-            vThreads.push_back(std::thread(Downloader::getGameDetailsThread, Globals::globalConfig, i));
+            vThreads.push_back(std::thread(Downloader::getGameDetailsThread, config, i));
         }
 
         unsigned int dl_status = DLSTATUS_NOTSTARTED;
@@ -459,14 +479,15 @@ int Downloader::getGameDetails()
 
             // Print progress information once per 100ms
             std::this_thread::sleep_for(std::chrono::milliseconds(Globals::globalConfig.iProgressInterval));
-            std::cerr << "\033[J\r" << std::flush; // Clear screen from the current line down to the bottom of the screen
+            if (!Globals::globalConfig.bHeadlessStderr)
+                std::cerr << "\033[J\r" << std::flush; // Clear screen from the current line down to the bottom of the screen
 
             // Print messages from message queue first
             Message msg;
             while (msgQueue.try_pop(msg))
             {
                 if (msg.getLevel() <= Globals::globalConfig.iMsgLevel)
-                    std::cerr << msg.getFormattedString(Globals::globalConfig.bColor, true) << std::endl;
+                    std::cerr << msg.getFormattedString(Globals::globalConfig.bColor && !Globals::globalConfig.bHeadlessStderr, true) << std::endl;
 
                 if (Globals::globalConfig.bReport)
                 {
@@ -480,6 +501,10 @@ int Downloader::getGameDetails()
                 dl_status |= status;
             }
 
+            // Print only final count when stderr is not a terminal
+            if (Globals::globalConfig.bHeadlessStderr && dl_status != DLSTATUS_FINISHED)
+                continue;
+
             std::cerr << "Getting game info " << (gameItems.size() - gameItemQueue.size()) << " / " << gameItems.size() << std::endl;
 
             if (dl_status != DLSTATUS_FINISHED)
@@ -601,6 +626,8 @@ int Downloader::listGames()
 
 void Downloader::repair()
 {
+    TraceSpan span("repair");
+
     if (this->games.empty())
         this->getGameDetails();
 
@@ -685,6 +712,8 @@ void Downloader::repair()
 
 void Downloader::download()
 {
+    TraceSpan span("download");
+
     if (this->games.empty())
         this->getGameDetails();
 
@@ -810,14 +839,16 @@ void Downloader::download()
         // Limit thread count to number of items in download queue
         unsigned int iThreads = std::min(Globals::globalConfig.iThreads, static_cast<unsigned int>(dlQueue.size()));
 
+        // Directories may have been removed since previous run
+        dirCache.clear();
+
         // Create download threads
+        ConfigSnapshot config = std::make_shared<const Config>(Globals::globalConfig);
         std::vector<std::thread> vThreads;
+        vDownloadInfo.resize(iThreads);
         for (unsigned int i = 0; i < iThreads; ++i)
         {
-            DownloadInfo dlInfo;
-            dlInfo.setStatus(DLSTATUS_NOTSTARTED);
-            vDownloadInfo.push_back(dlInfo);
-            vThreads.push_back(std::thread(Downloader::processDownloadQueue, Globals::globalConfig, i));
+            vThreads.push_back(std::thread(Downloader::processDownloadQueue, config, i));
         }
 
         this->printProgress(dlQueue);
@@ -867,7 +898,7 @@ CURLcode Downloader::downloadFile(const std::string& url, const std::string& fil
     local_xml_file = xml_directory + "/" + filenameXML;
 
     bool bSameVersion = true; // assume same version
-    bool bLocalXMLExists = boost::filesystem::exists(local_xml_file); // This is additional check to see if remote xml should be saved to speed up future version checks
+    bool bLocalXMLExists = Globals::checksumStore.exists(local_xml_file.string()); // This is additional check to see if remote xml should be saved to speed up future version checks
 
     if (!xml_data.empty())
     {
@@ -941,29 +972,7 @@ CURLcode Downloader::downloadFile(const std::string& url, const std::string& fil
                         {
                             if ((bLocalXMLExists && (!bSameVersion || Globals::globalConfig.bRepair)) || !bLocalXMLExists)
                             {
-                                // Check that directory exists and create subdirectories
-                                boost::filesystem::path path = xml_directory;
-                                if (boost::filesystem::exists(path))
-                                {
-                                    if (!boost::filesystem::is_directory(path))
-                                    {
-                                        std::cerr << path << " is not directory" << std::endl;
-                                    }
-                                }
-                                else
-                                {
-                                    if (!boost::filesystem::create_directories(path))
-                                    {
-                                        std::cerr << "Failed to create directory: " << path << std::endl;
-                                    }
-                                }
-                                std::ofstream ofs(local_xml_file.string().c_str());
-                                if (ofs)
-                                {
-                                    ofs << xml_data;
-                                    ofs.close();
-                                }
-                                else
+                                if (!Globals::checksumStore.saveXML(local_xml_file.string(), xml_data))
                                 {
                                     std::cerr << "Can't create " << local_xml_file.string() << std::endl;
                                 }
@@ -1042,29 +1051,7 @@ CURLcode Downloader::downloadFile(const std::string& url, const std::string& fil
     {
         if ((bLocalXMLExists && (!bSameVersion || Globals::globalConfig.bRepair)) || !bLocalXMLExists)
         {
-            // Check that directory exists and create subdirectories
-            boost::filesystem::path path = xml_directory;
-            if (boost::filesystem::exists(path))
-            {
-                if (!boost::filesystem::is_directory(path))
-                {
-                    std::cerr << path << " is not directory" << std::endl;
-                }
-            }
-            else
-            {
-                if (!boost::filesystem::create_directories(path))
-                {
-                    std::cerr << "Failed to create directory: " << path << std::endl;
-                }
-            }
-            std::ofstream ofs(local_xml_file.string().c_str());
-            if (ofs)
-            {
-                ofs << xml_data;
-                ofs.close();
-            }
-            else
+            if (!Globals::checksumStore.saveXML(local_xml_file.string(), xml_data))
             {
                 std::cerr << "Can't create " << local_xml_file.string() << std::endl;
             }
@@ -1103,6 +1090,8 @@ CURLcode Downloader::downloadFile(const std::string& url, const std::string& fil
     if ((res == CURLE_PARTIAL_FILE || res == CURLE_OPERATION_TIMEDOUT || res == CURLE_RECV_ERROR) && (this->retries < Globals::globalConfig.iRetries) )
     {
         this->retries++;
+        Globals::metrics.retry("download", res, 0);
+        EventLog::addRetry();
 
         std::cerr << std::endl << "Retry " << this->retries << "/" << Globals::globalConfig.iRetries;
         if (res == CURLE_PARTIAL_FILE)
@@ -1150,6 +1139,8 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
     std::vector<off_t> chunk_from, chunk_to;
     std::vector<std::string> chunk_hash;
     bool bParsingFailed = false;
+    ScopedFileEvent file_event("repair", filepath);
+    TraceSpan file_span("repair file", filepath);
 
     // Get filename
     boost::filesystem::path pathname = filepath;
@@ -1161,7 +1152,7 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
         xml_directory = Globals::globalConfig.sXMLDirectory;
     std::string xml_file = xml_directory + "/" + filename + ".xml";
     bool bFileExists = boost::filesystem::exists(pathname);
-    bool bLocalXMLExists = boost::filesystem::exists(xml_file);
+    bool bLocalXMLExists = Globals::checksumStore.exists(xml_file);
 
     tinyxml2::XMLDocument xml;
     if (!xml_data.empty()) // Parse remote XML data
@@ -1174,7 +1165,8 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
         std::cout << "XML: Using local file" << std::endl;
         if (!bLocalXMLExists)
             std::cout << "XML: File doesn't exist (" << xml_file << ")" << std::endl;
-        xml.LoadFile(xml_file.c_str());
+        std::string xml_data_local = Globals::checksumStore.getXML(xml_file);
+        xml.Parse(xml_data_local.c_str());
     }
 
     // Check if file node exists in XML data
@@ -1185,7 +1177,10 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
         if (Globals::globalConfig.bDownload)
             bParsingFailed = true;
         else
+        {
+            file_event.event.status = "skipped";
             return res;
+        }
     }
     else
     {   // File node exists --> valid XML
@@ -1214,6 +1209,8 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
                     << "\tSize:\t" << filesize << " bytes" << std::endl << std::endl;
     }
 
+    file_event.metadataDone();
+
     // No local XML file and parsing failed.
     if (bParsingFailed && !bLocalXMLExists)
     {
@@ -1221,6 +1218,7 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
         {
             std::cout << "Downloading: " << filepath << std::endl;
             CURLcode result = this->downloadFile(url, filepath, xml_data, gamename);
+            file_event.event.status = (result == CURLE_OK) ? "ok" : curl_easy_strerror(result);
             std::cout << std::endl;
             long int response_code = 0;
             if (result == CURLE_HTTP_RETURNED_ERROR)
@@ -1234,7 +1232,7 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
                     (bFileExists && (result == CURLE_OK || result == CURLE_RANGE_ERROR || response_code == 416))
                 )
             {
-                bLocalXMLExists = boost::filesystem::exists(xml_file); // Check to see if downloadFile saved XML data
+                bLocalXMLExists = Globals::checksumStore.exists(xml_file); // Check to see if downloadFile saved XML data
 
                 if (Globals::globalConfig.dlConf.bAutomaticXMLCreation && !bLocalXMLExists)
                 {
@@ -1246,6 +1244,7 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
         }
         else
         {
+            file_event.event.status = "skipped";
             std::cout << "Can't repair file." << std::endl;
         }
         return res;
@@ -1274,6 +1273,7 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
         {
             std::cout << "Downloading: " << filepath << std::endl;
             CURLcode result = this->downloadFile(url, filepath, xml_data, gamename);
+            file_event.event.status = (result == CURLE_OK) ? "ok" : curl_easy_strerror(result);
             std::cout << std::endl;
             if (result == CURLE_OK)
             {
@@ -1285,6 +1285,8 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
                 res = 1;
             }
         }
+        else
+            file_event.event.status = "skipped";
         return res;
     }
 
@@ -1293,6 +1295,7 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
     {
         std::cout   << "Filesizes don't match" << std::endl
                     << "Incomplete download or different version" << std::endl;
+        file_event.event.status = "size mismatch";
         fclose(outfile);
         if (Globals::globalConfig.bDownload)
         {
@@ -1314,18 +1317,18 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
                 if (bLocalXMLExists)
                 {
                     std::cout << "Deleting old XML data" << std::endl;
-                    boost::filesystem::remove(xml_file, ec); // Delete old XML data
-                    if (ec)
+                    if (!Globals::checksumStore.remove(xml_file)) // Delete old XML data
                     {
                         std::cout << "Failed to delete " << xml_file << std::endl;
                     }
                 }
 
                 CURLcode result = this->downloadFile(url, filepath, xml_data, gamename);
+                file_event.event.status = (result == CURLE_OK) ? "ok" : curl_easy_strerror(result);
                 std::cout << std::endl;
                 if (result == CURLE_OK)
                 {
-                    bLocalXMLExists = boost::filesystem::exists(xml_file); // Check to see if downloadFile saved XML data
+                    bLocalXMLExists = Globals::checksumStore.exists(xml_file); // Check to see if downloadFile saved XML data
                     if (!bLocalXMLExists)
                     {
                         std::cout << "Starting automatic XML creation" << std::endl;
@@ -1416,6 +1419,7 @@ int Downloader::repairFile(const std::string& url, const std::string& filepath,
     }
     std::cout << std::endl;
     fclose(outfile);
+    file_event.event.status = bChunkRetryLimitReached ? "repair failed" : "ok";
 
     if (Globals::globalConfig.bReport)
     {
@@ -1455,6 +1459,8 @@ CURLcode Downloader::beginDownload()
     this->TimeAndSize.clear();
     this->timer.reset();
     CURLcode result = curl_easy_perform(curlhandle);
+    Globals::metrics.transfer(curlhandle, "download", result);
+    EventLog::addTransfer(curlhandle);
     this->resume_position = 0;
     return result;
 }
@@ -1595,7 +1601,15 @@ int Downloader::progressCallback(void *clientp, curl_off_t dltotal, curl_off_t d
 
 size_t Downloader::writeData(void *ptr, size_t size, size_t nmemb, FILE *stream)
 {
-    return fwrite(ptr, size, nmemb, stream);
+    if (!Globals::metrics.isEnabled() && !EventLog::hasCurrent())
+        return fwrite(ptr, size, nmemb, stream);
+
+    auto start = std::chrono::steady_clock::now();
+    size_t written = fwrite(ptr, size, nmemb, stream);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Globals::metrics.diskWrite(seconds, written * size);
+    EventLog::addWriteTime(seconds);
+    return written;
 }
 
 size_t Downloader::readData(void *ptr, size_t size, size_t nmemb, FILE *stream)
@@ -1667,17 +1681,6 @@ std::string Downloader::getChangelogFromJSON(const Json::Value& json)
     return changelog;
 }
 
-// Linear search.  Good thing computers are fast and lists are small.
-static int isPresent(std::vector<gameFile>& list, const boost::filesystem::path& path, Blacklist& blacklist)
-{
-    if(blacklist.isBlacklisted(path.native()))
-	return false;
-    for (unsigned int k = 0; k < list.size(); ++k)
-	if (list[k].getFilepath() == path.native())
-	    return true;
-    return false;
-}
-
 void Downloader::checkOrphans()
 {
     // Always check everything when checking for orphaned files
@@ -1700,130 +1703,56 @@ void Downloader::checkOrphans()
     if (this->games.empty())
         this->getGameDetails();
 
-    std::vector<std::string> orphans;
+    // Build set of expected file paths and list of game directories.
+    // Directories are walked only once even if several games share them.
+    OrphanScanner scanner(config.blacklist, config.ignorelist, config.dirConf.sDirectory.length(), config.sOrphanRegex);
     for (unsigned int i = 0; i < games.size(); ++i)
     {
-        std::cerr << "Checking for orphaned files " << i+1 << " / " << games.size() << "\r" << std::flush;
-        std::vector<boost::filesystem::path> filepath_vector;
-
-        try
-        {
-            std::vector<boost::filesystem::path> paths;
-            std::vector<unsigned int> platformIds;
-            platformIds.push_back(0);
-            for (unsigned int j = 0; j < GlobalConstants::PLATFORMS.size(); ++j)
-            {
-                platformIds.push_back(GlobalConstants::PLATFORMS[j].id);
-            }
-            for (unsigned int j = 0; j < platformIds.size(); ++j)
-            {
-                std::string directory = games[i].makeCustomFilepath("", games[i], config.dirConf);
-                boost::filesystem::path path (directory);
-                if (boost::filesystem::exists(path))
-                {
-                    bool bDuplicate = false;
-                    for (unsigned int k = 0; k < paths.size(); ++k)
-                    {
-                        if (path == paths[k])
-                        {
-                            bDuplicate = true;
-                            break;
-                        }
-                    }
-                    if (!bDuplicate)
-                        paths.push_back(path);
-                }
-            }
-
-            for (unsigned int j = 0; j < paths.size(); ++j)
-            {
-                std::size_t pathlen = config.dirConf.sDirectory.length();
-                if (boost::filesystem::exists(paths[j]))
-                {
-                    if (boost::filesystem::is_directory(paths[j]))
-                    {
-                        // Recursively iterate over files in directory
-                        boost::filesystem::recursive_directory_iterator end_iter;
-                        boost::filesystem::recursive_directory_iterator dir_iter(paths[j]);
-                        while (dir_iter != end_iter)
-                        {
-                            if (boost::filesystem::is_regular_file(dir_iter->status()))
-                            {
-                                std::string filepath = dir_iter->path().string();
-                                if (config.ignorelist.isBlacklisted(filepath.substr(pathlen))) {
-                                    if (config.iMsgLevel >= MSGLEVEL_VERBOSE)
-                                        std::cerr << "skipped ignorelisted file " << filepath << std::endl;
-                                } else if (config.blacklist.isBlacklisted(filepath.substr(pathlen))) {
-                                    if (config.iMsgLevel >= MSGLEVEL_VERBOSE)
-                                        std::cerr << "skipped blacklisted file " << filepath << std::endl;
-                                } else {
-                                    boost::regex expression(config.sOrphanRegex); // Limit to files matching the regex
-                                    boost::match_results<std::string::const_iterator> what;
-                                    if (boost::regex_search(filepath, what, expression))
-                                        filepath_vector.push_back(dir_iter->path());
-                                }
-                            }
-                            dir_iter++;
-                        }
-                    }
-                }
-                else
-                    std::cerr << paths[j] << " does not exist" << std::endl;
-            }
-        }
-        catch (const boost::filesystem::filesystem_error& ex)
-        {
-            std::cout << ex.what() << std::endl;
-        }
+        std::string directory = games[i].makeCustomFilepath("", games[i], config.dirConf);
+        if (boost::filesystem::exists(directory))
+            scanner.addDirectory(directory);
 
-        if (!filepath_vector.empty())
+        std::vector<gameFile> vGameFiles = games[i].getGameFileVector();
+        for (unsigned int j = 0; j < vGameFiles.size(); ++j)
         {
-            for (unsigned int j = 0; j < filepath_vector.size(); ++j)
-            {
-                bool bFoundFile = isPresent(games[i].installers, filepath_vector[j], config.blacklist)
-		               || isPresent(games[i].extras, filepath_vector[j], config.blacklist)
-		               || isPresent(games[i].patches, filepath_vector[j], config.blacklist)
-		               || isPresent(games[i].languagepacks, filepath_vector[j], config.blacklist);
-
-                if (!bFoundFile)
-                {   // Check dlcs
-                    for (unsigned int k = 0; k < games[i].dlcs.size(); ++k)
-                    {
-                        bFoundFile = isPresent(games[i].dlcs[k].installers, filepath_vector[j], config.blacklist)
-                            || isPresent(games[i].dlcs[k].extras, filepath_vector[j], config.blacklist)
-                            || isPresent(games[i].dlcs[k].patches, filepath_vector[j], config.blacklist)
-                            || isPresent(games[i].dlcs[k].languagepacks, filepath_vector[j], config.blacklist);
-                        if(bFoundFile)
-                            break;
-                    }
-                }
-                if (!bFoundFile)
-                    orphans.push_back(filepath_vector[j].string());
-            }
+            // Blacklisted files are never considered present
+            if (!config.blacklist.isBlacklisted(vGameFiles[j].getFilepath()))
+                scanner.addExpectedPath(vGameFiles[j].getFilepath());
         }
     }
-    std::cout << std::endl;
 
-    if (!orphans.empty())
+    std::cerr << "Checking for orphaned files" << std::endl;
+    std::vector<std::string> orphans;
+    scanner.scan(config.iThreads, [&](const orphanScanResult& result)
     {
-        for (unsigned int i = 0; i < orphans.size(); ++i)
+        if (result.type == ORPHANSCAN_ORPHAN)
         {
+            orphans.push_back(result.path);
             if (Globals::globalConfig.dlConf.bDeleteOrphans)
             {
-                std::string filepath = orphans[i];
-                std::cout << "Deleting " << filepath << std::endl;
-                if (boost::filesystem::exists(filepath))
-                    if (!boost::filesystem::remove(filepath))
-                        std::cerr << "Failed to delete " << filepath << std::endl;
+                std::cout << "Deleting " << result.path << std::endl;
+                if (boost::filesystem::exists(result.path))
+                    if (!boost::filesystem::remove(result.path))
+                        std::cerr << "Failed to delete " << result.path << std::endl;
             }
             else
-                std::cout << orphans[i] << std::endl;
+                std::cout << result.path << std::endl;
         }
-    }
-    else
-    {
+        else if (result.type == ORPHANSCAN_IGNORELISTED)
+        {
+            if (config.iMsgLevel >= MSGLEVEL_VERBOSE)
+                std::cerr << "skipped ignorelisted file " << result.path << " (ignorelist line " << result.linenr << ")" << std::endl;
+        }
+        else if (result.type == ORPHANSCAN_BLACKLISTED)
+        {
+            if (config.iMsgLevel >= MSGLEVEL_VERBOSE)
+                std::cerr << "skipped blacklisted file " << result.path << " (blacklist line " << result.linenr << ")" << std::endl;
+        }
+        else if (result.type == ORPHANSCAN_ERROR)
+            std::cerr << result.path << std::endl;
+    });
+    if (orphans.empty())
         std::cout << "No orphaned files" << std::endl;
-    }
 
     return;
 }
@@ -1867,17 +1796,9 @@ void Downloader::checkStatus()
             else
                 local_xml_file = Globals::globalConfig.sXMLDirectory + "/" + path.filename().string() + ".xml";
 
-            if (boost::filesystem::exists(local_xml_file))
-            {
-                tinyxml2::XMLDocument local_xml;
-                local_xml.LoadFile(local_xml_file.string().c_str());
-                tinyxml2::XMLElement *fileElemLocal = local_xml.FirstChildElement("file");
-                if (fileElemLocal)
-                {
-                    std::string filesize_xml_str = fileElemLocal->Attribute("total_size");
-                    filesize_xml = std::stoull(filesize_xml_str);
-                }
-            }
+            checksumEntry entry;
+            if (Globals::checksumStore.getEntry(local_xml_file.string(), entry))
+                filesize_xml = entry.total_size;
 
             if (Globals::globalConfig.bSizeOnly)
             {
@@ -1954,7 +1875,7 @@ std::string Downloader::getLocalFileHash(const std::string& filepath, const std:
     else
         local_xml_file = Globals::globalConfig.sXMLDirectory + "/" + path.filename().string() + ".xml";
 
-    if (Globals::globalConfig.dlConf.bAutomaticXMLCreation && !boost::filesystem::exists(local_xml_file) && boost::filesystem::exists(path))
+    if (Globals::globalConfig.dlConf.bAutomaticXMLCreation && !Globals::checksumStore.exists(local_xml_file.string()) && boost::filesystem::exists(path))
     {
         std::string xml_directory = Globals::globalConfig.sXMLDirectory + "/" + gamename;
         Util::createXML(filepath, Globals::globalConfig.iChunkSize, xml_directory);
@@ -2025,15 +1946,53 @@ int Downloader::loadGameDetailsCache()
     int res = 0;
     std::string cachepath = Globals::globalConfig.sCacheDirectory + "/gamedetails.json";
 
+    bptime::ptime now = bptime::second_clock::local_time();
+    bptime::ptime cachedate;
+
+    // Use binary cache if it exists and was written from current JSON cache
+    // Only details of games that match the game filter are decoded
+    GameDetailsCache binary_cache;
+    if (binary_cache.open(Globals::globalConfig.sCacheDirectory + "/gamedetails.bin", cachepath) == 0)
+    {
+        cachedate = bptime::from_iso_string(binary_cache.getDate());
+        if ((now - cachedate) > bptime::minutes(Globals::globalConfig.iCacheValid))
+        {
+            // cache is too old
+            return 3;
+        }
+
+        std::shared_ptr<const PatternMatcher> gameFilter = PatternMatcher::get(Globals::globalConfig.sGameRegex);
+        std::vector<gameDetails> details;
+        bool bCacheOK = true;
+        for (uint32_t i = 0; i < binary_cache.size(); ++i)
+        {
+            if (!gameFilter->search(binary_cache.getGamename(i)))
+                continue;
+
+            Json::Value gameDetailsNode;
+            if (!binary_cache.getGameJson(i, gameDetailsNode))
+            {
+                bCacheOK = false;
+                break;
+            }
+            std::vector<gameDetails> game = this->getGameDetailsFromJsonNode(gameDetailsNode);
+            details.insert(details.end(), game.begin(), game.end());
+        }
+
+        // Use JSON cache if binary cache is corrupted
+        if (bCacheOK)
+        {
+            this->games = details;
+            return 0;
+        }
+    }
+
     // Make sure file exists
     boost::filesystem::path path = cachepath;
     if (!boost::filesystem::exists(path)) {
         return res = 1;
     }
 
-    bptime::ptime now = bptime::second_clock::local_time();
-    bptime::ptime cachedate;
-
     Json::Value root = Util::readJsonFile(cachepath);
     if (root.empty())
     {
@@ -2067,20 +2026,58 @@ int Downloader::loadGameDetailsCache()
 
     return 4;
 }
+
+// Change token for game in account product list
+// Game is refetched by incremental cache update when this changes
+static std::string getGameChangeToken(const gameItem& item)
+{
+    return "updates=" + std::to_string(item.updates) + ";new=" + (item.isnew ? "1" : "0") + ";dlcs=" + std::to_string(item.dlccount);
+}
+
 /* Save game details to cache file
     returns 0 if successful
     returns 1 if fails
 */
 int Downloader::saveGameDetailsCache()
 {
-    int res = 0;
-
     // Don't try to save cache if we don't have any game details
     if (this->games.empty())
     {
         return 1;
     }
 
+    Json::Value games_json(Json::arrayValue);
+    for (unsigned int i = 0; i < this->games.size(); ++i)
+        games_json.append(this->games[i].getDetailsAsJson());
+
+    // All games were fetched now
+    Json::Value game_state(Json::objectValue);
+    Json::Int64 now = time(NULL);
+    for (unsigned int i = 0; i < this->gameItems.size(); ++i)
+    {
+        game_state[this->gameItems[i].id]["fetched"] = now;
+        game_state[this->gameItems[i].id]["token"] = getGameChangeToken(this->gameItems[i]);
+    }
+
+    return this->saveGameDetailsCache(games_json, game_state);
+}
+
+/* Save game details to cache file
+    games_json is array of game details nodes
+    game_state contains fetch time and change token for each product id
+    returns 0 if successful
+    returns 1 if fails
+*/
+int Downloader::saveGameDetailsCache(const Json::Value& games_json, const Json::Value& game_state)
+{
+    TraceSpan span("saveGameDetailsCache");
+    int res = 0;
+
+    if (games_json.empty())
+    {
+        return 1;
+    }
+
     std::string cachepath = Globals::globalConfig.sCacheDirectory + "/gamedetails.json";
 
     Json::Value json;
@@ -2089,9 +2086,8 @@ int Downloader::saveGameDetailsCache()
     json["version-string"] = Globals::globalConfig.sVersionString;
     json["version-number"] = Globals::globalConfig.sVersionNumber;
     json["date"] = bptime::to_iso_string(bptime::second_clock::local_time());
-
-    for (unsigned int i = 0; i < this->games.size(); ++i)
-        json["games"].append(this->games[i].getDetailsAsJson());
+    json["games"] = games_json;
+    json["game-state"] = game_state;
 
     std::ofstream ofs(cachepath);
     if (!ofs)
@@ -2103,17 +2099,28 @@ int Downloader::saveGameDetailsCache()
         ofs << json << std::endl;
         ofs.close();
     }
+
+    std::string binary_cachepath = Globals::globalConfig.sCacheDirectory + "/gamedetails.bin";
+    if (res != 0 || !GameDetailsCache::save(binary_cachepath, json, cachepath))
+    {
+        // Remove old binary cache so that it isn't used instead of the new JSON cache
+        boost::system::error_code ec;
+        boost::filesystem::remove(binary_cachepath, ec);
+        res = 1;
+    }
+
     return res;
 }
 
-std::vector<gameDetails> Downloader::getGameDetailsFromJsonNode(Json::Value root, const int& recursion_level)
+std::vector<gameDetails> Downloader::getGameDetailsFromJsonNode(const Json::Value& root, const int& recursion_level)
 {
     std::vector<gameDetails> details;
+    std::shared_ptr<const PatternMatcher> gameFilter = PatternMatcher::get(Globals::globalConfig.sGameRegex);
 
     // If root node is not array and we use root.size() it will return the number of nodes --> limit to 1 "array" node to make sure it is handled properly
     for (unsigned int i = 0; i < (root.isArray() ? root.size() : 1); ++i)
     {
-        Json::Value gameDetailsNode = (root.isArray() ? root[i] : root); // This json node can be array or non-array so take that into account
+        const Json::Value& gameDetailsNode = (root.isArray() ? root[i] : root); // This json node can be array or non-array so take that into account
         gameDetails game;
         game.gamename = gameDetailsNode["gamename"].asString();
         game.gamename_basegame = gameDetailsNode["gamename_basegame"].asString();
@@ -2121,9 +2128,7 @@ std::vector<gameDetails> Downloader::getGameDetailsFromJsonNode(Json::Value root
         // DLCs are handled as part of the game so make sure that filtering is done with base game name
         if (recursion_level == 0) // recursion level is 0 when handling base game
         {
-            boost::regex expression(Globals::globalConfig.sGameRegex);
-            boost::match_results<std::string::const_iterator> what;
-            if (!boost::regex_search(game.gamename, what, expression)) // Check if name matches the specified regex
+            if (!gameFilter->search(game.gamename)) // Check if name matches the specified regex
                 continue;
         }
         game.title = gameDetailsNode["title"].asString();
@@ -2152,10 +2157,10 @@ std::vector<gameDetails> Downloader::getGameDetailsFromJsonNode(Json::Value root
             std::string nodeName = nodes[j];
             if (gameDetailsNode.isMember(nodeName))
             {
-                Json::Value fileDetailsNodeVector = gameDetailsNode[nodeName];
+                const Json::Value& fileDetailsNodeVector = gameDetailsNode[nodeName];
                 for (unsigned int index = 0; index < fileDetailsNodeVector.size(); ++index)
                 {
-                    Json::Value fileDetailsNode = fileDetailsNodeVector[index];
+                    const Json::Value& fileDetailsNode = fileDetailsNodeVector[index];
                     gameFile fileDetails;
 
                     if (nodeName != "dlcs")
@@ -2205,7 +2210,7 @@ std::vector<gameDetails> Downloader::getGameDetailsFromJsonNode(Json::Value root
                     }
                     else if (nodeName == "dlcs" && (conf.dlConf.iInclude & GlobalConstants::GFTYPE_DLC))
                     {
-                        std::vector<gameDetails> dlcs = this->getGameDetailsFromJsonNode(fileDetailsNode, recursion_level + 1);
+                        std::vector<gameDetails> dlcs = Downloader::getGameDetailsFromJsonNode(fileDetailsNode, recursion_level + 1);
                         game.dlcs.insert(game.dlcs.end(), dlcs.begin(), dlcs.end());
                     }
                 }
@@ -2223,6 +2228,8 @@ std::vector<gameDetails> Downloader::getGameDetailsFromJsonNode(Json::Value root
 
 void Downloader::updateCache()
 {
+    TraceSpan span("updateCache");
+
     // Make sure that all details get cached
     Globals::globalConfig.dlConf.iInclude = Util::getOptionValue("all", GlobalConstants::INCLUDE_OPTIONS);
     Globals::globalConfig.sGameRegex = ".*";
@@ -2232,8 +2239,71 @@ void Downloader::updateCache()
     Globals::globalConfig.dlConf.vPlatformPriority.clear();
 
     this->getGameList();
-    this->getGameDetails();
-    if (this->saveGameDetailsCache())
+
+    if (!Globals::globalConfig.bUpdateCacheIncremental)
+    {
+        this->getGameDetails();
+        if (this->saveGameDetailsCache())
+            std::cout << "Failed to save cache" << std::endl;
+
+        return;
+    }
+
+    // Incremental update
+    // Reuse details of games whose change token hasn't changed and that were fetched within TTL
+    std::map<std::string, Json::Value> cached_games; // product id -> game details node
+    Json::Value cached_state;
+    std::string cachepath = Globals::globalConfig.sCacheDirectory + "/gamedetails.json";
+    if (boost::filesystem::exists(cachepath))
+    {
+        Json::Value root = Util::readJsonFile(cachepath);
+        if (root["gamedetails-cache-version"].asInt() == GlobalConstants::GAMEDETAILS_CACHE_VERSION)
+        {
+            for (const auto& node : root["games"])
+                cached_games[node["product_id"].asString()] = node;
+            cached_state = root["game-state"];
+        }
+    }
+
+    Json::Int64 now = time(NULL);
+    Json::Int64 ttl = static_cast<Json::Int64>(Globals::globalConfig.iCacheGameTTL) * 60;
+    Json::Value game_state(Json::objectValue);
+    std::multimap<std::string, Json::Value> games_json; // sorted by gamename
+    std::vector<gameItem> items_fetch;
+    for (const auto& item : this->gameItems)
+    {
+        auto it = cached_games.find(item.id);
+        const Json::Value& state = cached_state[item.id];
+        Json::Int64 age = now - state["fetched"].asInt64();
+        if (it != cached_games.end() && state["token"].asString() == getGameChangeToken(item) && age >= 0 && age < ttl)
+        {
+            games_json.insert(std::make_pair(it->second["gamename"].asString(), it->second));
+            game_state[item.id] = state;
+        }
+        else
+        {
+            items_fetch.push_back(item);
+            game_state[item.id]["fetched"] = now;
+            game_state[item.id]["token"] = getGameChangeToken(item);
+        }
+    }
+
+    std::cout << "Using cached details for " << games_json.size() << " games" << std::endl;
+    std::cout << "Getting details for " << items_fetch.size() << " games" << std::endl;
+
+    if (!items_fetch.empty())
+    {
+        this->gameItems = items_fetch;
+        this->getGameDetails();
+        for (unsigned int i = 0; i < this->games.size(); ++i)
+            games_json.insert(std::make_pair(this->games[i].gamename, this->games[i].getDetailsAsJson()));
+    }
+
+    Json::Value games_array(Json::arrayValue);
+    for (const auto& game : games_json)
+        games_array.append(game.second);
+
+    if (this->saveGameDetailsCache(games_array, game_state))
         std::cout << "Failed to save cache" << std::endl;
 
     return;
@@ -2568,10 +2638,11 @@ void Downloader::showWishlist()
     return;
 }
 
-void Downloader::processCloudSaveUploadQueue(Config conf, const unsigned int& tid) {
+void Downloader::processCloudSaveUploadQueue(ConfigSnapshot conf, const unsigned int& tid) {
     std::string msg_prefix = "[Thread #" + std::to_string(tid) + "]";
+    Globals::tracer.setThreadName("cloudsave upload #" + std::to_string(tid));
 
-    std::unique_ptr<galaxyAPI> galaxy { new galaxyAPI(Globals::globalConfig.curlConf) };
+    std::unique_ptr<galaxyAPI> galaxy { new galaxyAPI(conf->curlConf) };
     if (!galaxy->init())
     {
         if (!galaxy->refreshLogin())
@@ -2584,14 +2655,13 @@ void Downloader::processCloudSaveUploadQueue(Config conf, const unsigned int& ti
 
     CURL* dlhandle = curl_easy_init();
 
-    Util::CurlHandleSetDefaultOptions(dlhandle, conf.curlConf);
+    Util::CurlHandleSetDefaultOptions(dlhandle, conf->curlConf);
     curl_easy_setopt(dlhandle, CURLOPT_NOPROGRESS, 0);
     curl_easy_setopt(dlhandle, CURLOPT_READFUNCTION, Util::CurlReadChunkMemoryCallback);
     curl_easy_setopt(dlhandle, CURLOPT_FILETIME, 1L);
 
     xferInfo xferinfo;
     xferinfo.tid = tid;
-    xferinfo.curlhandle = dlhandle;
 
     curl_easy_setopt(dlhandle, CURLOPT_XFERINFOFUNCTION, Downloader::progressCallbackForThread);
     curl_easy_setopt(dlhandle, CURLOPT_XFERINFODATA, &xferinfo);
@@ -2616,6 +2686,8 @@ void Downloader::processCloudSaveUploadQueue(Config conf, const unsigned int& ti
         iTotalRemainingBytes.fetch_sub(csf.fileSize);
 
         vDownloadInfo[tid].setFilename(csf.path);
+        ScopedFileEvent file_event("cloudsave-upload", csf.location);
+        TraceSpan file_span("upload file", csf.location);
 
         std::string filecontents;
         {
@@ -2649,20 +2721,21 @@ void Downloader::processCloudSaveUploadQueue(Config conf, const unsigned int& ti
         curl_easy_setopt(dlhandle, CURLOPT_URL, url.c_str());
 
         msgQueue.push(Message("Begin upload: " + csf.path, MSGTYPE_INFO, msg_prefix, MSGLEVEL_DEFAULT));
+        file_event.metadataDone();
 
         bool bShouldRetry = false;
         long int response_code = 0;
         std::string retry_reason;
         do
         {
-            if (conf.iWait > 0)
-                usleep(conf.iWait); // Wait before continuing
+            if (conf->iWait > 0)
+                usleep(conf->iWait); // Wait before continuing
 
             response_code = 0; // Make sure that response code is reset
 
             if (iRetryCount != 0)
             {
-                std::string retry_msg = "Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf.iRetries) + ": " + boost::filesystem::path(csf.location).filename().string();
+                std::string retry_msg = "Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf->iRetries) + ": " + boost::filesystem::path(csf.location).filename().string();
                 if (!retry_reason.empty())
                     retry_msg += " (" + retry_reason + ")";
                 msgQueue.push(Message(retry_msg, MSGTYPE_INFO, msg_prefix, MSGLEVEL_DEFAULT));
@@ -2670,9 +2743,10 @@ void Downloader::processCloudSaveUploadQueue(Config conf, const unsigned int& ti
             retry_reason.clear(); // reset retry reason
 
             xferinfo.offset = 0;
-            xferinfo.timer.reset();
-            xferinfo.TimeAndSize.clear();
+            vDownloadInfo[xferinfo.tid].beginTransfer();
             result = curl_easy_perform(dlhandle);
+            Globals::metrics.transfer(dlhandle, "cloudsave", result);
+            EventLog::addTransfer(dlhandle);
 
             switch (result)
             {
@@ -2700,10 +2774,13 @@ void Downloader::processCloudSaveUploadQueue(Config conf, const unsigned int& ti
 
             if (bShouldRetry) {
                 iRetryCount++;
+                Globals::metrics.retry("cloudsave", result, response_code);
+                EventLog::addRetry();
                 retry_reason = std::to_string(response_code) + ": " + curl_easy_strerror(result);
             }
-        } while (bShouldRetry && (iRetryCount <= conf.iRetries));
+        } while (bShouldRetry && (iRetryCount <= conf->iRetries));
 
+        file_event.event.status = (result == CURLE_OK) ? "ok" : curl_easy_strerror(result);
         curl_slist_free_all(header);
     }
 
@@ -2713,10 +2790,11 @@ void Downloader::processCloudSaveUploadQueue(Config conf, const unsigned int& ti
     msgQueue.push(Message("Finished all tasks", MSGTYPE_INFO, msg_prefix, MSGLEVEL_DEFAULT));
 }
 
-void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int& tid) {
+void Downloader::processCloudSaveDownloadQueue(ConfigSnapshot conf, const unsigned int& tid) {
     std::string msg_prefix = "[Thread #" + std::to_string(tid) + "]";
+    Globals::tracer.setThreadName("cloudsave download #" + std::to_string(tid));
 
-    std::unique_ptr<galaxyAPI> galaxy { new galaxyAPI(Globals::globalConfig.curlConf) };
+    std::unique_ptr<galaxyAPI> galaxy { new galaxyAPI(conf->curlConf) };
     if (!galaxy->init())
     {
         if (!galaxy->refreshLogin())
@@ -2729,7 +2807,7 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
 
     CURL* dlhandle = curl_easy_init();
 
-    Util::CurlHandleSetDefaultOptions(dlhandle, conf.curlConf);
+    Util::CurlHandleSetDefaultOptions(dlhandle, conf->curlConf);
 
     curl_slist *header = nullptr;
 
@@ -2749,7 +2827,6 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
 
     xferInfo xferinfo;
     xferinfo.tid = tid;
-    xferinfo.curlhandle = dlhandle;
 
     curl_easy_setopt(dlhandle, CURLOPT_XFERINFOFUNCTION, Downloader::progressCallbackForThread);
     curl_easy_setopt(dlhandle, CURLOPT_XFERINFODATA, &xferinfo);
@@ -2768,6 +2845,8 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
         boost::filesystem::path filepath = csf.location + ".~incomplete";
         filepath = boost::filesystem::absolute(filepath, boost::filesystem::current_path());
         boost::filesystem::path directory = filepath.parent_path();
+        ScopedFileEvent file_event("cloudsave-download", csf.location);
+        TraceSpan file_span("download file", csf.location);
 
         vDownloadInfo[tid].setFilename(csf.path);
 
@@ -2776,20 +2855,19 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
         msgQueue.push(Message("Begin download: " + csf.path, MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
 
         // Check that directory exists and create subdirectories
-        std::unique_lock<std::mutex> ul { mtx_create_directories }; // Use mutex to avoid possible race conditions
-        if (boost::filesystem::exists(directory))
+        int iDirResult = dirCache.create(directory.string());
+        if (iDirResult == ENOTDIR)
         {
-            if (!boost::filesystem::is_directory(directory)) {
-                msgQueue.push(Message(directory.string() + " is not directory, skipping file (" + filepath.filename().string() + ")", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_ALWAYS));
-                continue;
-            }
+            msgQueue.push(Message(directory.string() + " is not directory, skipping file (" + filepath.filename().string() + ")", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_ALWAYS));
+            continue;
         }
-        else if (!boost::filesystem::create_directories(directory))
+        else if (iDirResult != 0)
         {
             msgQueue.push(Message("Failed to create directory (" + directory.string() + "), skipping file (" + filepath.filename().string() + ")", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
             continue;
         }
 
+        file_event.metadataDone();
         auto url = "https://cloudstorage.gog.com/v1/" + Globals::galaxyConf.getUserId() + '/' + Globals::galaxyConf.getClientId() + '/' + csf.path;
         curl_easy_setopt(dlhandle, CURLOPT_HTTPHEADER, header);
         curl_easy_setopt(dlhandle, CURLOPT_URL, url.c_str());
@@ -2798,14 +2876,14 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
         std::string retry_reason;
         do
         {
-            if (conf.iWait > 0)
-                usleep(conf.iWait); // Wait before continuing
+            if (conf->iWait > 0)
+                usleep(conf->iWait); // Wait before continuing
 
             response_code = 0; // Make sure that response code is reset
 
             if (iRetryCount != 0)
             {
-                std::string retry_msg = "Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf.iRetries) + ": " + filepath.filename().string();
+                std::string retry_msg = "Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf->iRetries) + ": " + filepath.filename().string();
                 if (!retry_reason.empty())
                     retry_msg += " (" + retry_reason + ")";
                 msgQueue.push(Message(retry_msg, MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
@@ -2844,9 +2922,10 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
             }
 
             xferinfo.offset = iResumePosition;
-            xferinfo.timer.reset();
-            xferinfo.TimeAndSize.clear();
+            vDownloadInfo[xferinfo.tid].beginTransfer();
             result = curl_easy_perform(dlhandle);
+            Globals::metrics.transfer(dlhandle, "cloudsave", result);
+            EventLog::addTransfer(dlhandle);
             fclose(outfile);
 
             switch (result)
@@ -2874,16 +2953,21 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
             if (bShouldRetry)
             {
                 iRetryCount++;
+                Globals::metrics.retry("cloudsave", result, response_code);
+                EventLog::addRetry();
                 retry_reason = std::string(curl_easy_strerror(result));
                 if (boost::filesystem::exists(filepath) && boost::filesystem::is_regular_file(filepath)) {
                     bResume = true;
                 }
             }
 
-        } while (bShouldRetry && (iRetryCount <= conf.iRetries));
+        } while (bShouldRetry && (iRetryCount <= conf->iRetries));
 
+        file_event.event.resume_offset = iResumePosition;
+        file_event.event.status = curl_easy_strerror(result);
         if (result == CURLE_OK || result == CURLE_RANGE_ERROR || (result == CURLE_HTTP_RETURNED_ERROR && response_code == 416))
         {
+            file_event.event.status = "ok";
             // Set timestamp for downloaded file to same value as file on server
             // and rename "filename.~incomplete" to "filename"
             long filetime = -1;
@@ -2903,8 +2987,9 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
             }
 
             // Average download speed
-            progressInfo progress_info = vDownloadInfo[tid].getProgressInfo();
-            std::string rate_string = Util::makeRateString(progress_info.rate_avg, Globals::globalConfig.iUnitFormat);
+            curl_off_t curl_rate = 0;
+            curl_easy_getinfo(dlhandle, CURLINFO_SPEED_DOWNLOAD_T, &curl_rate);
+            std::string rate_string = Util::makeRateString(static_cast<double>(curl_rate), conf->iUnitFormat);
 
             msgQueue.push(Message("Download complete: " + csf.path + " (@ " + rate_string + ")", MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_DEFAULT));
         }
@@ -2935,11 +3020,12 @@ void Downloader::processCloudSaveDownloadQueue(Config conf, const unsigned int&
     msgQueue.push(Message("Finished all tasks", MSGTYPE_INFO, msg_prefix, MSGLEVEL_DEFAULT));
 }
 
-void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
+void Downloader::processDownloadQueue(ConfigSnapshot conf, const unsigned int& tid)
 {
     std::string msg_prefix = "[Thread #" + std::to_string(tid) + "]";
+    Globals::tracer.setThreadName("download #" + std::to_string(tid));
 
-    galaxyAPI* galaxy = new galaxyAPI(Globals::globalConfig.curlConf);
+    galaxyAPI* galaxy = new galaxyAPI(conf->curlConf);
     if (!galaxy->init())
     {
         if (!galaxy->refreshLogin())
@@ -2952,14 +3038,14 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
     }
 
     CURL* curlheader = curl_easy_init();
-    Util::CurlHandleSetDefaultOptions(curlheader, conf.curlConf);
+    Util::CurlHandleSetDefaultOptions(curlheader, conf->curlConf);
     curl_easy_setopt(curlheader, CURLOPT_NOPROGRESS, 1L);
     curl_easy_setopt(curlheader, CURLOPT_WRITEFUNCTION, Util::CurlWriteMemoryCallback);
     curl_easy_setopt(curlheader, CURLOPT_HEADER, 1L);
     curl_easy_setopt(curlheader, CURLOPT_NOBODY, 1L);
 
     CURL* dlhandle = curl_easy_init();
-    Util::CurlHandleSetDefaultOptions(dlhandle, conf.curlConf);
+    Util::CurlHandleSetDefaultOptions(dlhandle, conf->curlConf);
     curl_easy_setopt(dlhandle, CURLOPT_NOPROGRESS, 0);
     curl_easy_setopt(dlhandle, CURLOPT_WRITEFUNCTION, Downloader::writeData);
     curl_easy_setopt(dlhandle, CURLOPT_READFUNCTION, Downloader::readData);
@@ -2967,7 +3053,6 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
 
     xferInfo xferinfo;
     xferinfo.tid = tid;
-    xferinfo.curlhandle = dlhandle;
 
     curl_easy_setopt(dlhandle, CURLOPT_XFERINFOFUNCTION, Downloader::progressCallbackForThread);
     curl_easy_setopt(dlhandle, CURLOPT_XFERINFODATA, &xferinfo);
@@ -2996,52 +3081,39 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
         boost::filesystem::path filepath = gf.getFilepath();
         filepath = boost::filesystem::absolute(filepath, boost::filesystem::current_path());
         boost::filesystem::path directory = filepath.parent_path();
+        ScopedFileEvent file_event("download", filepath.string());
+        TraceSpan file_span("download file", filepath.string());
 
         // Skip blacklisted files
-        if (conf.blacklist.isBlacklisted(filepath.string()))
+        if (conf->blacklist.isBlacklisted(filepath.string()))
         {
+            file_event.event.status = "skipped";
             msgQueue.push(Message("Blacklisted file: " + filepath.string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
             continue;
         }
 
         std::string filenameXML = filepath.filename().string() + ".xml";
-        std::string xml_directory = conf.sXMLDirectory + "/" + gf.gamename;
+        std::string xml_directory = conf->sXMLDirectory + "/" + gf.gamename;
         boost::filesystem::path local_xml_file = xml_directory + "/" + filenameXML;
 
         vDownloadInfo[tid].setFilename(filepath.filename().string());
         msgQueue.push(Message("Begin download: " + filepath.filename().string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
 
         // Check that directory exists and create subdirectories
-        mtx_create_directories.lock(); // Use mutex to avoid possible race conditions
-        if (boost::filesystem::exists(directory))
+        int iDirResult = dirCache.create(directory.string());
+        if (iDirResult == ENOTDIR)
         {
-            if (!boost::filesystem::is_directory(directory))
-            {
-                mtx_create_directories.unlock();
-                msgQueue.push(Message(directory.string() + " is not directory, skipping file (" + filepath.filename().string() + ")", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_ALWAYS));
-                continue;
-            }
-            else
-            {
-                mtx_create_directories.unlock();
-            }
+            msgQueue.push(Message(directory.string() + " is not directory, skipping file (" + filepath.filename().string() + ")", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_ALWAYS));
+            continue;
         }
-        else
+        else if (iDirResult != 0)
         {
-            if (!boost::filesystem::create_directories(directory))
-            {
-                mtx_create_directories.unlock();
-                msgQueue.push(Message("Failed to create directory (" + directory.string() + "), skipping file (" + filepath.filename().string() + ")", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                continue;
-            }
-            else
-            {
-                mtx_create_directories.unlock();
-            }
+            msgQueue.push(Message("Failed to create directory (" + directory.string() + "), skipping file (" + filepath.filename().string() + ")", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+            continue;
         }
 
         bool bSameVersion = true; // assume same version
-        bool bLocalXMLExists = boost::filesystem::exists(local_xml_file); // This is additional check to see if remote xml should be saved to speed up future version checks
+        bool bLocalXMLExists = Globals::checksumStore.exists(local_xml_file.string()); // This is additional check to see if remote xml should be saved to speed up future version checks
 
         // Refresh Galaxy login if token is expired
         if (galaxy->isTokenExpired())
@@ -3086,7 +3158,7 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
         if (boost::filesystem::exists(filepath) && boost::filesystem::is_regular_file(filepath))
             bFileAlreadyExists = true;
 
-        if (gf.type & (GlobalConstants::GFTYPE_INSTALLER | GlobalConstants::GFTYPE_PATCH) && conf.dlConf.bRemoteXML)
+        if (gf.type & (GlobalConstants::GFTYPE_INSTALLER | GlobalConstants::GFTYPE_PATCH) && conf->dlConf.bRemoteXML)
         {
             std::string xml_url;
             if (downlinkJson.isMember("checksum"))
@@ -3094,12 +3166,12 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
                     xml_url = downlinkJson["checksum"].asString();
 
             // Get XML data
-            if (conf.dlConf.bRemoteXML && !xml_url.empty())
+            if (conf->dlConf.bRemoteXML && !xml_url.empty())
                 xml = galaxy->getResponse(xml_url);
 
-            if (!xml.empty() && !Globals::globalConfig.bSizeOnly)
+            if (!xml.empty() && !conf->bSizeOnly)
             {
-                std::string localHash = Util::getLocalFileHash(conf.sXMLDirectory, filepath.string(), gf.gamename);
+                std::string localHash = Util::getLocalFileHash(conf->sXMLDirectory, filepath.string(), gf.gamename);
                 // Do version check if local hash exists
                 if (!localHash.empty())
                 {
@@ -3121,31 +3193,11 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
             off_t filesize_xml = 0;
             off_t filesize_compare = 0;
 
-            if (bLocalXMLExists)
-            {
-                tinyxml2::XMLDocument local_xml;
-                local_xml.LoadFile(local_xml_file.string().c_str());
-                tinyxml2::XMLElement *fileElem = local_xml.FirstChildElement("file");
-
-                if (fileElem)
-                {
-                    std::string total_size = fileElem->Attribute("total_size");
-                    if (!total_size.empty())
-                    {
-                        filesize_xml = std::stol(total_size);
-                        try
-                        {
-                            filesize_xml = std::stol(total_size);
-                        }
-                        catch (std::invalid_argument& e)
-                        {
-                            filesize_xml = 0;
-                        }
-                    }
-                }
-            }
+            checksumEntry entry;
+            if (bLocalXMLExists && Globals::checksumStore.getEntry(local_xml_file.string(), entry))
+                filesize_xml = entry.total_size;
 
-            if(Globals::globalConfig.bTrustAPIForExtras)
+            if(conf->bTrustAPIForExtras)
             {
                 filesize_compare = filesize_api;
             }
@@ -3257,31 +3309,7 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
         {
             if ((bLocalXMLExists && !bSameVersion) || !bLocalXMLExists)
             {
-                // Check that directory exists and create subdirectories
-                boost::filesystem::path path = xml_directory;
-                mtx_create_directories.lock(); // Use mutex to avoid race conditions
-                if (boost::filesystem::exists(path))
-                {
-                    if (!boost::filesystem::is_directory(path))
-                    {
-                        msgQueue.push(Message(path.string() + " is not directory", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_ALWAYS));
-                    }
-                }
-                else
-                {
-                    if (!boost::filesystem::create_directories(path))
-                    {
-                        msgQueue.push(Message("Failed to create directory: " + path.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                    }
-                }
-                mtx_create_directories.unlock();
-                std::ofstream ofs(local_xml_file.string().c_str());
-                if (ofs)
-                {
-                    ofs << xml;
-                    ofs.close();
-                }
-                else
+                if (!Globals::checksumStore.saveXML(local_xml_file.string(), xml))
                 {
                     msgQueue.push(Message("Can't create " + local_xml_file.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_VERBOSE));
                 }
@@ -3290,8 +3318,12 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
 
         // File was complete and we have saved xml data so we can skip it
         if (bIsComplete)
+        {
+            file_event.event.status = "skipped";
             continue;
+        }
 
+        file_event.metadataDone();
         std::string url = downlinkJson["downlink"].asString();
         curl_easy_setopt(dlhandle, CURLOPT_URL, url.c_str());
         long int response_code = 0;
@@ -3299,14 +3331,14 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
         std::string retry_reason;
         do
         {
-            if (conf.iWait > 0)
-                usleep(conf.iWait); // Wait before continuing
+            if (conf->iWait > 0)
+                usleep(conf->iWait); // Wait before continuing
 
             response_code = 0; // Make sure that response code is reset
 
             if (iRetryCount != 0)
             {
-                std::string retry_msg = "Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf.iRetries) + ": " + filepath.filename().string();
+                std::string retry_msg = "Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf->iRetries) + ": " + filepath.filename().string();
                 if (!retry_reason.empty())
                     retry_msg += " (" + retry_reason + ")";
                 msgQueue.push(Message(retry_msg, MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
@@ -3345,9 +3377,10 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
             }
 
             xferinfo.offset = iResumePosition;
-            xferinfo.timer.reset();
-            xferinfo.TimeAndSize.clear();
+            vDownloadInfo[xferinfo.tid].beginTransfer();
             result = curl_easy_perform(dlhandle);
+            Globals::metrics.transfer(dlhandle, "download", result);
+            EventLog::addTransfer(dlhandle);
             fclose(outfile);
 
             switch (result)
@@ -3375,15 +3408,20 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
             if (bShouldRetry)
             {
                 iRetryCount++;
+                Globals::metrics.retry("download", result, response_code);
+                EventLog::addRetry();
                 retry_reason = std::string(curl_easy_strerror(result));
                 if (boost::filesystem::exists(filepath) && boost::filesystem::is_regular_file(filepath))
                     bResume = true;
             }
 
-        } while (bShouldRetry && (iRetryCount <= conf.iRetries));
+        } while (bShouldRetry && (iRetryCount <= conf->iRetries));
 
+        file_event.event.resume_offset = iResumePosition;
+        file_event.event.status = curl_easy_strerror(result);
         if (result == CURLE_OK || result == CURLE_RANGE_ERROR || (result == CURLE_HTTP_RETURNED_ERROR && response_code == 416))
         {
+            file_event.event.status = "ok";
             // Set timestamp for downloaded file to same value as file on server
             long filetime = -1;
             CURLcode res = curl_easy_getinfo(dlhandle, CURLINFO_FILETIME, &filetime);
@@ -3401,8 +3439,9 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
             }
 
             // Average download speed
-            progressInfo progress_info = vDownloadInfo[tid].getProgressInfo();
-            std::string rate_string = Util::makeRateString(progress_info.rate_avg, Globals::globalConfig.iUnitFormat);
+            curl_off_t curl_rate = 0;
+            curl_easy_getinfo(dlhandle, CURLINFO_SPEED_DOWNLOAD_T, &curl_rate);
+            std::string rate_string = Util::makeRateString(static_cast<double>(curl_rate), conf->iUnitFormat);
 
             msgQueue.push(Message("Download complete: " + filepath.filename().string() + " (@ " + rate_string + ")", MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_DEFAULT));
         }
@@ -3426,11 +3465,11 @@ void Downloader::processDownloadQueue(Config conf, const unsigned int& tid)
         }
 
         // Automatic xml creation
-        if (conf.dlConf.bAutomaticXMLCreation)
+        if (conf->dlConf.bAutomaticXMLCreation)
         {
             if (result == CURLE_OK)
             {
-                if ((gf.type & GlobalConstants::GFTYPE_EXTRA) || (conf.dlConf.bRemoteXML && !bLocalXMLExists && xml.empty()))
+                if ((gf.type & GlobalConstants::GFTYPE_EXTRA) || (conf->dlConf.bRemoteXML && !bLocalXMLExists && xml.empty()))
                     createXMLQueue.push(gf);
             }
         }
@@ -3454,60 +3493,37 @@ int Downloader::progressCallbackForThread(void *clientp, curl_off_t dltotal, cur
 
     xferInfo* xferinfo = static_cast<xferInfo*>(clientp);
 
-    // Update progress info every 100ms
-    if (xferinfo->timer.getTimeBetweenUpdates()>=100 || dlnow == dltotal)
+    // Publishing progress is cheap so it is done on every call
+    // Rate is estimated by progress reporter
+    if (xferinfo->isChunk)
     {
-        xferinfo->timer.reset();
-        progressInfo info;
-        info.dlnow = dlnow;
-        info.dltotal = dltotal;
-        curl_off_t curl_rate;
-
-        if (xferinfo->isChunk)
-        {
-            info.dlnow += xferinfo->chunk_file_offset;
-            info.dltotal = xferinfo->chunk_file_total;
-        }
-
-        // trying to get rate and setting to NaN if it fails
-        if (CURLE_OK != curl_easy_getinfo(xferinfo->curlhandle, CURLINFO_SPEED_DOWNLOAD_T, &curl_rate))
-            info.rate_avg = std::numeric_limits<double>::quiet_NaN();
-        else
-            info.rate_avg = static_cast<double>(curl_rate);
-
-        // setting full dlwnow and dltotal
-        if (xferinfo->offset > 0)
-        {
-            info.dlnow   += xferinfo->offset;
-            info.dltotal += xferinfo->offset;
-        }
-
-        // 10 second average download speed
-        // Don't use static value of 10 seconds because update interval depends on when and how often progress callback is called
-        xferinfo->TimeAndSize.push_back(std::make_pair(time(NULL), static_cast<uintmax_t>(info.dlnow)));
-        if (xferinfo->TimeAndSize.size() > 100) // 100 * 100ms = 10s
-        {
-            xferinfo->TimeAndSize.pop_front();
-            time_t time_first = xferinfo->TimeAndSize.front().first;
-            uintmax_t size_first = xferinfo->TimeAndSize.front().second;
-            time_t time_last = xferinfo->TimeAndSize.back().first;
-            uintmax_t size_last = xferinfo->TimeAndSize.back().second;
-            info.rate = (size_last - size_first) / static_cast<double>((time_last - time_first));
-        }
-        else
-        {
-            info.rate = info.rate_avg;
-        }
+        dlnow += xferinfo->chunk_file_offset;
+        dltotal = xferinfo->chunk_file_total;
+    }
 
-        vDownloadInfo[xferinfo->tid].setProgressInfo(info);
-        vDownloadInfo[xferinfo->tid].setStatus(DLSTATUS_RUNNING);
+    // setting full dlwnow and dltotal
+    if (xferinfo->offset > 0)
+    {
+        dlnow   += xferinfo->offset;
+        dltotal += xferinfo->offset;
     }
 
+    DownloadInfo& dlinfo = vDownloadInfo[xferinfo->tid];
+    dlinfo.setProgress(dlnow, dltotal);
+    if (dlinfo.getStatus() != DLSTATUS_RUNNING)
+        dlinfo.setStatus(DLSTATUS_RUNNING);
+
     return 0;
 }
 
 template <typename T> void Downloader::printProgress(const ThreadSafeQueue<T>& download_queue)
 {
+    if (Globals::globalConfig.bHeadlessProgress)
+    {
+        this->printProgressHeadless(download_queue);
+        return;
+    }
+
     int divisor_M = GlobalConstants::UNIT_DIVISOR_M_IEC;
     std::string unit_M = GlobalConstants::UNIT_STRING_M_IEC;
     if (Globals::globalConfig.iUnitFormat == GlobalConstants::UNIT_FORMAT_SI)
@@ -3518,6 +3534,9 @@ template <typename T> void Downloader::printProgress(const ThreadSafeQueue<T>& d
 
     // Print progress information until all threads have finished their tasks
     ProgressBar bar(Globals::globalConfig.bUnicode, Globals::globalConfig.bColor);
+    std::vector<ProgressRate> vProgressRate(vDownloadInfo.size());
+    std::vector<std::string> vFilename(vDownloadInfo.size());
+    std::vector<unsigned int> vFilenameVersion(vDownloadInfo.size(), 0);
     unsigned int dl_status = DLSTATUS_NOTSTARTED;
     while (dl_status != DLSTATUS_FINISHED)
     {
@@ -3561,8 +3580,10 @@ template <typename T> void Downloader::printProgress(const ThreadSafeQueue<T>& d
                 continue;
             }
 
-            std::string filename = vDownloadInfo[i].getFilename();
+            vDownloadInfo[i].getFilenameIfChanged(vFilename[i], vFilenameVersion[i]);
+            const std::string& filename = vFilename[i];
             progressInfo progress_info = vDownloadInfo[i].getProgressInfo();
+            vProgressRate[i].update(progress_info);
             total_rate += progress_info.rate;
 
             bool starting = ((0 == progress_info.dlnow) && (0 == progress_info.dltotal));
@@ -3640,15 +3661,85 @@ template <typename T> void Downloader::printProgress(const ThreadSafeQueue<T>& d
     }
 }
 
-void Downloader::getGameDetailsThread(Config config, const unsigned int& tid)
+// Progress output for logs when output is not a terminal
+// Prints messages as they come and a single status line every iHeadlessProgressInterval seconds
+// without progress bars or cursor movement
+// Progress of threads is sampled on every poll so that rate covers the whole interval
+// even when threads begin several transfers between status lines
+template <typename T> void Downloader::printProgressHeadless(const ThreadSafeQueue<T>& download_queue)
 {
-    std::string msg_prefix = "[Thread #" + std::to_string(tid) + "]";
-
-    galaxyAPI* galaxy = new galaxyAPI(Globals::globalConfig.curlConf);
-    if (!galaxy->init())
+    std::vector<progressInfo> vLastProgress(vDownloadInfo.size());
+    unsigned long long iBytesSinceStatus = 0;
+    std::chrono::steady_clock::time_point last_status = std::chrono::steady_clock::now();
+    unsigned int dl_status = DLSTATUS_NOTSTARTED;
+    while (dl_status != DLSTATUS_FINISHED)
     {
-        if (!galaxy->refreshLogin())
-        {
+        dl_status = DLSTATUS_NOTSTARTED;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(Globals::globalConfig.iProgressInterval));
+
+        Message msg;
+        while (msgQueue.try_pop(msg))
+        {
+            if (msg.getLevel() <= Globals::globalConfig.iMsgLevel)
+                std::cout << msg.getFormattedString(false, true) << std::endl; // No colors in logs
+
+            if (Globals::globalConfig.bReport)
+            {
+                this->report_ofs << msg.getTimestampString() << ": " << msg.getMessage() << std::endl;
+            }
+        }
+
+        unsigned int iActive = 0;
+        for (unsigned int i = 0; i < vDownloadInfo.size(); ++i)
+        {
+            unsigned int status = vDownloadInfo[i].getStatus();
+            dl_status |= status;
+            if (status != DLSTATUS_RUNNING)
+                continue;
+            ++iActive;
+
+            // Bytes received before first sample of new transfer are not counted
+            // because dlnow of resumed transfer includes bytes of earlier transfers
+            progressInfo progress_info = vDownloadInfo[i].getProgressInfo();
+            if (progress_info.transfer == vLastProgress[i].transfer && progress_info.dlnow >= vLastProgress[i].dlnow)
+                iBytesSinceStatus += progress_info.dlnow - vLastProgress[i].dlnow;
+            vLastProgress[i] = progress_info;
+        }
+
+        if (dl_status == DLSTATUS_FINISHED || Globals::globalConfig.iHeadlessProgressInterval == 0)
+            continue;
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - last_status < std::chrono::seconds(Globals::globalConfig.iHeadlessProgressInterval))
+            continue;
+
+        double total_rate = iBytesSinceStatus / std::chrono::duration<double>(now - last_status).count();
+        iBytesSinceStatus = 0;
+        last_status = now;
+
+        std::ostringstream ss;
+        ss << "Total: " << Util::makeRateString(total_rate, Globals::globalConfig.iUnitFormat);
+        ss << " | Active: " << iActive << "/" << vDownloadInfo.size();
+        ss << " | Remaining: " << download_queue.size();
+        unsigned long long total_remaining = iTotalRemainingBytes.load();
+        if (total_remaining > 0)
+            ss << " (" << Util::makeSizeString(total_remaining, Globals::globalConfig.iUnitFormat) << ")";
+
+        std::cout << Message(ss.str()).getFormattedString(false, false) << std::endl;
+    }
+}
+
+void Downloader::getGameDetailsThread(ConfigSnapshot config, const unsigned int& tid)
+{
+    std::string msg_prefix = "[Thread #" + std::to_string(tid) + "]";
+    Globals::tracer.setThreadName("game details #" + std::to_string(tid));
+
+    galaxyAPI* galaxy = new galaxyAPI(config->curlConf);
+    if (!galaxy->init())
+    {
+        if (!galaxy->refreshLogin())
+        {
             delete galaxy;
             msgQueue.push(Message("Galaxy API failed to refresh login", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
             vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
@@ -3669,34 +3760,35 @@ void Downloader::getGameDetailsThread(Config config, const unsigned int& tid)
 
     // Set default game specific directory options to values from config
     DirectoryConfig dirConfDefault;
-    dirConfDefault = config.dirConf;
+    dirConfDefault = config->dirConf;
 
     gameItem game_item;
     while (gameItemQueue.try_pop(game_item))
     {
+        TraceSpan game_span("game details", game_item.name);
         gameDetails game;
 
         gameSpecificConfig conf;
-        conf.dlConf = config.dlConf;
+        conf.dlConf = config->dlConf;
         conf.dirConf = dirConfDefault;
         conf.dlConf.bIgnoreDLCCount = false;
 
-        if (!config.bUpdateCache) // Disable game specific config files for cache update
+        if (!config->bUpdateCache) // Disable game specific config files for cache update
         {
             int iOptionsOverridden = Util::getGameSpecificConfig(game_item.name, &conf);
             if (iOptionsOverridden > 0)
             {
                 std::ostringstream ss;
                 ss << game_item.name << " - " << iOptionsOverridden << " options overridden with game specific options";
-                if (config.iMsgLevel >= MSGLEVEL_DEBUG)
+                if (config->iMsgLevel >= MSGLEVEL_DEBUG)
                 {
                     if (conf.dlConf.bIgnoreDLCCount)
                         ss << std::endl << "\tIgnore DLC count";
-                    if (conf.dlConf.iInclude != config.dlConf.iInclude)
+                    if (conf.dlConf.iInclude != config->dlConf.iInclude)
                         ss << std::endl << "\tInclude: " << Util::getOptionNameString(conf.dlConf.iInclude, GlobalConstants::INCLUDE_OPTIONS);
-                    if (conf.dlConf.iInstallerLanguage != config.dlConf.iInstallerLanguage)
+                    if (conf.dlConf.iInstallerLanguage != config->dlConf.iInstallerLanguage)
                         ss << std::endl << "\tLanguage: " << Util::getOptionNameString(conf.dlConf.iInstallerLanguage, GlobalConstants::LANGUAGES);
-                    if (conf.dlConf.vLanguagePriority != config.dlConf.vLanguagePriority)
+                    if (conf.dlConf.vLanguagePriority != config->dlConf.vLanguagePriority)
                     {
                         ss << std::endl << "\tLanguage priority:";
                         for (unsigned int j = 0; j < conf.dlConf.vLanguagePriority.size(); ++j)
@@ -3704,9 +3796,9 @@ void Downloader::getGameDetailsThread(Config config, const unsigned int& tid)
                             ss << std::endl << "\t  " << j << ": " << Util::getOptionNameString(conf.dlConf.vLanguagePriority[j], GlobalConstants::LANGUAGES);
                         }
                     }
-                    if (conf.dlConf.iInstallerPlatform != config.dlConf.iInstallerPlatform)
+                    if (conf.dlConf.iInstallerPlatform != config->dlConf.iInstallerPlatform)
                         ss << std::endl << "\tPlatform: " << Util::getOptionNameString(conf.dlConf.iInstallerPlatform, GlobalConstants::PLATFORMS);
-                    if (conf.dlConf.vPlatformPriority != config.dlConf.vPlatformPriority)
+                    if (conf.dlConf.vPlatformPriority != config->dlConf.vPlatformPriority)
                     {
                         ss << std::endl << "\tPlatform priority:";
                         for (unsigned int j = 0; j < conf.dlConf.vPlatformPriority.size(); ++j)
@@ -3838,9 +3930,7 @@ bool Downloader::galaxySelectProductIdHelper(const std::string& product_id, std:
     selected_product = product_id;
 
     // Check to see if product_id is id or gamename
-    boost::regex expression("^[0-9]+$");
-    boost::match_results<std::string::const_iterator> what;
-    if (!boost::regex_search(product_id, what, expression))
+    if (!PatternMatcher::get("^[0-9]+$")->search(product_id))
     {
         Globals::globalConfig.sGameRegex = product_id;
         this->getGameList();
@@ -3888,6 +3978,39 @@ bool Downloader::galaxySelectProductIdHelper(const std::string& product_id, std:
     return true;
 }
 
+// Get items of depots in the same order as depots
+// Manifests are fetched and parsed in parallel using --info-threads, each thread has its own galaxyAPI instance
+std::vector<std::vector<galaxyDepotItem>> Downloader::galaxyGetDepotItems(const std::vector<std::pair<Json::Value, bool>>& depots, const std::string& sLanguageRegex, const std::string& sGalaxyArch)
+{
+    std::vector<std::vector<galaxyDepotItem>> depot_items(depots.size());
+    unsigned int iThreads = std::min(static_cast<size_t>(Globals::globalConfig.iInfoThreads), depots.size());
+
+    if (iThreads <= 1)
+    {
+        for (unsigned int i = 0; i < depots.size(); ++i)
+            depot_items[i] = gogGalaxy->getFilteredDepotItemsVectorFromJson(depots[i].first, sLanguageRegex, sGalaxyArch, depots[i].second);
+        return depot_items;
+    }
+
+    std::atomic<unsigned int> iNextDepot(0);
+    std::vector<std::thread> vThreads;
+    for (unsigned int i = 0; i < iThreads; ++i)
+    {
+        vThreads.push_back(std::thread([&]()
+        {
+            std::unique_ptr<galaxyAPI> galaxy { new galaxyAPI(Globals::globalConfig.curlConf) };
+            unsigned int iDepot;
+            while ((iDepot = iNextDepot++) < depots.size())
+                depot_items[iDepot] = galaxy->getFilteredDepotItemsVectorFromJson(depots[iDepot].first, sLanguageRegex, sGalaxyArch, depots[iDepot].second);
+        }));
+    }
+
+    for (unsigned int i = 0; i < vThreads.size(); ++i)
+        vThreads[i].join();
+
+    return depot_items;
+}
+
 std::vector<galaxyDepotItem> Downloader::galaxyGetDepotItemVectorFromJson(const Json::Value& json, const unsigned int& iGalaxyArch)
 {
     std::string base_product_id = json["baseProductId"].asString();
@@ -3914,23 +4037,17 @@ std::vector<galaxyDepotItem> Downloader::galaxyGetDepotItemVectorFromJson(const
     }
 
     std::vector<galaxyDepotItem> items;
+    std::vector<std::pair<Json::Value, bool>> depots;
     for (unsigned int i = 0; i < json["depots"].size(); ++i)
-    {
-        std::vector<galaxyDepotItem> vec = gogGalaxy->getFilteredDepotItemsVectorFromJson(json["depots"][i], sLanguageRegex, sGalaxyArch);
-
-        if (!vec.empty())
-            items.insert(std::end(items), std::begin(vec), std::end(vec));
-    }
+        depots.push_back(std::make_pair(json["depots"][i], false));
 
-    if (!(Globals::globalConfig.dlConf.iInclude & GlobalConstants::GFTYPE_DLC))
+    for (auto& vec : this->galaxyGetDepotItems(depots, sLanguageRegex, sGalaxyArch))
     {
-        std::vector<galaxyDepotItem> items_no_dlc;
-        for (auto it : items)
+        for (auto& item : vec)
         {
-            if (it.product_id == base_product_id)
-                items_no_dlc.push_back(it);
+            if ((Globals::globalConfig.dlConf.iInclude & GlobalConstants::GFTYPE_DLC) || item.product_id == base_product_id)
+                items.push_back(std::move(item));
         }
-        items = items_no_dlc;
     }
 
     // Add dependency ids to vector
@@ -3949,17 +4066,16 @@ std::vector<galaxyDepotItem> Downloader::galaxyGetDepotItemVectorFromJson(const
         Json::Value dependenciesJson = gogGalaxy->getDependenciesJson();
         if (!dependenciesJson.empty() && dependenciesJson.isMember("depots"))
         {
+            std::vector<std::pair<Json::Value, bool>> dependency_depots;
             for (unsigned int i = 0; i < dependenciesJson["depots"].size(); ++i)
             {
                 std::string dependencyId = dependenciesJson["depots"][i]["dependencyId"].asString();
                 if (std::any_of(dependencies.begin(), dependencies.end(), [dependencyId](std::string dependency){return dependency == dependencyId;}))
-                {
-                    std::vector<galaxyDepotItem> vec = gogGalaxy->getFilteredDepotItemsVectorFromJson(dependenciesJson["depots"][i], sLanguageRegex, sGalaxyArch, true);
-
-                    if (!vec.empty())
-                        items.insert(std::end(items), std::begin(vec), std::end(vec));
-                }
+                    dependency_depots.push_back(std::make_pair(dependenciesJson["depots"][i], true));
             }
+
+            for (auto& vec : this->galaxyGetDepotItems(dependency_depots, sLanguageRegex, sGalaxyArch))
+                std::move(vec.begin(), vec.end(), std::back_inserter(items));
         }
     }
 
@@ -4022,6 +4138,8 @@ void Downloader::galaxyInstallGame(const std::string& product_id, const std::str
 
 void Downloader::galaxyInstallGameById(const std::string& product_id, const std::string& build_id, const unsigned int& iGalaxyArch)
 {
+    TraceSpan span("galaxyInstallGameById", product_id);
+
     std::string sPlatform;
     unsigned int iPlatform = Globals::globalConfig.dlConf.iGalaxyPlatform;
     if (iPlatform == GlobalConstants::PLATFORM_LINUX)
@@ -4082,7 +4200,7 @@ void Downloader::galaxyInstallGameById(const std::string& product_id, const std:
         if (Globals::globalConfig.blacklist.isBlacklisted(item_install_path))
         {
             if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
-                std::cout << "Skipping blacklisted file: " << item_install_path << std::endl;
+                std::cout << "Skipping blacklisted file: " << item_install_path << " (blacklist line " << Globals::globalConfig.blacklist.getMatchingItem(item_install_path)->linenr << ")" << std::endl;
             it = items.erase(it);
         }
         else
@@ -4195,7 +4313,109 @@ void Downloader::galaxyInstallGameById(const std::string& product_id, const std:
         }
     }
 
+    // Check for changed files between builds.
+    // Chunk list of previously installed build is added to changed files so that
+    // processGalaxyDownloadQueue can copy unchanged chunks from the local file
+    // and download only the new chunks.
+    if (!items_old.empty())
+    {
+        std::map<std::string, const galaxyDepotItem*> old_items_map;
+        for (const auto& old_item : items_old)
+        {
+            if (!old_item.isSmallFilesContainer)
+                old_items_map[old_item.path] = &old_item;
+        }
+
+        unsigned int iChangedFiles = 0;
+        uintmax_t iChangedSize = 0;
+        uintmax_t iDeltaSize = 0;
+        for (auto& item : items)
+        {
+            if (item.isSmallFilesContainer || item.chunks.empty())
+                continue;
+
+            auto old_item_it = old_items_map.find(item.path);
+            if (old_item_it == old_items_map.end())
+                continue;
+
+            const galaxyDepotItem* old_item = old_item_it->second;
+            if (old_item->chunks.empty())
+                continue;
+
+            bool bSameChunks = (old_item->chunks.size() == item.chunks.size());
+            for (unsigned int j = 0; bSameChunks && j < item.chunks.size(); ++j)
+            {
+                if (old_item->chunks.md5Uncompressed(j) != item.chunks.md5Uncompressed(j))
+                    bSameChunks = false;
+            }
+            if (bSameChunks)
+                continue;
+
+            // Local file must be from previous build, otherwise every chunk is downloaded
+            // and chunks of previous build must not be left out of download size
+            unsigned int last = old_item->chunks.size() - 1;
+            uintmax_t old_filesize = old_item->chunks.offsetUncompressed(last) + old_item->chunks.sizeUncompressed(last);
+            boost::system::error_code ec;
+            if (boost::filesystem::file_size(install_path + "/" + item.path, ec) != old_filesize || ec)
+                continue;
+
+            item.oldChunks = old_item->chunks;
+
+            std::unordered_set<galaxyChunkDigest, galaxyChunkDigestHash> old_chunk_hashes;
+            for (unsigned int j = 0; j < old_item->chunks.size(); ++j)
+                old_chunk_hashes.insert(old_item->chunks.md5Uncompressed(j));
+
+            iChangedFiles++;
+            iChangedSize += item.totalSizeCompressed;
+            for (unsigned int j = 0; j < item.chunks.size(); ++j)
+            {
+                if (old_chunk_hashes.count(item.chunks.md5Uncompressed(j)) == 0)
+                    iDeltaSize += item.chunks.sizeCompressed(j);
+            }
+        }
+
+        if (iChangedFiles > 0)
+        {
+            std::cout << "Changed files: " << iChangedFiles << " ("
+                << Util::makeSizeString(iDeltaSize, Globals::globalConfig.iUnitFormat) << " of "
+                << Util::makeSizeString(iChangedSize, Globals::globalConfig.iUnitFormat) << " in new chunks)" << std::endl;
+        }
+    }
+
+    // Find chunks that are used by more than one file.
+    // Each unique chunk is downloaded only once, download threads get later
+    // occurrences from memory or from the file where the chunk was written.
+    // Chunks that are copied from previous build in delta update are not counted.
+    galaxyChunkCache.clear();
+    if (!Globals::globalConfig.sGalaxyChunkStoreDirectory.empty())
+    {
+        uintmax_t iStoreSize = static_cast<uintmax_t>(Globals::globalConfig.iGalaxyChunkStoreSize) << 20;
+        galaxyChunkStore.init(Globals::globalConfig.sGalaxyChunkStoreDirectory, iStoreSize, Globals::globalConfig.bGalaxyChunkStoreReadOnly);
+    }
     uintmax_t totalSize = 0;
+    uintmax_t totalSizeCompressed = 0;
+    uintmax_t totalSizeDownload = 0;
+    for (unsigned int i = 0; i < items.size(); ++i)
+    {
+        const galaxyChunkRange& chunks = items[i].chunks;
+        std::unordered_set<galaxyChunkDigest, galaxyChunkDigestHash> old_chunk_hashes;
+        for (unsigned int j = 0; j < items[i].oldChunks.size(); ++j)
+            old_chunk_hashes.insert(items[i].oldChunks.md5Uncompressed(j));
+
+        items[i].totalSizeDownload = 0;
+        for (unsigned int j = 0; j < chunks.size(); ++j)
+        {
+            if (!old_chunk_hashes.empty() && old_chunk_hashes.count(chunks.md5Uncompressed(j)) > 0)
+                continue;
+
+            if (galaxyChunkCache.addReference(chunks.md5Compressed(j)))
+                items[i].totalSizeDownload += chunks.sizeCompressed(j);
+        }
+        totalSizeCompressed += items[i].totalSizeCompressed;
+        totalSizeDownload += items[i].totalSizeDownload;
+    }
+    galaxyChunkCache.finalize();
+
     for (unsigned int i = 0; i < items.size(); ++i)
     {
         if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
@@ -4205,13 +4425,18 @@ void Downloader::galaxyInstallGameById(const std::string& product_id, const std:
             std::cout << "\tmd5: " << items[i].md5 << std::endl;
         }
         totalSize += items[i].totalSizeUncompressed;
-        iTotalRemainingBytes.fetch_add(items[i].totalSizeCompressed);
+        iTotalRemainingBytes.fetch_add(items[i].totalSizeDownload);
         dlQueueGalaxy.push(items[i]);
     }
 
     std::cout << game_title << std::endl;
     std::cout << "Files: " << items.size() << std::endl;
     std::cout << "Total size installed: " << Util::makeSizeString(totalSize, Globals::globalConfig.iUnitFormat) << std::endl;
+    if (totalSizeDownload < totalSizeCompressed)
+    {
+        std::cout << "Download size: " << Util::makeSizeString(totalSizeDownload, Globals::globalConfig.iUnitFormat)
+            << " (" << Util::makeSizeString(totalSizeCompressed - totalSizeDownload, Globals::globalConfig.iUnitFormat) << " reused)" << std::endl;
+    }
 
     if (Globals::globalConfig.dlConf.bFreeSpaceCheck)
     {
@@ -4237,14 +4462,16 @@ void Downloader::galaxyInstallGameById(const std::string& product_id, const std:
     // Limit thread count to number of items in download queue
     unsigned int iThreads = std::min(Globals::globalConfig.iThreads, static_cast<unsigned int>(dlQueueGalaxy.size()));
 
+    // Directories may have been removed since previous run
+    dirCache.clear();
+
     // Create download threads
+    ConfigSnapshot config = std::make_shared<const Config>(Globals::globalConfig);
     std::vector<std::thread> vThreads;
+    vDownloadInfo.resize(iThreads);
     for (unsigned int i = 0; i < iThreads; ++i)
     {
-        DownloadInfo dlInfo;
-        dlInfo.setStatus(DLSTATUS_NOTSTARTED);
-        vDownloadInfo.push_back(dlInfo);
-        vThreads.push_back(std::thread(Downloader::processGalaxyDownloadQueue, install_path, Globals::globalConfig, i));
+        vThreads.push_back(std::thread(Downloader::processGalaxyDownloadQueue, install_path, config, i));
     }
 
     this->printProgress(dlQueueGalaxy);
@@ -4333,6 +4560,29 @@ void Downloader::galaxyInstallGameById(const std::string& product_id, const std:
     }
 }
 
+void Downloader::galaxyCheckChunkStore()
+{
+    if (Globals::globalConfig.sGalaxyChunkStoreDirectory.empty())
+    {
+        std::cerr << "Galaxy chunk store is not set. Use --galaxy-chunk-store to set directory" << std::endl;
+        return;
+    }
+
+    uintmax_t iStoreSize = static_cast<uintmax_t>(Globals::globalConfig.iGalaxyChunkStoreSize) << 20;
+    galaxyChunkStore.init(Globals::globalConfig.sGalaxyChunkStoreDirectory, iStoreSize, Globals::globalConfig.bGalaxyChunkStoreReadOnly);
+
+    std::cout << "Checking Galaxy chunk store: " << Globals::globalConfig.sGalaxyChunkStoreDirectory << std::endl;
+    chunkStoreScanResult result = galaxyChunkStore.check([](const std::string& path)
+    {
+        std::cout << "Invalid chunk: " << path << std::endl;
+    });
+
+    std::cout << "Chunks: " << result.chunks << " (" << Util::makeSizeString(result.size, Globals::globalConfig.iUnitFormat) << ")" << std::endl;
+    std::cout << "Invalid: " << result.invalid << std::endl;
+    if (result.removed > 0)
+        std::cout << "Deleted: " << result.removed << std::endl;
+}
+
 void Downloader::galaxyListCDNs(const std::string& product_id, const std::string& build_id)
 {
     std::string id;
@@ -4397,11 +4647,96 @@ void Downloader::galaxyListCDNsById(const std::string& product_id, const std::st
     return;
 }
 
-void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Config conf, const unsigned int& tid)
+// Result of copying chunk from local file
+static const unsigned int LOCALCHUNK_OK           = 0;
+static const unsigned int LOCALCHUNK_MISMATCH     = 1; // Chunk couldn't be read or hash doesn't match, it must be downloaded
+static const unsigned int LOCALCHUNK_WRITE_FAILED = 2; // Output file may contain part of the chunk
+
+// Read chunk from local file and verify it
+// Returns false if chunk couldn't be read or hash doesn't match
+static bool galaxyReadLocalChunk(FILE* f, const uintmax_t& offset, const uintmax_t& size, const galaxyChunkDigest& md5_uncompressed, std::string& chunk_data)
+{
+    if (!f)
+        return false;
+
+    // use fseeko to support large files on 32 bit platforms
+    if (fseeko(f, offset, SEEK_SET) != 0)
+        return false;
+    chunk_data.resize(size);
+    uintmax_t fread_size = fread(&chunk_data[0], 1, size, f);
+
+    galaxyChunkDigest digest;
+    return fread_size == size && galaxyChunkDigest::fromHex(Util::getChunkHash((unsigned char*)chunk_data.data(), size, RHASH_MD5), digest) && digest == md5_uncompressed;
+}
+
+// Read chunk from local file, verify it and append it to output file
+static unsigned int galaxyCopyLocalChunk(FILE* f, const uintmax_t& offset, const uintmax_t& size, const galaxyChunkDigest& md5_uncompressed, std::ofstream& ofs)
+{
+    std::string chunk_data;
+    if (!galaxyReadLocalChunk(f, offset, size, md5_uncompressed, chunk_data))
+        return LOCALCHUNK_MISMATCH;
+
+    // Flush so that other threads can read the chunk from file as soon as it is published
+    ofs.write(chunk_data.data(), size);
+    ofs.flush();
+
+    return ofs.good() ? LOCALCHUNK_OK : LOCALCHUNK_WRITE_FAILED;
+}
+
+// Find chunk to resume partially assembled file from
+// Returns 0 if file doesn't end at chunk boundary or last chunk in file doesn't match
+static unsigned int galaxyFindResumeChunk(const std::string& filepath, const galaxyChunkRange& chunks)
+{
+    uintmax_t filesize = boost::filesystem::file_size(filepath);
+    for (unsigned int j = 1; j <= chunks.size(); ++j)
+    {
+        uintmax_t chunk_end = chunks.offsetUncompressed(j - 1) + chunks.sizeUncompressed(j - 1);
+        if (chunk_end == filesize)
+        {
+            std::unique_ptr<FILE, int(*)(FILE*)> f(fopen(filepath.c_str(), "r"), fclose);
+            std::string chunk_data;
+            if (galaxyReadLocalChunk(f.get(), chunks.offsetUncompressed(j - 1), chunks.sizeUncompressed(j - 1), chunks.md5Uncompressed(j - 1), chunk_data))
+                return j;
+            break;
+        }
+        if (chunk_end > filesize)
+            break;
+    }
+    return 0;
+}
+
+// Decompress chunk and append it to output file
+static bool galaxyWriteChunk(std::ofstream& ofs, const std::string& output_filepath, const char* data, const uintmax_t& size)
+{
+    TraceSpan span("decompress chunk", output_filepath);
+    auto start = std::chrono::steady_clock::now();
+
+    ofs.seekp(0, std::ofstream::end);
+    std::streamoff start_pos = ofs.tellp();
+    {
+        boost::iostreams::filtering_streambuf<boost::iostreams::output> output;
+        output.push(boost::iostreams::zlib_decompressor(GlobalConstants::ZLIB_WINDOW_SIZE));
+        output.push(ofs);
+        boost::iostreams::write(output, data, size);
+    }
+    // Flush so that other threads can read the chunk from file as soon as it is published
+    ofs.flush();
+    bool bResult = ofs.good();
+    std::streamoff written = bResult ? static_cast<std::streamoff>(ofs.tellp()) - start_pos : 0;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Globals::metrics.diskWrite(seconds, written);
+    EventLog::addWriteTime(seconds);
+
+    return bResult;
+}
+
+void Downloader::processGalaxyDownloadQueue(const std::string& install_path, ConfigSnapshot conf, const unsigned int& tid)
 {
     std::string msg_prefix = "[Thread #" + std::to_string(tid) + "]";
+    Globals::tracer.setThreadName("galaxy download #" + std::to_string(tid));
 
-    galaxyAPI* galaxy = new galaxyAPI(Globals::globalConfig.curlConf);
+    galaxyAPI* galaxy = new galaxyAPI(conf->curlConf);
     if (!galaxy->init())
     {
         if (!galaxy->refreshLogin())
@@ -4414,7 +4749,7 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
     }
 
     CURL* dlhandle = curl_easy_init();
-    Util::CurlHandleSetDefaultOptions(dlhandle, Globals::globalConfig.curlConf);
+    Util::CurlHandleSetDefaultOptions(dlhandle, conf->curlConf);
     curl_easy_setopt(dlhandle, CURLOPT_NOPROGRESS, 0);
     curl_easy_setopt(dlhandle, CURLOPT_WRITEFUNCTION, Downloader::writeData);
     curl_easy_setopt(dlhandle, CURLOPT_READFUNCTION, Downloader::readData);
@@ -4422,7 +4757,6 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
 
     xferInfo xferinfo;
     xferinfo.tid = tid;
-    xferinfo.curlhandle = dlhandle;
 
     curl_easy_setopt(dlhandle, CURLOPT_XFERINFOFUNCTION, Downloader::progressCallbackForThread);
     curl_easy_setopt(dlhandle, CURLOPT_XFERINFODATA, &xferinfo);
@@ -4440,41 +4774,76 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
             cdnUrlTemplates.clear();
 
         vDownloadInfo[tid].setStatus(DLSTATUS_STARTING);
-        iTotalRemainingBytes.fetch_sub(item.totalSizeCompressed);
+        iTotalRemainingBytes.fetch_sub(item.totalSizeDownload);
 
         boost::filesystem::path path = install_path + "/" + item.path;
+        ScopedFileEvent file_event("galaxy", path.string());
+        TraceSpan file_span("download file", path.string());
 
         // Check that directory exists and create it
         boost::filesystem::path directory = path.parent_path();
-        mtx_create_directories.lock(); // Use mutex to avoid possible race conditions
-        if (boost::filesystem::exists(directory))
+        int iDirResult = dirCache.create(directory.string());
+        if (iDirResult != 0)
         {
-            if (!boost::filesystem::is_directory(directory))
-            {
+            if (iDirResult == ENOTDIR)
                 msgQueue.push(Message(directory.string() + " is not directory", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
-                delete galaxy;
-                mtx_create_directories.unlock();
-                return;
-            }
-        }
-        else
-        {
-            if (!boost::filesystem::create_directories(directory))
-            {
+            else
                 msgQueue.push(Message("Failed to create directory: " + directory.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
-                delete galaxy;
-                mtx_create_directories.unlock();
-                return;
-            }
+            vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
+            delete galaxy;
+            return;
         }
-        mtx_create_directories.unlock();
 
         vDownloadInfo[tid].setFilename(path.string());
 
+        // Delta update
+        // File has changed between builds and local file is from previously installed build.
+        // New file is assembled to temporary file using chunks from local file where possible.
+        bool bDeltaUpdate = false;
+        boost::filesystem::path path_delta = path.string() + ".lgogdltmp";
+        std::unordered_map<galaxyChunkDigest, unsigned int, galaxyChunkDigestHash> mOldChunks; // md5_uncompressed -> index in item.oldChunks
+        uintmax_t iDeltaCopiedBytes = 0;
         unsigned int start_chunk = 0;
-        if (boost::filesystem::exists(path))
+        if (!item.oldChunks.empty() && !item.chunks.empty() && boost::filesystem::exists(path))
+        {
+            unsigned int last = item.oldChunks.size() - 1;
+            uintmax_t old_filesize = item.oldChunks.offsetUncompressed(last) + item.oldChunks.sizeUncompressed(last);
+            uintmax_t filesize = boost::filesystem::file_size(path);
+            if (filesize == old_filesize)
+            {
+                // File can have same size in both builds so local file may already be up to date
+                if (filesize == item.totalSizeUncompressed && Util::getFileHash(path.string(), RHASH_MD5) == item.md5)
+                {
+                    if (boost::filesystem::exists(path_delta))
+                        boost::filesystem::remove(path_delta);
+                    file_event.event.status = "skipped";
+                    msgQueue.push(Message(path.string() + ": OK", MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_DEFAULT));
+                    continue;
+                }
+
+                for (unsigned int j = 0; j < item.oldChunks.size(); ++j)
+                    mOldChunks.insert(std::make_pair(item.oldChunks.md5Uncompressed(j), j));
+
+                // Resume previous delta update if it was interrupted
+                if (boost::filesystem::exists(path_delta))
+                {
+                    start_chunk = galaxyFindResumeChunk(path_delta.string(), item.chunks);
+                    if (start_chunk > 0)
+                        msgQueue.push(Message(path_delta.string() + ": Resume from chunk " + std::to_string(start_chunk), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+                    else if (!boost::filesystem::remove(path_delta))
+                    {
+                        msgQueue.push(Message(path_delta.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+                        continue;
+                    }
+                }
+
+                bDeltaUpdate = true;
+                msgQueue.push(Message(path.string() + ": Updating from previous build", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+            }
+        }
+        boost::filesystem::path output_path = bDeltaUpdate ? path_delta : path;
+
+        if (!bDeltaUpdate && boost::filesystem::exists(path))
         {
             msgQueue.push(Message("File already exists: " + path.string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
 
@@ -4485,6 +4854,7 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                 // File is same size
                 if (item.totalSizeUncompressed == 0 || Util::getFileHash(path.string(), RHASH_MD5) == item.md5)
                 {
+                    file_event.event.status = "skipped";
                     msgQueue.push(Message(path.string() + ": OK", MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_DEFAULT));
                     continue;
                 }
@@ -4513,7 +4883,7 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                 // File is smaller than on server, resume
                 for (unsigned int j = 0; j < item.chunks.size(); ++j)
                 {
-                    if (item.chunks[j].offset_uncompressed == filesize)
+                    if (item.chunks.offsetUncompressed(j) == filesize)
                     {
                         resume_chunk = j;
                         break;
@@ -4532,9 +4902,9 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                     }
 
                     unsigned int previous_chunk = resume_chunk - 1;
-                    uintmax_t chunk_size = item.chunks[previous_chunk].size_uncompressed;
+                    uintmax_t chunk_size = item.chunks.sizeUncompressed(previous_chunk);
                     // use fseeko to support large files on 32 bit platforms
-                    fseeko(f, item.chunks[previous_chunk].offset_uncompressed, SEEK_SET);
+                    fseeko(f, item.chunks.offsetUncompressed(previous_chunk), SEEK_SET);
                     unsigned char *chunk = (unsigned char *) malloc(chunk_size * sizeof(unsigned char *));
                     if (chunk == NULL)
                     {
@@ -4555,7 +4925,7 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                     std::string chunk_hash = Util::getChunkHash(chunk, chunk_size, RHASH_MD5);
                     free(chunk);
 
-                    if (chunk_hash == item.chunks[previous_chunk].md5_uncompressed)
+                    if (chunk_hash == item.chunks.md5Uncompressed(previous_chunk).hex())
                     {
                         // Hash for previous chunk matches, resume at this position
                         start_chunk = resume_chunk;
@@ -4583,6 +4953,10 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
             }
         }
 
+        file_event.metadataDone();
+        if (start_chunk > 0 && start_chunk < item.chunks.size())
+            file_event.event.resume_offset = item.chunks.offsetUncompressed(start_chunk);
+
         bool bChunkFailure = false;
         std::time_t timestamp = -1;
         // Handle empty files
@@ -4593,16 +4967,105 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
             if (ofs)
                 ofs.close();
         }
+
+        // Local file of previous build and output file are opened once for all chunks
+        std::unique_ptr<FILE, int(*)(FILE*)> old_file(bDeltaUpdate ? fopen(path.string().c_str(), "r") : nullptr, fclose);
+        std::ofstream output_file;
+        if (start_chunk < item.chunks.size())
+        {
+            output_file.open(output_path.string(), std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+            if (!output_file)
+            {
+                msgQueue.push(Message(output_path.string() + ": Failed to open", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+                continue;
+            }
+        }
+
         for (unsigned int j = start_chunk; j < item.chunks.size(); ++j)
         {
             xferinfo.isChunk = true;
-            xferinfo.chunk_file_offset = item.chunks[j].offset_compressed; // Set offset for progress info
+            xferinfo.chunk_file_offset = item.chunks.offsetCompressed(j); // Set offset for progress info
+
+            // Use chunk from local file if it exists in previous build
+            if (bDeltaUpdate)
+            {
+                auto old_chunk = mOldChunks.find(item.chunks.md5Uncompressed(j));
+                if (old_chunk != mOldChunks.end() && item.oldChunks.sizeUncompressed(old_chunk->second) == item.chunks.sizeUncompressed(j))
+                {
+                    unsigned int iCopyResult = galaxyCopyLocalChunk(old_file.get(), item.oldChunks.offsetUncompressed(old_chunk->second), item.chunks.sizeUncompressed(j), item.chunks.md5Uncompressed(j), output_file);
+                    if (iCopyResult == LOCALCHUNK_OK)
+                    {
+                        iDeltaCopiedBytes += item.chunks.sizeUncompressed(j);
+                        continue;
+                    }
+                    if (iCopyResult == LOCALCHUNK_WRITE_FAILED)
+                    {
+                        bChunkFailure = true;
+                        msgQueue.push(Message(output_path.string() + ": Failed to write chunk " + std::to_string(j + 1), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
+                        break;
+                    }
+                    msgQueue.push(Message(path.string() + ": Local chunk " + std::to_string(j + 1) + " failed hash check, downloading it", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_VERBOSE));
+                }
+            }
+
+            // Use chunk that was already downloaded for another file
+            // Region of delta update is moved from temporary file to path when the file is renamed
+            chunkRegion region;
+            region.filepath = output_path.string();
+            region.offset = item.chunks.offsetUncompressed(j);
+            std::string cached_data;
+            chunkRegion cached_region;
+            unsigned int iCacheResult = galaxyChunkCache.acquire(item.chunks.md5Compressed(j), cached_data, cached_region);
+            if (iCacheResult == CHUNKCACHE_MEMORY)
+            {
+                if (galaxyWriteChunk(output_file, output_path.string(), cached_data.data(), cached_data.size()))
+                    continue;
+                bChunkFailure = true;
+                msgQueue.push(Message(output_path.string() + ": Failed to write chunk " + std::to_string(j + 1), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
+                break;
+            }
+            else if (iCacheResult == CHUNKCACHE_FILE)
+            {
+                std::unique_ptr<FILE, int(*)(FILE*)> cached_file(fopen(cached_region.filepath.c_str(), "r"), fclose);
+                unsigned int iCopyResult = galaxyCopyLocalChunk(cached_file.get(), cached_region.offset, item.chunks.sizeUncompressed(j), item.chunks.md5Uncompressed(j), output_file);
+                if (iCopyResult == LOCALCHUNK_OK)
+                    continue;
+                if (iCopyResult == LOCALCHUNK_WRITE_FAILED)
+                {
+                    bChunkFailure = true;
+                    msgQueue.push(Message(output_path.string() + ": Failed to write chunk " + std::to_string(j + 1), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
+                    break;
+                }
+                msgQueue.push(Message(path.string() + ": Chunk " + std::to_string(j + 1) + " from " + cached_region.filepath + " failed hash check, downloading it", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_VERBOSE));
+            }
+
+            // Hex hash is used for chunk store paths and urls
+            std::string md5_compressed = item.chunks.md5Compressed(j).hex();
+
+            // Use chunk from local chunk store
+            if (galaxyChunkStore.isEnabled())
+            {
+                std::string stored_data;
+                if (galaxyChunkStore.get(md5_compressed, stored_data))
+                {
+                    if (galaxyWriteChunk(output_file, output_path.string(), stored_data.data(), stored_data.size()))
+                    {
+                        galaxyChunkCache.complete(item.chunks.md5Compressed(j), stored_data.data(), stored_data.size(), region);
+                        continue;
+                    }
+                    bChunkFailure = true;
+                    galaxyChunkCache.abort(item.chunks.md5Compressed(j));
+                    msgQueue.push(Message(output_path.string() + ": Failed to write chunk " + std::to_string(j + 1), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
+                    break;
+                }
+            }
 
             // Refresh Galaxy login if token is expired
             if (galaxy->isTokenExpired())
             {
                 if (!galaxy->refreshLogin())
                 {
+                    galaxyChunkCache.abort(item.chunks.md5Compressed(j));
                     msgQueue.push(Message("Galaxy API failed to refresh login", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
                     vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
                     delete galaxy;
@@ -4610,7 +5073,7 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                 }
             }
 
-            std::string galaxyPath = galaxy->hashToGalaxyPath(item.chunks[j].md5_compressed);
+            std::string galaxyPath = galaxy->hashToGalaxyPath(md5_compressed);
             // Get url templates for cdns
             // Regular files can re-use these
             // Dependencies require new url everytime
@@ -4625,17 +5088,19 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                 if (json.empty())
                 {
                     bChunkFailure = true;
-                    std::string error_message = path.string() + ": Empty JSON response (product: " + item.product_id + ", chunk #"+ std::to_string(j) + ": " + item.chunks[j].md5_compressed + ")";
+                    galaxyChunkCache.abort(item.chunks.md5Compressed(j));
+                    std::string error_message = path.string() + ": Empty JSON response (product: " + item.product_id + ", chunk #"+ std::to_string(j) + ": " + md5_compressed + ")";
                     msgQueue.push(Message(error_message, MSGTYPE_ERROR, msg_prefix, MSGLEVEL_VERBOSE));
                     break;
                 }
 
-                cdnUrlTemplates = galaxy->cdnUrlTemplatesFromJson(json, conf.dlConf.vGalaxyCDNPriority);
+                cdnUrlTemplates = galaxy->cdnUrlTemplatesFromJson(json, conf->dlConf.vGalaxyCDNPriority);
             }
 
             if (cdnUrlTemplates.empty())
             {
                 bChunkFailure = true;
+                galaxyChunkCache.abort(item.chunks.md5Compressed(j));
                 msgQueue.push(Message(path.string() + ": Failed to get download url", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
                 break;
             }
@@ -4668,6 +5133,7 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
 
             std::string filepath_and_chunk = path.string() + " (chunk " + std::to_string(j + 1) + "/" + std::to_string(item.chunks.size()) + ")";
             vDownloadInfo[tid].setFilename(filepath_and_chunk);
+            TraceSpan chunk_span("download chunk", filepath_and_chunk);
 
             CURLcode result;
             int iRetryCount = 0;
@@ -4676,14 +5142,14 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
             std::string retry_reason;
             do
             {
-                if (Globals::globalConfig.iWait > 0)
-                    usleep(Globals::globalConfig.iWait); // Delay the request by specified time
+                if (conf->iWait > 0)
+                    usleep(conf->iWait); // Delay the request by specified time
 
                 response_code = 0; // Make sure that response code is reset
 
                 if (iRetryCount != 0)
                 {
-                    std::string retry_msg = "Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf.iRetries) + ": " + filepath_and_chunk;
+                    std::string retry_msg = "Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf->iRetries) + ": " + filepath_and_chunk;
                     if (!retry_reason.empty())
                         retry_msg += " (" + retry_reason + ")";
                     msgQueue.push(Message(retry_msg, MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
@@ -4693,9 +5159,10 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                 retry_reason = ""; // reset retry reason
 
                 xferinfo.offset = chunk.size;
-                xferinfo.timer.reset();
-                xferinfo.TimeAndSize.clear();
+                vDownloadInfo[xferinfo.tid].beginTransfer();
                 result = curl_easy_perform(dlhandle);
+                Globals::metrics.transfer(dlhandle, "galaxy", result);
+                EventLog::addTransfer(dlhandle);
 
                 switch (result)
                 {
@@ -4721,17 +5188,19 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                 if (bShouldRetry)
                 {
                     iRetryCount++;
+                    Globals::metrics.retry("galaxy", result, response_code);
+                    EventLog::addRetry();
                     retry_reason = std::string(curl_easy_strerror(result));
                 }
                 else
                 {
                     std::string chunk_hash = Util::getChunkHash((unsigned char*)chunk.memory, chunk.size, RHASH_MD5);
-                    if (chunk_hash != item.chunks[j].md5_compressed)
+                    if (chunk_hash != md5_compressed)
                     {
                         bShouldRetry = true;
                         iRetryCount++;
                         retry_reason = "Chunk failed hash check";
-                        if (iRetryCount <= conf.iRetries)
+                        if (iRetryCount <= conf->iRetries)
                         {
                             free(chunk.memory);
                             chunk.memory = (char *) malloc(1);
@@ -4740,7 +5209,7 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                     }
                 }
 
-            } while (bShouldRetry && (iRetryCount <= conf.iRetries));
+            } while (bShouldRetry && (iRetryCount <= conf->iRetries));
 
             curl_easy_setopt(dlhandle, CURLOPT_WRITEFUNCTION, Downloader::writeData);
             curl_easy_setopt(dlhandle, CURLOPT_NOPROGRESS, 0);
@@ -4749,10 +5218,12 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
             if (bShouldRetry)
             {
                 bChunkFailure = true;
+                galaxyChunkCache.abort(item.chunks.md5Compressed(j));
                 free(chunk.memory);
                 break;
             }
 
+            bool bChunkOK = (result == CURLE_OK);
             if (result != CURLE_OK)
             {
                 msgQueue.push(Message(std::string(curl_easy_strerror(result)), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_VERBOSE));
@@ -4775,26 +5246,61 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
                     timestamp = (std::time_t)filetime;
             }
 
-            std::ofstream ofs(path.string(), std::ofstream::out | std::ofstream::binary | std::ofstream::app);
-            if (ofs)
-            {
-                boost::iostreams::filtering_streambuf<boost::iostreams::output> output;
-                output.push(boost::iostreams::zlib_decompressor(GlobalConstants::ZLIB_WINDOW_SIZE));
-                output.push(ofs);
-                boost::iostreams::write(output, chunk.memory, chunk.size);
-            }
-            if (ofs)
-                ofs.close();
+            // Chunk has passed hash check if download was successful
+            if (bChunkOK)
+                galaxyChunkStore.put(md5_compressed, chunk.memory, chunk.size);
+
+            bool bWriteOK = galaxyWriteChunk(output_file, output_path.string(), chunk.memory, chunk.size);
+            if (bWriteOK && bChunkOK)
+                galaxyChunkCache.complete(item.chunks.md5Compressed(j), chunk.memory, chunk.size, region);
+            else
+                galaxyChunkCache.abort(item.chunks.md5Compressed(j));
 
             free(chunk.memory);
+
+            // Old file is replaced in delta update so every chunk must be written and verified
+            if (!bWriteOK || (bDeltaUpdate && !bChunkOK))
+            {
+                bChunkFailure = true;
+                if (!bWriteOK)
+                    msgQueue.push(Message(output_path.string() + ": Failed to write chunk " + std::to_string(j + 1), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
+                break;
+            }
         }
+        output_file.close();
+        old_file.reset();
 
         if (bChunkFailure)
         {
+            file_event.event.status = "chunk failure";
             msgQueue.push(Message(path.string() + ": Chunk failure, skipping file", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
             continue;
         }
 
+        // Replace old file with the new file
+        if (bDeltaUpdate)
+        {
+            boost::system::error_code ec;
+            if (boost::filesystem::file_size(path_delta, ec) != item.totalSizeUncompressed || ec)
+            {
+                file_event.event.status = "chunk failure";
+                msgQueue.push(Message(path_delta.string() + ": File size doesn't match, keeping old file", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
+                continue;
+            }
+
+            try
+            {
+                boost::filesystem::rename(path_delta, path);
+            }
+            catch(const boost::filesystem::filesystem_error& e)
+            {
+                msgQueue.push(Message(e.what(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+                continue;
+            }
+            galaxyChunkCache.renameFile(path_delta.string(), path.string());
+            msgQueue.push(Message(path.string() + ": Reused " + Util::makeSizeString(iDeltaCopiedBytes, conf->iUnitFormat) + " from previous build", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+        }
+
         // Set timestamp for downloaded file to same value as file on server
         if (boost::filesystem::exists(path) && timestamp >= 0)
         {
@@ -4808,6 +5314,7 @@ void Downloader::processGalaxyDownloadQueue(const std::string& install_path, Con
             }
         }
 
+        file_event.event.status = "ok";
         msgQueue.push(Message("Download complete: " + path.string(), MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_DEFAULT));
     }
 
@@ -5248,13 +5755,12 @@ void Downloader::uploadCloudSavesById(const std::string& product_id, const std::
     unsigned int iThreads = std::min(Globals::globalConfig.iThreads, static_cast<unsigned int>(dlCloudSaveQueue.size()));
 
     // Create download threads
+    ConfigSnapshot config = std::make_shared<const Config>(Globals::globalConfig);
     std::vector<std::thread> vThreads;
+    vDownloadInfo.resize(iThreads);
     for (unsigned int i = 0; i < iThreads; ++i)
     {
-        DownloadInfo dlInfo;
-        dlInfo.setStatus(DLSTATUS_NOTSTARTED);
-        vDownloadInfo.push_back(dlInfo);
-        vThreads.push_back(std::thread(Downloader::processCloudSaveUploadQueue, Globals::globalConfig, i));
+        vThreads.push_back(std::thread(Downloader::processCloudSaveUploadQueue, config, i));
     }
 
     this->printProgress(dlCloudSaveQueue);
@@ -5341,14 +5847,16 @@ void Downloader::downloadCloudSavesById(const std::string& product_id, const std
     // Limit thread count to number of items in download queue
     unsigned int iThreads = std::min(Globals::globalConfig.iThreads, static_cast<unsigned int>(dlCloudSaveQueue.size()));
 
+    // Directories may have been removed since previous run
+    dirCache.clear();
+
     // Create download threads
+    ConfigSnapshot config = std::make_shared<const Config>(Globals::globalConfig);
     std::vector<std::thread> vThreads;
+    vDownloadInfo.resize(iThreads);
     for (unsigned int i = 0; i < iThreads; ++i)
     {
-        DownloadInfo dlInfo;
-        dlInfo.setStatus(DLSTATUS_NOTSTARTED);
-        vDownloadInfo.push_back(dlInfo);
-        vThreads.push_back(std::thread(Downloader::processCloudSaveDownloadQueue, Globals::globalConfig, i));
+        vThreads.push_back(std::thread(Downloader::processCloudSaveDownloadQueue, config, i));
     }
 
     this->printProgress(dlCloudSaveQueue);
@@ -5460,80 +5968,128 @@ void Downloader::galaxyShowLocalCloudSavesById(const std::string& product_id, co
 std::vector<std::string> Downloader::galaxyGetOrphanedFiles(const std::vector<galaxyDepotItem>& items, const std::string& install_path)
 {
     std::vector<std::string> orphans;
-    std::vector<std::string> item_paths;
-    for (unsigned int i = 0; i < items.size(); ++i)
-        item_paths.push_back(install_path + "/" + items[i].path);
 
-    std::vector<boost::filesystem::path> filepath_vector;
-    try
+    if (!boost::filesystem::exists(install_path))
     {
-        std::size_t pathlen = Globals::globalConfig.dirConf.sDirectory.length();
-        if (boost::filesystem::exists(install_path))
-        {
-            if (boost::filesystem::is_directory(install_path))
-            {
-                // Recursively iterate over files in directory
-                boost::filesystem::recursive_directory_iterator end_iter;
-                boost::filesystem::recursive_directory_iterator dir_iter(install_path);
-                while (dir_iter != end_iter)
-                {
-                    if (boost::filesystem::is_regular_file(dir_iter->status()))
-                    {
-                        std::string filepath = dir_iter->path().string();
-                        if (Globals::globalConfig.ignorelist.isBlacklisted(filepath.substr(pathlen)))
-                        {
-                            if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
-                                std::cerr << "skipped ignorelisted file " << filepath << std::endl;
-                        }
-                        else if (Globals::globalConfig.blacklist.isBlacklisted(filepath.substr(pathlen)))
-                        {
-                            if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
-                                std::cerr << "skipped blacklisted file " << filepath << std::endl;
-                        }
-                        else
-                        {
-                            filepath_vector.push_back(dir_iter->path());
-                        }
-                    }
-                    dir_iter++;
-                }
-            }
-        }
-        else
-            std::cerr << install_path << " does not exist" << std::endl;
-    }
-    catch (const boost::filesystem::filesystem_error& ex)
-    {
-        std::cout << ex.what() << std::endl;
+        std::cerr << install_path << " does not exist" << std::endl;
+        return orphans;
     }
+    else if (!boost::filesystem::is_directory(install_path))
+        return orphans;
 
-    std::sort(item_paths.begin(), item_paths.end());
-    std::sort(filepath_vector.begin(), filepath_vector.end());
+    OrphanScanner scanner(Globals::globalConfig.blacklist, Globals::globalConfig.ignorelist, Globals::globalConfig.dirConf.sDirectory.length());
+    scanner.addDirectory(install_path);
+    for (unsigned int i = 0; i < items.size(); ++i)
+        scanner.addExpectedPath(install_path + "/" + items[i].path);
 
-    if (!filepath_vector.empty())
+    scanner.scan(Globals::globalConfig.iThreads, [&](const orphanScanResult& result)
     {
-        for (unsigned int i = 0; i < filepath_vector.size(); ++i)
+        if (result.type == ORPHANSCAN_ORPHAN)
+            orphans.push_back(result.path);
+        else if (result.type == ORPHANSCAN_IGNORELISTED)
         {
-            bool bFileIsOrphaned = true;
-            for (std::vector<std::string>::iterator it = item_paths.begin(); it != item_paths.end(); it++)
-            {
-                boost::filesystem::path item_path = *it;
-                boost::filesystem::path file_path = filepath_vector[i].native();
+            if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
+                std::cerr << "skipped ignorelisted file " << result.path << " (ignorelist line " << result.linenr << ")" << std::endl;
+        }
+        else if (result.type == ORPHANSCAN_BLACKLISTED)
+        {
+            if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
+                std::cerr << "skipped blacklisted file " << result.path << " (blacklist line " << result.linenr << ")" << std::endl;
+        }
+        else if (result.type == ORPHANSCAN_ERROR)
+            std::cout << result.path << std::endl;
+    });
 
-                if (item_path == file_path)
-                {
-                    bFileIsOrphaned = false;
-                    item_paths.erase(it);
-                    break;
-                }
+    std::sort(orphans.begin(), orphans.end());
+
+    return orphans;
+}
+
+// Read-only memory mapping of local MojoSetup installer
+class MojoSetupLocalInstaller
+{
+    public:
+        MojoSetupLocalInstaller() {};
+        ~MojoSetupLocalInstaller() { this->close(); }
+
+        bool open(const std::string& filepath)
+        {
+            this->close();
+
+            int fd = ::open(filepath.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size <= 0)
+            {
+                ::close(fd);
+                return false;
             }
 
-            if (bFileIsOrphaned)
-                orphans.push_back(filepath_vector[i].string());
+            void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (map == MAP_FAILED)
+                return false;
+
+            data_ = static_cast<const char*>(map);
+            size_ = st.st_size;
+            return true;
+        }
+
+        void close()
+        {
+            if (data_ != nullptr)
+                munmap(const_cast<char*>(data_), size_);
+            data_ = nullptr;
+            size_ = 0;
+        }
+
+        bool isOpen() const { return data_ != nullptr; }
+        const char* data() const { return data_; }
+        off_t size() const { return size_; }
+
+        // Tell kernel that range is read sequentially and soon
+        void adviseSequential(const off_t& from, const off_t& to) const
+        {
+            long page_size = sysconf(_SC_PAGESIZE);
+            off_t aligned_from = from - (from % page_size);
+            off_t last = std::min(to, size_ - 1);
+            if (aligned_from >= 0 && aligned_from <= last)
+                posix_madvise(const_cast<char*>(data_ + aligned_from), last - aligned_from + 1, POSIX_MADV_SEQUENTIAL);
         }
+    private:
+        MojoSetupLocalInstaller(const MojoSetupLocalInstaller&) = delete;
+        MojoSetupLocalInstaller& operator=(const MojoSetupLocalInstaller&) = delete;
+
+        const char* data_ = nullptr;
+        off_t size_ = 0;
+};
+
+// Get inclusive range of MojoSetup installer from local installer if it is open, otherwise from server
+// Range is clamped to installer size like server does
+static CURLcode mojoSetupGetRange(CURL* curlhandle, const std::string& installer_url, const MojoSetupLocalInstaller& local_installer, const off_t& from, const off_t& to, std::stringstream& data)
+{
+    if (local_installer.isOpen())
+    {
+        off_t last = std::min(to, local_installer.size() - 1);
+        if (from < 0 || from > last)
+            return CURLE_READ_ERROR;
+
+        data.write(local_installer.data() + from, last - from + 1);
+        return CURLE_OK;
     }
 
-    return orphans;
+    std::string range = std::to_string(from) + "-" + std::to_string(to);
+    curl_easy_setopt(curlhandle, CURLOPT_URL, installer_url.c_str());
+    curl_easy_setopt(curlhandle, CURLOPT_NOPROGRESS, 1);
+    curl_easy_setopt(curlhandle, CURLOPT_WRITEFUNCTION, Util::CurlWriteMemoryCallback);
+    curl_easy_setopt(curlhandle, CURLOPT_WRITEDATA, &data);
+    curl_easy_setopt(curlhandle, CURLOPT_RANGE, range.c_str());
+    CURLcode result = curl_easy_perform(curlhandle);
+    curl_easy_setopt(curlhandle, CURLOPT_RANGE, NULL);
+
+    return result;
 }
 
 void Downloader::galaxyInstallGame_MojoSetupHack(const std::string& product_id)
@@ -5545,6 +6101,7 @@ void Downloader::galaxyInstallGame_MojoSetupHack(const std::string& product_id)
 
     Json::Value product_info = gogGalaxy->getProductInfo(product_id);
     gameDetails game = gogGalaxy->productInfoJsonToGameDetails(product_info, dlConf);
+    game.makeFilepaths(Globals::globalConfig.dirConf); // Used to find installers in download directory
 
     std::vector<gameFile> vInstallers;
     if (!game.installers.empty())
@@ -5609,19 +6166,14 @@ void Downloader::galaxyInstallGame_MojoSetupHack(const std::string& product_id)
             if (zfe.filepath.find(split_files) != std::string::npos)
             {
                 std::cout << "Getting info about split files" << std::endl;
-                std::string url = zfe.installer_url;
-                std::string dlrange = std::to_string(zfe.start_offset_mojosetup) + "-" + std::to_string(zfe.end_offset);
-                curl_easy_setopt(curlhandle, CURLOPT_URL, url.c_str());
+                MojoSetupLocalInstaller local_installer;
+                if (!zfe.installer_path.empty())
+                    local_installer.open(zfe.installer_path);
 
                 std::stringstream splitfiles_compressed;
                 std::stringstream splitfiles_uncompressed;
 
-                CURLcode result = CURLE_RECV_ERROR;
-                curl_easy_setopt(curlhandle, CURLOPT_WRITEFUNCTION, Util::CurlWriteMemoryCallback);
-                curl_easy_setopt(curlhandle, CURLOPT_WRITEDATA, &splitfiles_compressed);
-                curl_easy_setopt(curlhandle, CURLOPT_RANGE, dlrange.c_str());
-                result = curl_easy_perform(curlhandle);
-                curl_easy_setopt(curlhandle, CURLOPT_RANGE, NULL);
+                CURLcode result = mojoSetupGetRange(curlhandle, zfe.installer_url, local_installer, zfe.start_offset_mojosetup, zfe.end_offset, splitfiles_compressed);
 
                 if (result == CURLE_OK)
                 {
@@ -5735,41 +6287,39 @@ void Downloader::galaxyInstallGame_MojoSetupHack(const std::string& product_id)
             vZipFiles.insert(std::end(vZipFiles), std::begin(vZipFilesSplit), std::end(vZipFilesSplit));
         }
 
-        // Add files to download queue
+        // Add files and symlinks to download queue
+        std::vector<zipFileEntry> vQueueEntries;
+        vZipFiles.insert(std::end(vZipFiles), std::begin(vZipFilesSymlink), std::end(vZipFilesSymlink));
         uintmax_t totalSize = 0;
+        uintmax_t totalCompSize = 0;
         for (std::uintmax_t i = 0; i < vZipFiles.size(); ++i)
         {
             // Don't add blacklisted files
             if (Globals::globalConfig.blacklist.isBlacklisted(vZipFiles[i].filepath))
             {
                 if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
-                    std::cout << "Skipping blacklisted file: " << vZipFiles[i].filepath << std::endl;
+                    std::cout << "Skipping blacklisted file: " << vZipFiles[i].filepath << " (blacklist line " << Globals::globalConfig.blacklist.getMatchingItem(vZipFiles[i].filepath)->linenr << ")" << std::endl;
 
                 continue;
             }
-            dlQueueGalaxy_MojoSetupHack.push(vZipFiles[i]);
-            iTotalRemainingBytes.fetch_add(vZipFiles[i].comp_size);
+            vQueueEntries.push_back(vZipFiles[i]);
             totalSize += vZipFiles[i].uncomp_size;
+            totalCompSize += vZipFiles[i].comp_size;
         }
 
-        // Add symlinks to download queue
-        for (std::uintmax_t i = 0; i < vZipFilesSymlink.size(); ++i)
+        // Adjacent entries are downloaded with one range request
+        // Aim for at least 4 spans per thread to balance load between threads
+        off_t span_size = totalCompSize / (std::max(Globals::globalConfig.iThreads, 1u) * 4);
+        span_size = std::max(MOJOSETUP_SPAN_MIN_SIZE, std::min(MOJOSETUP_SPAN_MAX_SIZE, span_size));
+        std::vector<mojoSetupSpan> vSpans = Downloader::mojoSetupPlanSpans(vQueueEntries, span_size);
+        for (auto& span : vSpans)
         {
-            // Don't add blacklisted files
-            if (Globals::globalConfig.blacklist.isBlacklisted(vZipFilesSymlink[i].filepath))
-            {
-                if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
-                    std::cout << "Skipping blacklisted file: " << vZipFilesSymlink[i].filepath << std::endl;
-
-                continue;
-            }
-            dlQueueGalaxy_MojoSetupHack.push(vZipFilesSymlink[i]);
-            iTotalRemainingBytes.fetch_add(vZipFilesSymlink[i].comp_size);
-            totalSize += vZipFilesSymlink[i].uncomp_size;
+            iTotalRemainingBytes.fetch_add(span.comp_size);
+            dlQueueGalaxy_MojoSetupHack.push(span);
         }
 
         std::cout << game.title << std::endl;
-        std::cout << "Files: " << dlQueueGalaxy_MojoSetupHack.size() << std::endl;
+        std::cout << "Files: " << vQueueEntries.size() << std::endl;
         std::cout << "Total size installed: " << Util::makeSizeString(totalSize, Globals::globalConfig.iUnitFormat) << std::endl;
 
         if (Globals::globalConfig.dlConf.bFreeSpaceCheck)
@@ -5806,17 +6356,26 @@ void Downloader::galaxyInstallGame_MojoSetupHack(const std::string& product_id)
             }
         }
 
+        // Extracting from local installers is bound by CPU so threads beyond core count don't help
+        // Thread count set by user is the upper bound
+        unsigned int iThreads = Globals::globalConfig.iThreads;
+        unsigned int iCores = std::thread::hardware_concurrency();
+        if (iCores > 0 && !vSpans.empty() && std::all_of(vSpans.begin(), vSpans.end(), [](const mojoSetupSpan& span) { return !span.installer_path.empty(); }))
+            iThreads = std::min(iThreads, iCores);
+
         // Limit thread count to number of items in download queue
-        unsigned int iThreads = std::min(Globals::globalConfig.iThreads, static_cast<unsigned int>(dlQueueGalaxy_MojoSetupHack.size()));
+        iThreads = std::min(iThreads, static_cast<unsigned int>(dlQueueGalaxy_MojoSetupHack.size()));
+
+        // Directories may have been removed since previous run
+        dirCache.clear();
 
         // Create download threads
+        ConfigSnapshot config = std::make_shared<const Config>(Globals::globalConfig);
         std::vector<std::thread> vThreads;
+        vDownloadInfo.resize(iThreads);
         for (unsigned int i = 0; i < iThreads; ++i)
         {
-            DownloadInfo dlInfo;
-            dlInfo.setStatus(DLSTATUS_NOTSTARTED);
-            vDownloadInfo.push_back(dlInfo);
-            vThreads.push_back(std::thread(Downloader::processGalaxyDownloadQueue_MojoSetupHack, Globals::globalConfig, i));
+            vThreads.push_back(std::thread(Downloader::processGalaxyDownloadQueue_MojoSetupHack, config, i));
         }
 
         this->printProgress(dlQueueGalaxy_MojoSetupHack);
@@ -5960,213 +6519,358 @@ void Downloader::galaxyInstallGame_MojoSetupHack_CombineSplitFiles(const splitFi
     return;
 }
 
-void Downloader::processGalaxyDownloadQueue_MojoSetupHack(Config conf, const unsigned int& tid)
+std::vector<mojoSetupSpan> Downloader::mojoSetupPlanSpans(std::vector<zipFileEntry> vEntries, const off_t& max_span_size)
 {
-    std::string msg_prefix = "[Thread #" + std::to_string(tid) + "]";
+    std::vector<mojoSetupSpan> vSpans;
+
+    std::sort(vEntries.begin(), vEntries.end(), [](const zipFileEntry& i, const zipFileEntry& j) -> bool {
+        if (i.installer_path != j.installer_path)
+            return i.installer_path < j.installer_path;
+        if (i.installer_url != j.installer_url)
+            return i.installer_url < j.installer_url;
+        return i.start_offset_mojosetup < j.start_offset_mojosetup;
+    });
 
-    CURL* dlhandle = curl_easy_init();
-    Util::CurlHandleSetDefaultOptions(dlhandle, conf.curlConf);
-    curl_easy_setopt(dlhandle, CURLOPT_NOPROGRESS, 0);
-    curl_easy_setopt(dlhandle, CURLOPT_WRITEFUNCTION, Downloader::writeData);
-    curl_easy_setopt(dlhandle, CURLOPT_READFUNCTION, Downloader::readData);
-    curl_easy_setopt(dlhandle, CURLOPT_FILETIME, 1L);
+    for (auto& zfe : vEntries)
+    {
+        bool bNewSpan = vSpans.empty();
+        if (!bNewSpan)
+        {
+            const mojoSetupSpan& span = vSpans.back();
+            if (zfe.installer_url != span.installer_url || zfe.installer_path != span.installer_path)
+                bNewSpan = true;
+            else if (zfe.start_offset_mojosetup - span.end_offset - 1 > MOJOSETUP_MAX_SPAN_GAP)
+                bNewSpan = true;
+            else if (zfe.end_offset - span.start_offset + 1 > max_span_size)
+                bNewSpan = true;
+        }
 
-    xferInfo xferinfo;
-    xferinfo.tid = tid;
-    xferinfo.curlhandle = dlhandle;
+        if (bNewSpan)
+        {
+            mojoSetupSpan span;
+            span.installer_url = zfe.installer_url;
+            span.installer_path = zfe.installer_path;
+            span.start_offset = zfe.start_offset_mojosetup;
+            vSpans.push_back(span);
+        }
 
-    curl_easy_setopt(dlhandle, CURLOPT_XFERINFOFUNCTION, Downloader::progressCallbackForThread);
-    curl_easy_setopt(dlhandle, CURLOPT_XFERINFODATA, &xferinfo);
+        mojoSetupSpan& span = vSpans.back();
+        span.end_offset = zfe.end_offset;
+        span.comp_size += zfe.comp_size;
+        span.entries.push_back(zfe);
+    }
 
+    return vSpans;
+}
+
+// Entry of MojoSetup span being downloaded
+// Entries are extracted while they are received. Symlink targets are kept in memory.
+// Large remote entries and partial temporary files of earlier runs are downloaded to temporary file
+// and extracted after download so that failed download can be continued on next run.
+struct mojoSetupSpanEntry
+{
     zipFileEntry zfe;
-    while (dlQueueGalaxy_MojoSetupHack.try_pop(zfe))
+    off_t size = 0; // Size of entry data in installer including local file header
+    off_t received = 0;
+    bool bUseTempFile = false;
+    FILE* tmpfile = NULL;
+    std::shared_ptr<std::ofstream> ofs;
+    std::shared_ptr<std::stringstream> link_target;
+    std::shared_ptr<ZipUtil::EntryExtractor> extractor;
+    int iExtractResult = 0;
+};
+
+struct mojoSetupSpanTransfer
+{
+    CURL* curlhandle = NULL;
+    unsigned int tid = 0;
+    std::vector<mojoSetupSpanEntry>* entries = NULL;
+    std::size_t current = 0; // Entry that receives next data
+    std::size_t current_shown = std::numeric_limits<std::size_t>::max();
+    off_t position = 0; // Offset of next received byte in installer
+    bool bRangeChecked = false;
+    bool bRangeIgnored = false;
+};
+
+// Split data received for range of MojoSetup installer to entries
+// Data between entries belongs to entries that don't need downloading and is discarded
+static size_t mojoSetupWriteSpanData(char *ptr, size_t size, size_t nmemb, void *userp)
+{
+    mojoSetupSpanTransfer* transfer = static_cast<mojoSetupSpanTransfer*>(userp);
+    std::vector<mojoSetupSpanEntry>& entries = *transfer->entries;
+    size_t total = size * nmemb;
+
+    // Data would end up in wrong entries if server ignored the range
+    if (!transfer->bRangeChecked)
     {
-        vDownloadInfo[tid].setStatus(DLSTATUS_STARTING);
-        iTotalRemainingBytes.fetch_sub(zfe.comp_size);
+        long response_code = 0;
+        curl_easy_getinfo(transfer->curlhandle, CURLINFO_RESPONSE_CODE, &response_code);
+        if (response_code != 206)
+        {
+            transfer->bRangeIgnored = true;
+            return 0;
+        }
+        transfer->bRangeChecked = true;
+    }
 
-        boost::filesystem::path path = zfe.filepath;
-        boost::filesystem::path path_tmp = zfe.filepath + ".lgogdltmp";
+    size_t pos = 0;
+    while (pos < total && transfer->current < entries.size())
+    {
+        mojoSetupSpanEntry& entry = entries[transfer->current];
+        if (entry.received >= entry.size)
+        {
+            transfer->current++;
+            continue;
+        }
 
-        // Check that directory exists and create it
-        boost::filesystem::path directory = path.parent_path();
-        mtx_create_directories.lock(); // Use mutex to avoid possible race conditions
-        if (boost::filesystem::exists(directory))
+        off_t entry_position = entry.zfe.start_offset_mojosetup + entry.received;
+        if (transfer->position < entry_position)
+        {
+            size_t skip = std::min(static_cast<size_t>(entry_position - transfer->position), total - pos);
+            pos += skip;
+            transfer->position += skip;
+            continue;
+        }
+
+        if (transfer->current != transfer->current_shown)
         {
-            if (!boost::filesystem::is_directory(directory))
+            vDownloadInfo[transfer->tid].setFilename(entry.bUseTempFile ? entry.zfe.filepath + ".lgogdltmp" : entry.zfe.filepath);
+            transfer->current_shown = transfer->current;
+        }
+
+        size_t len = std::min(static_cast<size_t>(entry.size - entry.received), total - pos);
+        if (entry.bUseTempFile)
+        {
+            if (!entry.tmpfile)
             {
-                msgQueue.push(Message(directory.string() + " is not directory", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
-                mtx_create_directories.unlock();
-                return;
+                std::string path_tmp = entry.zfe.filepath + ".lgogdltmp";
+                entry.tmpfile = fopen(path_tmp.c_str(), entry.received > 0 ? "ab" : "wb");
+                if (!entry.tmpfile)
+                {
+                    msgQueue.push(Message("Failed to create " + path_tmp, MSGTYPE_ERROR, "[Thread #" + std::to_string(transfer->tid) + "]", MSGLEVEL_ALWAYS));
+                    return 0;
+                }
             }
+
+            auto start = std::chrono::steady_clock::now();
+            size_t written = fwrite(ptr + pos, 1, len, entry.tmpfile);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            Globals::metrics.diskWrite(seconds, written);
+            EventLog::addWriteTime(seconds);
+
+            entry.received += written;
+            transfer->position += written;
+            if (written != len)
+                return 0;
         }
         else
         {
-            if (!boost::filesystem::create_directories(directory))
+            if (!entry.extractor)
             {
-                msgQueue.push(Message("Failed to create directory: " + directory.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
-                mtx_create_directories.unlock();
-                return;
+                std::ostream* output;
+                if (ZipUtil::isSymlink(entry.zfe.file_attributes))
+                {
+                    entry.link_target = std::make_shared<std::stringstream>();
+                    output = entry.link_target.get();
+                }
+                else
+                {
+                    entry.ofs = std::make_shared<std::ofstream>(entry.zfe.filepath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+                    output = entry.ofs.get();
+                    if (!*entry.ofs)
+                        entry.iExtractResult = 3;
+                }
+                entry.extractor = std::make_shared<ZipUtil::EntryExtractor>(output, entry.zfe.comp_size);
             }
-        }
-        mtx_create_directories.unlock();
 
-        vDownloadInfo[tid].setFilename(path.string());
+            // Failed entry is skipped without aborting transfer of other entries
+            if (entry.iExtractResult == 0)
+            {
+                auto start = std::chrono::steady_clock::now();
+                uint64_t uncomp_size = entry.extractor->getUncompressedSize();
+                entry.iExtractResult = entry.extractor->write(ptr + pos, len);
+                if (entry.ofs)
+                {
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    Globals::metrics.diskWrite(seconds, entry.extractor->getUncompressedSize() - uncomp_size);
+                    EventLog::addWriteTime(seconds);
+                }
+            }
+            entry.received += len;
+            transfer->position += len;
+        }
+        pos += len;
 
-        if (ZipUtil::isSymlink(zfe.file_attributes))
+        if (entry.received >= entry.size)
         {
-            if (boost::filesystem::is_symlink(path))
+            if (entry.tmpfile)
             {
-                msgQueue.push(Message("Symlink already exists: " + path.string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
-                continue;
+                fclose(entry.tmpfile);
+                entry.tmpfile = NULL;
             }
+            if (entry.ofs)
+                entry.ofs->close();
+            transfer->current++;
         }
-        else
+    }
+
+    return total;
+}
+
+static std::string mojoSetupExtractError(const int& res)
+{
+    std::string msg = "Extraction failed (";
+    switch (res)
+    {
+        case 1:
+            msg += "invalid local file header";
+            break;
+        case 2:
+            msg += "unsupported compression method";
+            break;
+        case 3:
+            msg += "failed to write output file";
+            break;
+        case 4:
+            msg += "zlib error";
+            break;
+        default:
+            msg += "unknown error";
+            break;
+    }
+    msg += ")";
+
+    return msg;
+}
+
+// Check existing files of MojoSetup entry
+// Returns false if entry doesn't need to be downloaded
+// resume_from is set to size of partially downloaded temporary file
+static bool mojoSetupEntryNeedsDownload(const zipFileEntry& zfe, off_t& resume_from, const std::string& msg_prefix)
+{
+    boost::filesystem::path path = zfe.filepath;
+    boost::filesystem::path path_tmp = zfe.filepath + ".lgogdltmp";
+    resume_from = 0;
+
+    if (ZipUtil::isSymlink(zfe.file_attributes))
+    {
+        if (boost::filesystem::is_symlink(path))
+        {
+            msgQueue.push(Message("Symlink already exists: " + path.string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+            return false;
+        }
+    }
+    else
+    {
+        if (zfe.isSplitFile)
         {
-            if (zfe.isSplitFile)
+            if (boost::filesystem::exists(zfe.splitFileBasePath))
             {
-                if (boost::filesystem::exists(zfe.splitFileBasePath))
-                {
-                    msgQueue.push(Message(path.string() + ": Complete file (" + zfe.splitFileBasePath + ") of split file exists. Checking if it is same version.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+                msgQueue.push(Message(path.string() + ": Complete file (" + zfe.splitFileBasePath + ") of split file exists. Checking if it is same version.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
 
-                    std::string crc32 = Util::getFileHashRange(zfe.splitFileBasePath, RHASH_CRC32, zfe.splitFileStartOffset, zfe.splitFileEndOffset);
-                    if (crc32 == Util::formattedString("%08x", zfe.crc32))
-                    {
-                        msgQueue.push(Message(path.string() + ": Complete file (" + zfe.splitFileBasePath + ") of split file is same version. Skipping file.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
-                        continue;
-                    }
-                    else
-                    {
-                        msgQueue.push(Message(path.string() + ": Complete file (" + zfe.splitFileBasePath + ") of split file is different version. Continuing to download file.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
-                    }
+                std::string crc32 = Util::getFileHashRange(zfe.splitFileBasePath, RHASH_CRC32, zfe.splitFileStartOffset, zfe.splitFileEndOffset);
+                if (crc32 == Util::formattedString("%08x", zfe.crc32))
+                {
+                    msgQueue.push(Message(path.string() + ": Complete file (" + zfe.splitFileBasePath + ") of split file is same version. Skipping file.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+                    return false;
+                }
+                else
+                {
+                    msgQueue.push(Message(path.string() + ": Complete file (" + zfe.splitFileBasePath + ") of split file is different version. Continuing to download file.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
                 }
             }
+        }
 
-            if (boost::filesystem::exists(path))
-            {
-                msgQueue.push(Message("File already exists: " + path.string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+        if (boost::filesystem::exists(path))
+        {
+            msgQueue.push(Message("File already exists: " + path.string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
 
-                off_t filesize = static_cast<off_t>(boost::filesystem::file_size(path));
-                if (filesize == zfe.uncomp_size)
+            off_t filesize = static_cast<off_t>(boost::filesystem::file_size(path));
+            if (filesize == zfe.uncomp_size)
+            {
+                // File is same size
+                if (Util::getFileHash(path.string(), RHASH_CRC32) == Util::formattedString("%08x", zfe.crc32))
                 {
-                    // File is same size
-                    if (Util::getFileHash(path.string(), RHASH_CRC32) == Util::formattedString("%08x", zfe.crc32))
-                    {
-                        msgQueue.push(Message(path.string() + ": OK", MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_VERBOSE));
-                        continue;
-                    }
-                    else
-                    {
-                        msgQueue.push(Message(path.string() + ": CRC32 mismatch. Deleting old file.", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_VERBOSE));
-                        if (!boost::filesystem::remove(path))
-                        {
-                            msgQueue.push(Message(path.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                            continue;
-                        }
-                    }
+                    msgQueue.push(Message(path.string() + ": OK", MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_VERBOSE));
+                    return false;
                 }
                 else
                 {
-                    // File size mismatch
-                    msgQueue.push(Message(path.string() + ": File size mismatch. Deleting old file.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+                    msgQueue.push(Message(path.string() + ": CRC32 mismatch. Deleting old file.", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_VERBOSE));
                     if (!boost::filesystem::remove(path))
                     {
                         msgQueue.push(Message(path.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                        continue;
+                        return false;
                     }
                 }
             }
-        }
-
-        off_t resume_from = 0;
-        if (boost::filesystem::exists(path_tmp))
-        {
-            off_t filesize = static_cast<off_t>(boost::filesystem::file_size(path_tmp));
-            if (filesize < zfe.comp_size)
-            {
-                // Continue
-                resume_from = filesize;
-            }
             else
             {
-                // Delete old file
-                msgQueue.push(Message(path_tmp.string() + ": Deleting old file.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
-                if (!boost::filesystem::remove(path_tmp))
+                // File size mismatch
+                msgQueue.push(Message(path.string() + ": File size mismatch. Deleting old file.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+                if (!boost::filesystem::remove(path))
                 {
-                    msgQueue.push(Message(path_tmp.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                    continue;
+                    msgQueue.push(Message(path.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+                    return false;
                 }
             }
         }
+    }
 
-        std::string url = zfe.installer_url;
-        std::string dlrange = std::to_string(zfe.start_offset_mojosetup) + "-" + std::to_string(zfe.end_offset);
-        curl_easy_setopt(dlhandle, CURLOPT_URL, url.c_str());
-        if (ZipUtil::isSymlink(zfe.file_attributes))
+    if (boost::filesystem::exists(path_tmp))
+    {
+        off_t filesize = static_cast<off_t>(boost::filesystem::file_size(path_tmp));
+        if (filesize < zfe.end_offset - zfe.start_offset_mojosetup + 1)
         {
-            // Symlink
-            std::stringstream symlink_compressed;
-            std::stringstream symlink_uncompressed;
-            std::string link_target;
-
-            CURLcode result = CURLE_RECV_ERROR;
-            curl_easy_setopt(dlhandle, CURLOPT_WRITEFUNCTION, Util::CurlWriteMemoryCallback);
-            curl_easy_setopt(dlhandle, CURLOPT_WRITEDATA, &symlink_compressed);
-            curl_easy_setopt(dlhandle, CURLOPT_RANGE, dlrange.c_str());
-
-            vDownloadInfo[tid].setFilename(path.string());
-
-            if (conf.iWait > 0)
-                usleep(conf.iWait); // Delay the request by specified time
-
-            xferinfo.offset = 0;
-            xferinfo.timer.reset();
-            xferinfo.TimeAndSize.clear();
-
-            result = curl_easy_perform(dlhandle);
-
-            if (result != CURLE_OK)
+            // Continue
+            resume_from = filesize;
+        }
+        else
+        {
+            // Delete old file
+            msgQueue.push(Message(path_tmp.string() + ": Deleting old file.", MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+            if (!boost::filesystem::remove(path_tmp))
             {
-                symlink_compressed.str(std::string());
-                msgQueue.push(Message(path.string() + ": Failed to download", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                continue;
+                msgQueue.push(Message(path_tmp.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+                return false;
             }
+        }
+    }
 
-            int res = ZipUtil::extractStream(&symlink_compressed, &symlink_uncompressed);
-            symlink_compressed.str(std::string());
+    return true;
+}
 
-            if (res != 0)
-            {
-                std::string msg = "Extraction failed (";
-                switch (res)
-                {
-                    case 1:
-                        msg += "invalid input stream";
-                        break;
-                    case 2:
-                        msg += "unsupported compression method";
-                        break;
-                    case 3:
-                        msg += "invalid output stream";
-                        break;
-                    case 4:
-                        msg += "zlib error";
-                        break;
-                    default:
-                        msg += "unknown error";
-                        break;
-                }
-                msg += ")";
+// Finish completely downloaded MojoSetup entry
+// Returns false on failure
+static bool mojoSetupFinalizeEntry(mojoSetupSpanEntry& entry, const std::string& msg_prefix)
+{
+    const zipFileEntry& zfe = entry.zfe;
+    boost::filesystem::path path = zfe.filepath;
+    boost::filesystem::path path_tmp = zfe.filepath + ".lgogdltmp";
+
+    if (!entry.bUseTempFile)
+    {
+        std::string msg;
+        if (!entry.extractor)
+            msg = "Extraction failed (no data)";
+        else if (entry.iExtractResult != 0)
+            msg = mojoSetupExtractError(entry.iExtractResult);
+        else if (!entry.extractor->isFinished() || entry.extractor->getUncompressedSize() != static_cast<uint64_t>(zfe.uncomp_size))
+            msg = "Extraction failed (truncated data)";
+        else if (entry.extractor->getCRC32() != zfe.crc32)
+            msg = "CRC32 mismatch";
+        entry.extractor.reset();
 
+        if (ZipUtil::isSymlink(zfe.file_attributes))
+        {
+            if (!msg.empty())
+            {
                 msgQueue.push(Message(msg + " " + path.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                symlink_uncompressed.str(std::string());
-                continue;
+                return false;
             }
 
-            link_target = symlink_uncompressed.str();
-            symlink_uncompressed.str(std::string());
-
+            std::string link_target = entry.link_target->str();
+            entry.link_target.reset();
             if (!link_target.empty())
             {
                 if (!boost::filesystem::exists(path))
@@ -6175,233 +6879,313 @@ void Downloader::processGalaxyDownloadQueue_MojoSetupHack(Config conf, const uns
                     boost::filesystem::create_symlink(link_target, path);
                 }
             }
+
+            return true;
         }
-        else
+
+        if (entry.ofs)
         {
-            // Download file
-            CURLcode result = CURLE_RECV_ERROR;
+            entry.ofs->close();
+            entry.ofs.reset();
+        }
 
-            off_t max_size_memory = 5 << 20; // 5MiB
-            if (zfe.comp_size < max_size_memory) // Handle small files in memory
+        if (!msg.empty())
+        {
+            msgQueue.push(Message(msg + " " + path.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+            if (boost::filesystem::exists(path) && boost::filesystem::is_regular_file(path))
             {
-                std::ofstream ofs(path.string(), std::ofstream::out | std::ofstream::binary);
-                if (!ofs)
+                if (!boost::filesystem::remove(path))
                 {
-                    msgQueue.push(Message("Failed to create " + path_tmp.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                    continue;
+                    msgQueue.push(Message(path.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
                 }
+            }
+            return false;
+        }
 
-                std::stringstream data_compressed;
-                vDownloadInfo[tid].setFilename(path.string());
-                curl_easy_setopt(dlhandle, CURLOPT_WRITEFUNCTION, Util::CurlWriteMemoryCallback);
-                curl_easy_setopt(dlhandle, CURLOPT_WRITEDATA, &data_compressed);
-                curl_easy_setopt(dlhandle, CURLOPT_RANGE, dlrange.c_str());
-
-                xferinfo.offset = 0;
-                xferinfo.timer.reset();
-                xferinfo.TimeAndSize.clear();
-
-                result = curl_easy_perform(dlhandle);
+        if (boost::filesystem::exists(path))
+        {
+            // Set file permission
+            boost::filesystem::perms permissions = ZipUtil::getBoostFilePermission(zfe.file_attributes);
+            Util::setFilePermissions(path, permissions);
 
-                if (result != CURLE_OK)
+            // Set timestamp
+            if (zfe.timestamp > 0)
+            {
+                try
                 {
-                    data_compressed.str(std::string());
-                    ofs.close();
-                    msgQueue.push(Message(path.string() + ": Failed to download", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                    if (boost::filesystem::exists(path) && boost::filesystem::is_regular_file(path))
-                    {
-                        if (!boost::filesystem::remove(path))
-                        {
-                            msgQueue.push(Message(path.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                        }
-                    }
-                    continue;
+                    boost::filesystem::last_write_time(path, zfe.timestamp);
+                }
+                catch(const boost::filesystem::filesystem_error& e)
+                {
+                    msgQueue.push(Message(e.what(), MSGTYPE_WARNING, msg_prefix, MSGLEVEL_VERBOSE));
                 }
+            }
+        }
 
-                int res = ZipUtil::extractStream(&data_compressed, &ofs);
-                data_compressed.str(std::string());
-                ofs.close();
+        return true;
+    }
 
-                if (res != 0)
-                {
-                    std::string msg = "Extraction failed (";
-                    switch (res)
-                    {
-                        case 1:
-                            msg += "invalid input stream";
-                            break;
-                        case 2:
-                            msg += "unsupported compression method";
-                            break;
-                        case 3:
-                            msg += "invalid output stream";
-                            break;
-                        case 4:
-                            msg += "zlib error";
-                            break;
-                        default:
-                            msg += "unknown error";
-                            break;
-                    }
-                    msg += ")";
+    // Extract file
+    int res = ZipUtil::extractFile(path_tmp.string(), path.string());
+    if (res != 0)
+    {
+        bool bFailed = true;
+        std::string msg = "Extraction failed (";
+        unsigned int msg_type = MSGTYPE_ERROR;
+        switch (res)
+        {
+            case 1:
+                msg += "failed to open input file";
+                break;
+            case 2:
+                msg += "unsupported compression method";
+                break;
+            case 3:
+                msg += "failed to create output file";
+                break;
+            case 4:
+                msg += "zlib error";
+                break;
+            case 5:
+                msg += "failed to set timestamp";
+                msg_type = MSGTYPE_WARNING;
+                bFailed = false;
+                break;
+            default:
+                msg += "unknown error";
+                break;
+        }
+        msg += ")";
 
-                    msgQueue.push(Message(msg + " " + path.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                    data_compressed.str(std::string());
-                    if (boost::filesystem::exists(path) && boost::filesystem::is_regular_file(path))
-                    {
-                        if (!boost::filesystem::remove(path))
-                        {
-                            msgQueue.push(Message(path.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                        }
-                    }
-                    continue;
-                }
+        msgQueue.push(Message(msg + " " + path_tmp.string(), msg_type, msg_prefix, MSGLEVEL_ALWAYS));
 
-                if (boost::filesystem::exists(path))
-                {
-                    // Set file permission
-                    boost::filesystem::perms permissions = ZipUtil::getBoostFilePermission(zfe.file_attributes);
-                    Util::setFilePermissions(path, permissions);
+        if (bFailed)
+            return false;
+    }
+
+    if (boost::filesystem::exists(path_tmp) && boost::filesystem::is_regular_file(path_tmp))
+    {
+        if (!boost::filesystem::remove(path_tmp))
+        {
+            msgQueue.push(Message(path_tmp.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+        }
+    }
+
+    // Set file permission
+    boost::filesystem::perms permissions = ZipUtil::getBoostFilePermission(zfe.file_attributes);
+    if (boost::filesystem::exists(path))
+        Util::setFilePermissions(path, permissions);
+
+    return true;
+}
+
+// Read run of entries from local installer
+// Data is passed to entries in blocks so that progress can be shown
+static void mojoSetupReadLocalRun(const MojoSetupLocalInstaller& local_installer, mojoSetupSpanTransfer& transfer, const off_t& run_start, const off_t& run_end)
+{
+    std::vector<mojoSetupSpanEntry>& run = *transfer.entries;
+    while (transfer.current < run.size() && run[transfer.current].received >= run[transfer.current].size)
+        transfer.current++;
+    if (transfer.current >= run.size())
+        return;
 
-                    // Set timestamp
-                    if (zfe.timestamp > 0)
+    const mojoSetupSpanEntry& first = run[transfer.current];
+    off_t offset = first.zfe.start_offset_mojosetup + first.received;
+    off_t last = std::min(run_end, local_installer.size() - 1);
+    local_installer.adviseSequential(offset, last);
+    transfer.bRangeChecked = true;
+
+    DownloadInfo& dlinfo = vDownloadInfo[transfer.tid];
+    dlinfo.beginTransfer();
+    dlinfo.setStatus(DLSTATUS_RUNNING);
+
+    const off_t block_size = 1 << 20; // 1MiB
+    while (offset <= last && transfer.current < run.size())
+    {
+        size_t len = std::min(block_size, last - offset + 1);
+        transfer.position = offset;
+        if (mojoSetupWriteSpanData(const_cast<char*>(local_installer.data() + offset), 1, len, &transfer) != len)
+            return;
+        offset += len;
+        dlinfo.setProgress(offset - run_start, run_end - run_start + 1);
+    }
+}
+
+void Downloader::processGalaxyDownloadQueue_MojoSetupHack(ConfigSnapshot conf, const unsigned int& tid)
+{
+    std::string msg_prefix = "[Thread #" + std::to_string(tid) + "]";
+    Globals::tracer.setThreadName("mojosetup download #" + std::to_string(tid));
+
+    CURL* dlhandle = curl_easy_init();
+    Util::CurlHandleSetDefaultOptions(dlhandle, conf->curlConf);
+    curl_easy_setopt(dlhandle, CURLOPT_NOPROGRESS, 0);
+    curl_easy_setopt(dlhandle, CURLOPT_WRITEFUNCTION, mojoSetupWriteSpanData);
+    curl_easy_setopt(dlhandle, CURLOPT_FILETIME, 1L);
+
+    xferInfo xferinfo;
+    xferinfo.tid = tid;
+
+    curl_easy_setopt(dlhandle, CURLOPT_XFERINFOFUNCTION, Downloader::progressCallbackForThread);
+    curl_easy_setopt(dlhandle, CURLOPT_XFERINFODATA, &xferinfo);
+
+    mojoSetupSpan span;
+    while (dlQueueGalaxy_MojoSetupHack.try_pop(span))
+    {
+        vDownloadInfo[tid].setStatus(DLSTATUS_STARTING);
+        iTotalRemainingBytes.fetch_sub(span.comp_size);
+
+        MojoSetupLocalInstaller local_installer;
+        if (!span.installer_path.empty() && !local_installer.open(span.installer_path))
+            msgQueue.push(Message("Failed to open local installer " + span.installer_path + ". Using remote installer.", MSGTYPE_WARNING, msg_prefix, MSGLEVEL_ALWAYS));
+
+        // Group entries that need downloading to runs that are fetched with single range request
+        // Resumed entry starts new run because request must continue from end of its temporary file
+        std::vector<std::vector<mojoSetupSpanEntry>> vRuns;
+        for (auto& zfe : span.entries)
+        {
+            boost::filesystem::path path = zfe.filepath;
+
+            // Check that directory exists and create it
+            boost::filesystem::path directory = path.parent_path();
+            int iDirResult = dirCache.create(directory.string());
+            if (iDirResult != 0)
+            {
+                if (iDirResult == ENOTDIR)
+                    msgQueue.push(Message(directory.string() + " is not directory", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+                else
+                    msgQueue.push(Message("Failed to create directory: " + directory.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+                vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
+                curl_easy_cleanup(dlhandle);
+                return;
+            }
+
+            vDownloadInfo[tid].setFilename(path.string());
+
+            off_t resume_from = 0;
+            if (!mojoSetupEntryNeedsDownload(zfe, resume_from, msg_prefix))
+                continue;
+
+            mojoSetupSpanEntry entry;
+            entry.zfe = zfe;
+            entry.size = zfe.end_offset - zfe.start_offset_mojosetup + 1;
+            // Temporary file is used to continue partial download of earlier run and for large remote entries
+            // which would have to be downloaded again from start if transfer fails after all retries
+            // Other entries are extracted directly to their final path while downloading
+            entry.bUseTempFile = !ZipUtil::isSymlink(zfe.file_attributes) && (resume_from > 0 || (!local_installer.isOpen() && entry.size >= MOJOSETUP_TEMPFILE_MIN_SIZE));
+            if (entry.bUseTempFile)
+                entry.received = resume_from;
+
+            bool bNewRun = vRuns.empty() || entry.received > 0;
+            if (!bNewRun && zfe.start_offset_mojosetup - vRuns.back().back().zfe.end_offset - 1 > MOJOSETUP_MAX_SPAN_GAP)
+                bNewRun = true;
+
+            if (bNewRun)
+                vRuns.push_back(std::vector<mojoSetupSpanEntry>());
+            vRuns.back().push_back(entry);
+        }
+
+        for (auto& run : vRuns)
+        {
+            off_t run_start = run.front().zfe.start_offset_mojosetup;
+            off_t run_end = run.back().zfe.end_offset;
+            TraceSpan trace_span(local_installer.isOpen() ? "extract span" : "download span", (local_installer.isOpen() ? span.installer_path : span.installer_url) + " " + std::to_string(run_start) + "-" + std::to_string(run_end));
+
+            mojoSetupSpanTransfer transfer;
+            transfer.curlhandle = dlhandle;
+            transfer.tid = tid;
+            transfer.entries = &run;
+            if (local_installer.isOpen())
+            {
+                mojoSetupReadLocalRun(local_installer, transfer, run_start, run_end);
+                for (auto& entry : run)
+                {
+                    if (entry.tmpfile)
                     {
-                        try
-                        {
-                            boost::filesystem::last_write_time(path, zfe.timestamp);
-                        }
-                        catch(const boost::filesystem::filesystem_error& e)
-                        {
-                            msgQueue.push(Message(e.what(), MSGTYPE_WARNING, msg_prefix, MSGLEVEL_VERBOSE));
-                        }
+                        fclose(entry.tmpfile);
+                        entry.tmpfile = NULL;
                     }
                 }
             }
-            else // Use temporary file for bigger files
+            else
             {
-                vDownloadInfo[tid].setFilename(path_tmp.string());
-                curl_easy_setopt(dlhandle, CURLOPT_WRITEFUNCTION, Downloader::writeData);
-                curl_easy_setopt(dlhandle, CURLOPT_READFUNCTION, Downloader::readData);
+                curl_easy_setopt(dlhandle, CURLOPT_URL, span.installer_url.c_str());
+                curl_easy_setopt(dlhandle, CURLOPT_WRITEDATA, &transfer);
 
+                CURLcode result = CURLE_RECV_ERROR;
                 int iRetryCount = 0;
                 do
                 {
+                    // Continue from first incomplete entry
+                    while (transfer.current < run.size() && run[transfer.current].received >= run[transfer.current].size)
+                        transfer.current++;
+                    if (transfer.current >= run.size())
+                    {
+                        result = CURLE_OK;
+                        break;
+                    }
+
+                    mojoSetupSpanEntry& first = run[transfer.current];
                     if (iRetryCount != 0)
-                        msgQueue.push(Message("Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf.iRetries) + ": " + path_tmp.filename().string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
+                        msgQueue.push(Message("Retry " + std::to_string(iRetryCount) + "/" + std::to_string(conf->iRetries) + ": " + boost::filesystem::path(first.zfe.filepath).filename().string(), MSGTYPE_INFO, msg_prefix, MSGLEVEL_VERBOSE));
 
+                    transfer.position = first.zfe.start_offset_mojosetup + first.received;
+                    transfer.bRangeChecked = false;
+                    std::string dlrange = std::to_string(transfer.position) + "-" + std::to_string(run_end);
+                    curl_easy_setopt(dlhandle, CURLOPT_RANGE, dlrange.c_str());
 
-                    FILE* outfile;
-                    // File exists, resume
-                    if (resume_from > 0)
-                    {
-                        if ((outfile=fopen(path_tmp.string().c_str(), "r+"))!=NULL)
-                        {
-                            fseek(outfile, 0, SEEK_END);
-                            dlrange = std::to_string(zfe.start_offset_mojosetup + resume_from) + "-" + std::to_string(zfe.end_offset);
-                            curl_easy_setopt(dlhandle, CURLOPT_WRITEDATA, outfile);
-                            curl_easy_setopt(dlhandle, CURLOPT_RANGE, dlrange.c_str());
-                        }
-                        else
-                        {
-                            msgQueue.push(Message("Failed to open " + path_tmp.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                            break;
-                        }
-                    }
-                    else // File doesn't exist, create new file
+                    if (conf->iWait > 0)
+                        usleep(conf->iWait); // Delay the request by specified time
+
+                    xferinfo.offset = transfer.position - run_start;
+                    vDownloadInfo[xferinfo.tid].beginTransfer();
+                    result = curl_easy_perform(dlhandle);
+                    Globals::metrics.transfer(dlhandle, "mojosetup", result);
+                    EventLog::addTransfer(dlhandle);
+
+                    // Temporary file of interrupted entry is reopened when transfer continues
+                    for (auto& entry : run)
                     {
-                        if ((outfile=fopen(path_tmp.string().c_str(), "w"))!=NULL)
+                        if (entry.tmpfile)
                         {
-                            curl_easy_setopt(dlhandle, CURLOPT_WRITEDATA, outfile);
-                            curl_easy_setopt(dlhandle, CURLOPT_RANGE, dlrange.c_str());
-                        }
-                        else
-                        {
-                            msgQueue.push(Message("Failed to create " + path_tmp.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                            break;
+                            fclose(entry.tmpfile);
+                            entry.tmpfile = NULL;
                         }
                     }
 
-                    if (conf.iWait > 0)
-                        usleep(conf.iWait); // Delay the request by specified time
-
-                    xferinfo.offset = 0;
-                    xferinfo.timer.reset();
-                    xferinfo.TimeAndSize.clear();
-                    result = curl_easy_perform(dlhandle);
-                    fclose(outfile);
-
                     if (result == CURLE_PARTIAL_FILE || result == CURLE_OPERATION_TIMEDOUT || result == CURLE_RECV_ERROR)
                     {
                         iRetryCount++;
-                        if (boost::filesystem::exists(path_tmp) && boost::filesystem::is_regular_file(path_tmp))
-                            resume_from = static_cast<off_t>(boost::filesystem::file_size(path_tmp));
+                        Globals::metrics.retry("mojosetup", result, 0);
+                        EventLog::addRetry();
                     }
 
-                } while ((result == CURLE_PARTIAL_FILE || result == CURLE_OPERATION_TIMEDOUT || result == CURLE_RECV_ERROR) && (iRetryCount <= conf.iRetries));
-
-                if (result == CURLE_OK)
-                {
-                    // Extract file
-                    int res = ZipUtil::extractFile(path_tmp.string(), path.string());
-                    bool bFailed = false;
-                    if (res != 0)
-                    {
-                        bFailed = true;
-                        std::string msg = "Extraction failed (";
-                        unsigned int msg_type = MSGTYPE_ERROR;
-                        switch (res)
-                        {
-                            case 1:
-                                msg += "failed to open input file";
-                                break;
-                            case 2:
-                                msg += "unsupported compression method";
-                                break;
-                            case 3:
-                                msg += "failed to create output file";
-                                break;
-                            case 4:
-                                msg += "zlib error";
-                                break;
-                            case 5:
-                                msg += "failed to set timestamp";
-                                msg_type = MSGTYPE_WARNING;
-                                bFailed = false;
-                                break;
-                            default:
-                                msg += "unknown error";
-                                break;
-                        }
-                        msg += ")";
+                } while ((result == CURLE_PARTIAL_FILE || result == CURLE_OPERATION_TIMEDOUT || result == CURLE_RECV_ERROR) && (iRetryCount <= conf->iRetries));
 
-                        msgQueue.push(Message(msg + " " + path_tmp.string(), msg_type, msg_prefix, MSGLEVEL_ALWAYS));
-                    }
+                if (transfer.bRangeIgnored)
+                    msgQueue.push(Message("Server ignored range request: " + span.installer_url, MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
+            }
 
-                    if (bFailed)
-                        continue;
+            for (auto& entry : run)
+            {
+                if (entry.received < entry.size)
+                {
+                    msgQueue.push(Message("Download failed " + entry.zfe.filepath + (entry.bUseTempFile ? ".lgogdltmp" : ""), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
 
-                    if (boost::filesystem::exists(path_tmp) && boost::filesystem::is_regular_file(path_tmp))
+                    // Delete partially extracted file
+                    if (entry.ofs)
                     {
-                        if (!boost::filesystem::remove(path_tmp))
-                        {
-                            msgQueue.push(Message(path_tmp.string() + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
-                        }
+                        entry.ofs->close();
+                        entry.ofs.reset();
+                        if (boost::filesystem::exists(entry.zfe.filepath) && !boost::filesystem::remove(entry.zfe.filepath))
+                            msgQueue.push(Message(entry.zfe.filepath + ": Failed to delete", MSGTYPE_ERROR, msg_prefix, MSGLEVEL_ALWAYS));
                     }
-
-                    // Set file permission
-                    boost::filesystem::perms permissions = ZipUtil::getBoostFilePermission(zfe.file_attributes);
-                    if (boost::filesystem::exists(path))
-                        Util::setFilePermissions(path, permissions);
-                }
-                else
-                {
-                    msgQueue.push(Message("Download failed " + path_tmp.string(), MSGTYPE_ERROR, msg_prefix, MSGLEVEL_DEFAULT));
                     continue;
                 }
+
+                if (mojoSetupFinalizeEntry(entry, msg_prefix))
+                    msgQueue.push(Message("Download complete: " + entry.zfe.filepath, MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_DEFAULT));
             }
         }
-
-        msgQueue.push(Message("Download complete: " + path.string(), MSGTYPE_SUCCESS, msg_prefix, MSGLEVEL_DEFAULT));
     }
 
     vDownloadInfo[tid].setStatus(DLSTATUS_FINISHED);
@@ -6410,6 +7194,135 @@ void Downloader::processGalaxyDownloadQueue_MojoSetupHack(Config conf, const uns
     return;
 }
 
+// Index of MojoSetup installer entries parsed from Zip Central Directory
+// Index is keyed by installer MD5 so it stays valid as long as installer doesn't change
+// Format: header line { version, installer size, entry count }, then one line per entry
+// { start offset, end offset, start offset in zip, compressed size, uncompressed size, attributes, crc32, timestamp, filepath }
+static const std::string MOJOSETUP_INDEX_VERSION = "lgogdownloader-mojosetup-index-1";
+// Local installer that matched installer MD5 is recorded next to index so that it isn't hashed again until it changes
+// Format: { version, size, modification time, filepath }
+static const std::string MOJOSETUP_LOCAL_VERSION = "lgogdownloader-mojosetup-local-1";
+
+// Path of file in MojoSetup cache directory, extension is ".idx" for index and ".local" for local installer verification
+static std::string mojoSetupCachePath(const std::string& installer_md5, const std::string& extension)
+{
+    if (installer_md5.empty())
+        return std::string();
+
+    return Globals::globalConfig.sCacheDirectory + "/mojosetup/" + installer_md5 + extension;
+}
+
+static bool mojoSetupLoadIndex(const std::string& filepath, const off_t& installer_size, const std::string& installer_url, std::vector<zipFileEntry>& vFiles)
+{
+    std::ifstream ifs(filepath, std::ifstream::in | std::ifstream::binary);
+    if (!ifs)
+        return false;
+
+    std::string version;
+    off_t size = 0;
+    uintmax_t count = 0;
+    if (!(ifs >> version >> size >> count) || version != MOJOSETUP_INDEX_VERSION || size != installer_size || count == 0)
+        return false;
+    ifs.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    std::vector<zipFileEntry> vIndexFiles;
+    vIndexFiles.reserve(count);
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        zipFileEntry zfe;
+        unsigned int attributes = 0;
+        long long timestamp = 0;
+        std::istringstream iss(line);
+        iss >> zfe.start_offset_mojosetup >> zfe.end_offset >> zfe.start_offset_zip >> zfe.comp_size >> zfe.uncomp_size >> attributes >> zfe.crc32 >> timestamp;
+        if (!iss || iss.get() != ' ' || !std::getline(iss, zfe.filepath) || zfe.filepath.empty())
+            return false;
+
+        zfe.file_attributes = attributes;
+        zfe.timestamp = timestamp;
+        zfe.installer_url = installer_url;
+        vIndexFiles.push_back(zfe);
+    }
+
+    if (vIndexFiles.size() != count)
+        return false;
+
+    vFiles = std::move(vIndexFiles);
+    return true;
+}
+
+static bool mojoSetupSaveIndex(const std::string& filepath, const off_t& installer_size, const std::vector<zipFileEntry>& vFiles)
+{
+    boost::filesystem::path path = filepath;
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(path.parent_path(), ec);
+    if (ec)
+        return false;
+
+    // Write to temporary file and rename so that index is never partially written
+    std::string filepath_tmp = filepath + ".tmp";
+    std::ofstream ofs(filepath_tmp, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!ofs)
+        return false;
+
+    ofs << MOJOSETUP_INDEX_VERSION << " " << installer_size << " " << vFiles.size() << "\n";
+    for (const auto& zfe : vFiles)
+    {
+        // Filepath is stored until end of line
+        if (zfe.filepath.find_first_of("\r\n") != std::string::npos)
+        {
+            ofs.close();
+            boost::filesystem::remove(filepath_tmp, ec);
+            return false;
+        }
+
+        ofs << zfe.start_offset_mojosetup << " " << zfe.end_offset << " "
+            << zfe.start_offset_zip << " " << zfe.comp_size << " " << zfe.uncomp_size << " "
+            << zfe.file_attributes << " " << zfe.crc32 << " " << static_cast<long long>(zfe.timestamp) << " "
+            << zfe.filepath << "\n";
+    }
+    ofs.close();
+
+    if (!ofs)
+    {
+        boost::filesystem::remove(filepath_tmp, ec);
+        return false;
+    }
+
+    boost::filesystem::rename(filepath_tmp, filepath, ec);
+    return !ec;
+}
+
+// Check that local installer has same size and modification time as when its MD5 was last verified
+static bool mojoSetupIsLocalInstallerVerified(const std::string& filepath, const std::string& local_filepath, const uintmax_t& local_size, const std::time_t& local_mtime)
+{
+    std::ifstream ifs(filepath, std::ifstream::in | std::ifstream::binary);
+    if (!ifs)
+        return false;
+
+    std::string version;
+    uintmax_t size = 0;
+    long long mtime = 0;
+    std::string verified_filepath;
+    if (!(ifs >> version >> size >> mtime) || ifs.get() != ' ' || !std::getline(ifs, verified_filepath))
+        return false;
+
+    return version == MOJOSETUP_LOCAL_VERSION && size == local_size && mtime == static_cast<long long>(local_mtime) && verified_filepath == local_filepath;
+}
+
+static void mojoSetupSaveLocalInstallerVerified(const std::string& filepath, const std::string& local_filepath, const uintmax_t& local_size, const std::time_t& local_mtime)
+{
+    boost::filesystem::path path = filepath;
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(path.parent_path(), ec);
+    if (ec || local_filepath.find_first_of("\r\n") != std::string::npos)
+        return;
+
+    std::ofstream ofs(filepath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (ofs)
+        ofs << MOJOSETUP_LOCAL_VERSION << " " << local_size << " " << static_cast<long long>(local_mtime) << " " << local_filepath << "\n";
+}
+
 int Downloader::mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEntry>& vFiles)
 {
     Json::Value downlinkJson = gogGalaxy->getResponseJson(gf.galaxy_downlink_json_url);
@@ -6441,6 +7354,7 @@ int Downloader::mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEn
 
     // Get XML data
     curl_off_t file_size = 0;
+    std::string installer_md5;
     bool bMissingXML = false;
     bool bXMLParsingError = false;
     std::string xml_data = gogGalaxy->getResponse(xml_url);
@@ -6463,6 +7377,8 @@ int Downloader::mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEn
         }
         else
         {
+            if (fileElem->Attribute("md5"))
+                installer_md5 = fileElem->Attribute("md5");
             std::string total_size = fileElem->Attribute("total_size");
             try
             {
@@ -6504,21 +7420,61 @@ int Downloader::mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEn
         return 1;
     }
 
+    // Use installer downloaded to download directory if it is complete
+    std::string installer_path;
+    MojoSetupLocalInstaller local_installer;
+    std::string local_filepath = gf.getFilepath();
+    if (!local_filepath.empty() && !installer_md5.empty() && boost::filesystem::exists(local_filepath))
+    {
+        boost::system::error_code ec;
+        uintmax_t local_size = boost::filesystem::file_size(local_filepath, ec);
+        std::time_t local_mtime = ec ? 0 : boost::filesystem::last_write_time(local_filepath, ec);
+        if (!ec && local_size == static_cast<uintmax_t>(file_size))
+        {
+            // Hash local installer only if it has changed since last verification
+            std::string verified_filepath = mojoSetupCachePath(installer_md5, ".local");
+            bool bVerified = mojoSetupIsLocalInstallerVerified(verified_filepath, local_filepath, local_size, local_mtime);
+            if (!bVerified)
+            {
+                std::cout << "Verifying local installer " << local_filepath << std::endl;
+                bVerified = (Util::getFileHash(local_filepath, RHASH_MD5) == installer_md5);
+                if (bVerified)
+                    mojoSetupSaveLocalInstallerVerified(verified_filepath, local_filepath, local_size, local_mtime);
+            }
+
+            if (bVerified)
+            {
+                if (local_installer.open(local_filepath))
+                    installer_path = local_filepath;
+                else
+                    std::cerr << "Failed to open local installer " << local_filepath << std::endl;
+            }
+            else
+            {
+                std::cout << "Local installer doesn't match, using remote installer" << std::endl;
+            }
+        }
+    }
+
+    // Use index of earlier run instead of fetching Central Directory
+    std::string index_filepath = mojoSetupCachePath(installer_md5, ".idx");
+    if (!index_filepath.empty() && mojoSetupLoadIndex(index_filepath, file_size, installer_url, vFiles))
+    {
+        if (Globals::globalConfig.iMsgLevel >= MSGLEVEL_VERBOSE)
+            std::cout << "Using cached file list of " << gf.path << std::endl;
+        for (auto& zfe : vFiles)
+            zfe.installer_path = installer_path;
+        return 0;
+    }
+
     off_t head_size = 100 << 10; // 100 KiB
     off_t tail_size = 200 << 10; // 200 KiB
-    std::string head_range = "0-" + std::to_string(head_size);
-    std::string tail_range = std::to_string(file_size - tail_size) + "-" + std::to_string(file_size);
 
     CURLcode result;
 
     // Get head
     std::stringstream head;
-    curl_easy_setopt(curlhandle, CURLOPT_URL, installer_url.c_str());
-    curl_easy_setopt(curlhandle, CURLOPT_NOPROGRESS, 1);
-    curl_easy_setopt(curlhandle, CURLOPT_WRITEFUNCTION, Util::CurlWriteMemoryCallback);
-    curl_easy_setopt(curlhandle, CURLOPT_WRITEDATA, &head);
-    curl_easy_setopt(curlhandle, CURLOPT_RANGE, head_range.c_str());
-    result = curl_easy_perform(curlhandle);
+    result = mojoSetupGetRange(curlhandle, installer_url, local_installer, 0, head_size, head);
 
     if (result != CURLE_OK)
     {
@@ -6545,11 +7501,7 @@ int Downloader::mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEn
 
     // Get tail
     std::stringstream tail;
-    curl_easy_setopt(curlhandle, CURLOPT_NOPROGRESS, 1);
-    curl_easy_setopt(curlhandle, CURLOPT_WRITEFUNCTION, Util::CurlWriteMemoryCallback);
-    curl_easy_setopt(curlhandle, CURLOPT_WRITEDATA, &tail);
-    curl_easy_setopt(curlhandle, CURLOPT_RANGE, tail_range.c_str());
-    result = curl_easy_perform(curlhandle);
+    result = mojoSetupGetRange(curlhandle, installer_url, local_installer, file_size - tail_size, file_size, tail);
 
     if (result != CURLE_OK)
     {
@@ -6588,12 +7540,7 @@ int Downloader::mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEn
     if (cd_offset_from_file_end > tail_size)
     {
         tail.str(std::string());
-        tail_range = std::to_string(mojosetup_cd_offset) + "-" + std::to_string(file_size);
-        curl_easy_setopt(curlhandle, CURLOPT_NOPROGRESS, 1);
-        curl_easy_setopt(curlhandle, CURLOPT_WRITEFUNCTION, Util::CurlWriteMemoryCallback);
-        curl_easy_setopt(curlhandle, CURLOPT_WRITEDATA, &tail);
-        curl_easy_setopt(curlhandle, CURLOPT_RANGE, tail_range.c_str());
-        result = curl_easy_perform(curlhandle);
+        result = mojoSetupGetRange(curlhandle, installer_url, local_installer, mojosetup_cd_offset, file_size, tail);
 
         if (result != CURLE_OK)
         {
@@ -6632,6 +7579,7 @@ int Downloader::mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEn
         zfe.crc32 = cd.crc32;
         zfe.timestamp = cd.timestamp;
         zfe.installer_url = installer_url;
+        zfe.installer_path = installer_path;
 
         vFiles.push_back(zfe);
     }
@@ -6644,6 +7592,9 @@ int Downloader::mojoSetupGetFileVector(const gameFile& gf, std::vector<zipFileEn
         vFiles[i].end_offset = vFiles[i+1].start_offset_mojosetup - 1;
     }
 
+    if (!index_filepath.empty() && !mojoSetupSaveIndex(index_filepath, file_size, vFiles))
+        std::cerr << "Failed to save file list to " << index_filepath << std::endl;
+
     return 0;
 }
 
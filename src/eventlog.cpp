@@ -0,0 +1,142 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "eventlog.h"
+#include "globals.h"
+
+#include <ctime>
+#include <json/json.h>
+
+static thread_local ScopedFileEvent* currentEvent = nullptr;
+
+static double secondsSince(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+ScopedFileEvent::ScopedFileEvent(const std::string& queue, const std::string& file)
+{
+    if (!Globals::eventLog.isOpen())
+        return;
+
+    event.queue = queue;
+    event.file = file;
+    start_ = std::chrono::steady_clock::now();
+    active_ = true;
+    previous_ = currentEvent;
+    currentEvent = this;
+}
+
+ScopedFileEvent::~ScopedFileEvent()
+{
+    if (!active_)
+        return;
+
+    currentEvent = previous_;
+    event.total = secondsSince(start_);
+    Globals::eventLog.write(event);
+}
+
+void ScopedFileEvent::metadataDone()
+{
+    if (active_)
+        event.metadata = secondsSince(start_);
+}
+
+bool EventLog::open(const std::string& filepath)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    ofs_.open(filepath, std::ofstream::out | std::ofstream::app);
+    bOpen_ = ofs_.is_open();
+    return bOpen_;
+}
+
+void EventLog::close()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    bOpen_ = false;
+    if (ofs_.is_open())
+        ofs_.close();
+}
+
+void EventLog::write(const fileEvent& event)
+{
+    Json::Value json;
+    json["time"] = static_cast<Json::Int64>(std::time(NULL));
+    json["queue"] = event.queue;
+    json["file"] = event.file;
+    json["host"] = event.host;
+    json["status"] = event.status;
+    json["bytes"] = static_cast<Json::UInt64>(event.bytes);
+    json["resume_offset"] = static_cast<Json::UInt64>(event.resume_offset);
+    json["transfers"] = event.transfers;
+    json["retries"] = event.retries;
+    json["metadata"] = event.metadata;
+    json["connect"] = event.connect;
+    json["ttfb"] = event.ttfb;
+    json["transfer"] = event.transfer;
+    json["hash"] = event.hash;
+    json["write"] = event.write;
+    json["total"] = event.total;
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    builder["precision"] = 6;
+    std::string line = Json::writeString(builder, json);
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (bOpen_)
+        ofs_ << line << std::endl;
+}
+
+bool EventLog::hasCurrent()
+{
+    return currentEvent != nullptr;
+}
+
+void EventLog::addTransfer(CURL* curlhandle)
+{
+    if (!currentEvent)
+        return;
+
+    fileEvent& event = currentEvent->event;
+    curl_off_t downloaded = 0, uploaded = 0;
+    double connect = 0, starttransfer = 0, total = 0;
+    char* url = NULL;
+    curl_easy_getinfo(curlhandle, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    curl_easy_getinfo(curlhandle, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+    curl_easy_getinfo(curlhandle, CURLINFO_CONNECT_TIME, &connect);
+    curl_easy_getinfo(curlhandle, CURLINFO_STARTTRANSFER_TIME, &starttransfer);
+    curl_easy_getinfo(curlhandle, CURLINFO_TOTAL_TIME, &total);
+    curl_easy_getinfo(curlhandle, CURLINFO_EFFECTIVE_URL, &url);
+
+    event.transfers++;
+    event.bytes += downloaded + uploaded;
+    event.connect += connect;
+    event.ttfb += starttransfer;
+    if (total > starttransfer)
+        event.transfer += total - starttransfer;
+    if (url)
+        event.host = Metrics::host(url);
+}
+
+void EventLog::addRetry()
+{
+    if (currentEvent)
+        currentEvent->event.retries++;
+}
+
+void EventLog::addHashTime(const double& seconds)
+{
+    if (currentEvent)
+        currentEvent->event.hash += seconds;
+}
+
+void EventLog::addWriteTime(const double& seconds)
+{
+    if (currentEvent)
+        currentEvent->event.write += seconds;
+}
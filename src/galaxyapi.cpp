@@ -7,11 +7,14 @@
 #include "galaxyapi.h"
 #include "message.h"
 #include "ziputil.h"
+#include "patternmatcher.h"
+#include "depotmanifestparser.h"
 
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
+#include <chrono>
 #include <sstream>
 
 GalaxyConfig Globals::galaxyConf;
@@ -23,7 +26,7 @@ size_t galaxyAPI::writeMemoryCallback(char *ptr, size_t size, size_t nmemb, void
     return count;
 }
 
-galaxyAPI::galaxyAPI(CurlConfig& conf)
+galaxyAPI::galaxyAPI(const CurlConfig& conf)
 {
     this->curlConf = conf;
 
@@ -93,6 +96,7 @@ bool galaxyAPI::isTokenExpired()
 
 std::string galaxyAPI::getResponse(const std::string& url, const char *encoding)
 {
+    TraceSpan span("galaxyAPI request", url);
     struct curl_slist *header = NULL;
 
     std::string access_token;
@@ -115,7 +119,9 @@ std::string galaxyAPI::getResponse(const std::string& url, const char *encoding)
 
     int max_retries = std::min(3, Globals::globalConfig.iRetries);
     std::string response;
+    auto start = std::chrono::steady_clock::now();
     auto res = Util::CurlHandleGetResponse(curlhandle, response, max_retries);
+    Globals::metrics.apiRequest("galaxy", url, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), res);
 
     if(res) {
         long int response_code = 0;
@@ -220,6 +226,47 @@ Json::Value galaxyAPI::getManifestV2(std::string manifest_hash, const bool& is_d
     return this->getResponseJson(url);
 }
 
+// Get depot manifest as JSON text without parsing it
+std::string galaxyAPI::getManifestV2Data(std::string manifest_hash, const bool& is_dependency)
+{
+    if (!manifest_hash.empty() && manifest_hash.find("/") == std::string::npos)
+        manifest_hash = this->hashToGalaxyPath(manifest_hash);
+
+    std::string url;
+    if (is_dependency)
+        url = "https://cdn.gog.com/content-system/v2/dependencies/meta/" + manifest_hash;
+    else
+        url = "https://cdn.gog.com/content-system/v2/meta/" + manifest_hash;
+
+    std::string response = this->getResponse(url);
+
+    // Check for zlib header and decompress if header found
+    if (response.size() >= 2)
+    {
+        uint16_t header = static_cast<unsigned char>(response[0]) | (static_cast<unsigned char>(response[1]) << 8);
+        std::vector<uint16_t> zlib_headers = { 0x0178, 0x5e78, 0x9c78, 0xda78 };
+        if (std::find(zlib_headers.begin(), zlib_headers.end(), header) != zlib_headers.end())
+        {
+            std::string response_decompressed;
+            try
+            {
+                boost::iostreams::filtering_streambuf<boost::iostreams::input> in;
+                in.push(boost::iostreams::zlib_decompressor(GlobalConstants::ZLIB_WINDOW_SIZE));
+                in.push(boost::make_iterator_range(response));
+                boost::iostreams::copy(in, boost::iostreams::back_inserter(response_decompressed));
+            }
+            catch (const boost::iostreams::zlib_error& e)
+            {
+                std::cout << "Failed to decompress manifest: " << e.what() << std::endl;
+                response_decompressed.clear();
+            }
+            response.swap(response_decompressed);
+        }
+    }
+
+    return response;
+}
+
 Json::Value galaxyAPI::getCloudPathAsJson(const std::string &clientId) {
     std::string url = "https://remote-config.gog.com/components/galaxy_client/clients/" + clientId + "?component_version=2.0.51";
 
@@ -252,101 +299,67 @@ std::string galaxyAPI::hashToGalaxyPath(const std::string& hash)
 
 std::vector<galaxyDepotItem> galaxyAPI::getDepotItemsVector(const std::string& hash, const bool& is_dependency)
 {
-    Json::Value json = this->getManifestV2(hash, is_dependency);
+    std::string manifest = this->getManifestV2Data(hash, is_dependency);
 
     std::vector<galaxyDepotItem> items;
-    if (json["depot"].isMember("smallFilesContainer"))
-    {
-        if (json["depot"]["smallFilesContainer"]["chunks"].isArray())
-        {
-            galaxyDepotItem item;
-            item.totalSizeCompressed = 0;
-            item.totalSizeUncompressed = 0;
-            item.path = "galaxy_smallfilescontainer";
-            item.isDependency = is_dependency;
-            item.isSmallFilesContainer = true;
+    if (manifest.empty())
+        return items;
 
-            for (unsigned int i = 0; i < json["depot"]["smallFilesContainer"]["chunks"].size(); ++i)
-            {
-                Json::Value json_chunk = json["depot"]["smallFilesContainer"]["chunks"][i];
-
-                galaxyDepotItemChunk chunk;
-                chunk.md5_compressed = json_chunk["compressedMd5"].asString();
-                chunk.md5_uncompressed = json_chunk["md5"].asString();
-                chunk.size_compressed = json_chunk["compressedSize"].asLargestUInt();
-                chunk.size_uncompressed = json_chunk["size"].asLargestUInt();
+    std::string error;
+    items = galaxyAPI::getDepotItemsVectorFromManifest(manifest, is_dependency, error);
+    if (!error.empty())
+        std::cout << "Failed to parse depot manifest " << hash << ": " << error << std::endl;
 
-                chunk.offset_compressed = item.totalSizeCompressed;
-                chunk.offset_uncompressed = item.totalSizeUncompressed;
+    return items;
+}
 
-                item.totalSizeCompressed += chunk.size_compressed;
-                item.totalSizeUncompressed += chunk.size_uncompressed;
-                item.chunks.push_back(chunk);
-            }
+// Parse depot manifest data and prepare items for download
+// Returns empty vector and sets error if manifest can't be parsed
+std::vector<galaxyDepotItem> galaxyAPI::getDepotItemsVectorFromManifest(const std::string& manifest, const bool& is_dependency, std::string& error)
+{
+    std::vector<galaxyDepotItem> items;
 
-            if (json["depot"]["smallFilesContainer"].isMember("md5"))
-                item.md5 = json["depot"]["smallFilesContainer"]["md5"].asString();
-            else if (json["depot"]["smallFilesContainer"]["chunks"].size() == 1)
-                item.md5 = json["depot"]["smallFilesContainer"]["chunks"][0]["md5"].asString();
-            else
-                item.md5 = std::string();
+    bool bLowercasePath = Globals::globalConfig.dlConf.bGalaxyLowercasePath &&
+                          Globals::globalConfig.dlConf.iGalaxyPlatform == GlobalConstants::PLATFORM_WINDOWS;
 
-            items.push_back(item);
-        }
-    }
+    galaxyDepotItem sfc_item;
+    bool bHasSmallFilesContainer = false;
 
-    for (unsigned int i = 0; i < json["depot"]["items"].size(); ++i)
+    std::shared_ptr<GalaxyChunkTable> chunk_table = std::make_shared<GalaxyChunkTable>();
+    DepotManifestParser parser(manifest.data(), manifest.size(), chunk_table);
+    bool bParsed = parser.parse([&](galaxyDepotItem& item)
     {
-        if (json["depot"]["items"][i]["chunks"].isArray())
-        {
-            galaxyDepotItem item;
-            item.totalSizeCompressed = 0;
-            item.totalSizeUncompressed = 0;
-            item.path = json["depot"]["items"][i]["path"].asString();
-            item.isDependency = is_dependency;
-
-            if (json["depot"]["items"][i].isMember("sfcRef"))
-            {
-                item.isInSFC = true;
-                item.sfc_offset = json["depot"]["items"][i]["sfcRef"]["offset"].asLargestUInt();
-                item.sfc_size = json["depot"]["items"][i]["sfcRef"]["size"].asLargestUInt();
-            }
+        item.isDependency = is_dependency;
+        if (item.md5.empty() && item.chunks.size() == 1)
+            item.md5 = item.chunks.md5Uncompressed(0).hex();
 
-            if (Globals::globalConfig.dlConf.bGalaxyLowercasePath &&
-                Globals::globalConfig.dlConf.iGalaxyPlatform == GlobalConstants::PLATFORM_WINDOWS)
-            {
-                boost::algorithm::to_lower(item.path);
-            }
-
-            while (Util::replaceString(item.path, "\\", "/"));
-            for (unsigned int j = 0; j < json["depot"]["items"][i]["chunks"].size(); ++j)
-            {
-                Json::Value json_chunk = json["depot"]["items"][i]["chunks"][j];
+        if (item.isSmallFilesContainer)
+        {
+            item.path = "galaxy_smallfilescontainer";
+            sfc_item = std::move(item);
+            bHasSmallFilesContainer = true;
+            return;
+        }
 
-                galaxyDepotItemChunk chunk;
-                chunk.md5_compressed = json_chunk["compressedMd5"].asString();
-                chunk.md5_uncompressed = json_chunk["md5"].asString();
-                chunk.size_compressed = json_chunk["compressedSize"].asLargestUInt();
-                chunk.size_uncompressed = json_chunk["size"].asLargestUInt();
+        if (bLowercasePath)
+            boost::algorithm::to_lower(item.path);
 
-                chunk.offset_compressed = item.totalSizeCompressed;
-                chunk.offset_uncompressed = item.totalSizeUncompressed;
+        while (Util::replaceString(item.path, "\\", "/"));
+        items.push_back(std::move(item));
+    });
 
-                item.totalSizeCompressed += chunk.size_compressed;
-                item.totalSizeUncompressed += chunk.size_uncompressed;
-                item.chunks.push_back(chunk);
-            }
+    if (!bParsed)
+    {
+        error = parser.getError();
+        items.clear();
+        return items;
+    }
 
-            if (json["depot"]["items"][i].isMember("md5"))
-                item.md5 = json["depot"]["items"][i]["md5"].asString();
-            else if (json["depot"]["items"][i]["chunks"].size() == 1)
-                item.md5 = json["depot"]["items"][i]["chunks"][0]["md5"].asString();
-            else
-                item.md5 = std::string();
+    chunk_table->shrink_to_fit();
 
-            items.push_back(item);
-        }
-    }
+    // Small files container is always the first item
+    if (bHasSmallFilesContainer)
+        items.insert(items.begin(), std::move(sfc_item));
 
     return items;
 }
@@ -588,12 +601,11 @@ std::vector<galaxyDepotItem> galaxyAPI::getFilteredDepotItemsVectorFromJson(cons
 
     bool bSelectedLanguage = false;
     bool bSelectedArch = false;
-    boost::regex language_re("^(" + galaxy_language + ")$", boost::regex::perl | boost::regex::icase);
-    boost::match_results<std::string::const_iterator> what;
+    std::shared_ptr<const PatternMatcher> language_re = PatternMatcher::get("^(" + galaxy_language + ")$", PATTERN_ICASE);
     for (unsigned int j = 0; j < depot_json["languages"].size(); ++j)
     {
         std::string language = depot_json["languages"][j].asString();
-        if (language == "*" || boost::regex_search(language, what, language_re))
+        if (language == "*" || language_re->search(language))
             bSelectedLanguage = true;
     }
 
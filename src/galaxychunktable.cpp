@@ -0,0 +1,78 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "galaxychunktable.h"
+
+#include <limits>
+
+static int hexValue(const char& c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+std::string galaxyChunkDigest::hex() const
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string str(sizeof(bytes) * 2, '0');
+    for (size_t i = 0; i < sizeof(bytes); ++i)
+    {
+        str[i * 2] = digits[bytes[i] >> 4];
+        str[i * 2 + 1] = digits[bytes[i] & 0x0F];
+    }
+    return str;
+}
+
+bool galaxyChunkDigest::fromHex(const std::string& hex, galaxyChunkDigest& digest)
+{
+    if (hex.size() != sizeof(digest.bytes) * 2)
+        return false;
+
+    for (size_t i = 0; i < sizeof(digest.bytes); ++i)
+    {
+        int high = hexValue(hex[i * 2]);
+        int low = hexValue(hex[i * 2 + 1]);
+        if (high < 0 || low < 0)
+            return false;
+        digest.bytes[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+
+    return true;
+}
+
+bool GalaxyChunkTable::add(const std::string& md5_compressed, const std::string& md5_uncompressed, const uintmax_t& size_compressed, const uintmax_t& size_uncompressed, const uintmax_t& offset_compressed, const uintmax_t& offset_uncompressed)
+{
+    galaxyChunkDigest digest_compressed, digest_uncompressed;
+    if (!galaxyChunkDigest::fromHex(md5_compressed, digest_compressed) || !galaxyChunkDigest::fromHex(md5_uncompressed, digest_uncompressed))
+        return false;
+
+    if (size_compressed > std::numeric_limits<uint32_t>::max() || size_uncompressed > std::numeric_limits<uint32_t>::max())
+        return false;
+
+    md5_compressed_.push_back(digest_compressed);
+    md5_uncompressed_.push_back(digest_uncompressed);
+    size_compressed_.push_back(size_compressed);
+    size_uncompressed_.push_back(size_uncompressed);
+    offset_compressed_.push_back(offset_compressed);
+    offset_uncompressed_.push_back(offset_uncompressed);
+
+    return true;
+}
+
+void GalaxyChunkTable::shrink_to_fit()
+{
+    md5_compressed_.shrink_to_fit();
+    md5_uncompressed_.shrink_to_fit();
+    size_compressed_.shrink_to_fit();
+    size_uncompressed_.shrink_to_fit();
+    offset_compressed_.shrink_to_fit();
+    offset_uncompressed_.shrink_to_fit();
+}
@@ -0,0 +1,420 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "gamedetailscache.h"
+#include "globalconstants.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char CACHE_MAGIC[8] = {'L', 'G', 'O', 'G', 'G', 'D', 'C', '\0'};
+static const uint32_t CACHE_BYTE_ORDER_MARK = 0x01020304;
+static const size_t CACHE_HEADER_SIZE = 64;
+static const size_t CACHE_INDEX_ENTRY_SIZE = 16;
+static const unsigned int CACHE_MAX_DEPTH = 64;
+
+enum valueTag
+{
+    TAG_NULL = 0,
+    TAG_INT,
+    TAG_UINT,
+    TAG_REAL,
+    TAG_STRING,
+    TAG_FALSE,
+    TAG_TRUE,
+    TAG_ARRAY,
+    TAG_OBJECT
+};
+
+class stringTableBuilder
+{
+    public:
+        uint32_t add(const std::string& str)
+        {
+            auto it = ids_.find(str);
+            if (it != ids_.end())
+                return it->second;
+
+            uint32_t id = table_.size();
+            uint32_t length = str.size();
+            table_.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            table_.append(str);
+            ids_.insert(std::make_pair(str, id));
+            return id;
+        }
+
+        const std::string& table() const { return table_; }
+    private:
+        std::string table_;
+        std::unordered_map<std::string, uint32_t> ids_;
+};
+
+template <typename T> static void append(std::string& buffer, const T& value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Size and modification time of JSON cache that binary cache was written from
+static bool getSourceStat(const std::string& filepath, uint64_t& size, int64_t& mtime)
+{
+    struct stat st;
+    if (stat(filepath.c_str(), &st) != 0)
+        return false;
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+template <typename T> static bool read(const unsigned char*& pos, const unsigned char* end, T& value)
+{
+    if (static_cast<size_t>(end - pos) < sizeof(T))
+        return false;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+static void encodeValue(const Json::Value& value, std::string& buffer, stringTableBuilder& strings)
+{
+    switch (value.type())
+    {
+        case Json::intValue:
+            buffer.push_back(TAG_INT);
+            append<int64_t>(buffer, value.asInt64());
+            break;
+        case Json::uintValue:
+            buffer.push_back(TAG_UINT);
+            append<uint64_t>(buffer, value.asUInt64());
+            break;
+        case Json::realValue:
+            buffer.push_back(TAG_REAL);
+            append<double>(buffer, value.asDouble());
+            break;
+        case Json::stringValue:
+            buffer.push_back(TAG_STRING);
+            append<uint32_t>(buffer, strings.add(value.asString()));
+            break;
+        case Json::booleanValue:
+            buffer.push_back(value.asBool() ? TAG_TRUE : TAG_FALSE);
+            break;
+        case Json::arrayValue:
+            buffer.push_back(TAG_ARRAY);
+            append<uint32_t>(buffer, value.size());
+            for (Json::ArrayIndex i = 0; i < value.size(); ++i)
+                encodeValue(value[i], buffer, strings);
+            break;
+        case Json::objectValue:
+        {
+            buffer.push_back(TAG_OBJECT);
+            std::vector<std::string> members = value.getMemberNames();
+            append<uint32_t>(buffer, members.size());
+            for (auto member : members)
+            {
+                append<uint32_t>(buffer, strings.add(member));
+                encodeValue(value[member], buffer, strings);
+            }
+            break;
+        }
+        default:
+            buffer.push_back(TAG_NULL);
+            break;
+    }
+}
+
+bool GameDetailsCache::save(const std::string& filepath, const Json::Value& cache_json, const std::string& json_filepath)
+{
+    uint64_t json_size;
+    int64_t json_mtime;
+    if (!getSourceStat(json_filepath, json_size, json_mtime))
+        return false;
+
+    const Json::Value& games = cache_json["games"];
+    stringTableBuilder strings;
+
+    std::string records;
+    std::string index;
+    for (Json::ArrayIndex i = 0; i < games.size(); ++i)
+    {
+        uint64_t record_offset = records.size();
+        encodeValue(games[i], records, strings);
+        append<uint32_t>(index, strings.add(games[i]["gamename"].asString()));
+        append<uint32_t>(index, records.size() - record_offset);
+        append<uint64_t>(index, record_offset);
+    }
+    uint32_t date_id = strings.add(cache_json["date"].asString());
+
+    // Record offsets are relative to end of index
+    uint64_t records_start = CACHE_HEADER_SIZE + index.size();
+    for (size_t pos = 8; pos < index.size(); pos += CACHE_INDEX_ENTRY_SIZE)
+    {
+        uint64_t offset;
+        std::memcpy(&offset, &index[pos], sizeof(offset));
+        offset += records_start;
+        std::memcpy(&index[pos], &offset, sizeof(offset));
+    }
+
+    std::string header;
+    header.append(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    append<uint32_t>(header, CACHE_BYTE_ORDER_MARK);
+    append<uint32_t>(header, GlobalConstants::GAMEDETAILS_BINARY_CACHE_VERSION);
+    append<uint32_t>(header, GlobalConstants::GAMEDETAILS_CACHE_VERSION);
+    append<uint32_t>(header, games.size());
+    append<uint64_t>(header, records_start + records.size());
+    append<uint64_t>(header, strings.table().size());
+    append<uint32_t>(header, date_id);
+    append<uint32_t>(header, 0); // reserved
+    append<uint64_t>(header, json_size);
+    append<int64_t>(header, json_mtime);
+
+    // Write to temporary file and rename so that running instances never map partially written file
+    std::string filepath_tmp = filepath + ".tmp";
+    std::ofstream ofs(filepath_tmp, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (!ofs)
+        return false;
+    ofs.write(header.data(), header.size());
+    ofs.write(index.data(), index.size());
+    ofs.write(records.data(), records.size());
+    ofs.write(strings.table().data(), strings.table().size());
+    ofs.close();
+
+    if (!ofs || std::rename(filepath_tmp.c_str(), filepath.c_str()) != 0)
+    {
+        std::remove(filepath_tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+GameDetailsCache::~GameDetailsCache()
+{
+    this->close();
+}
+
+void GameDetailsCache::close()
+{
+    if (data_ != nullptr)
+        munmap(const_cast<unsigned char*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+    game_count_ = 0;
+    index_ = nullptr;
+    strings_ = nullptr;
+    strings_size_ = 0;
+    date_.clear();
+}
+
+int GameDetailsCache::open(const std::string& filepath, const std::string& json_filepath)
+{
+    this->close();
+
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < CACHE_HEADER_SIZE)
+    {
+        ::close(fd);
+        return 2;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return 2;
+
+    data_ = static_cast<const unsigned char*>(map);
+    size_ = st.st_size;
+
+    const unsigned char* pos = data_ + sizeof(CACHE_MAGIC);
+    const unsigned char* end = data_ + size_;
+    uint32_t byte_order_mark, format_version, cache_version, date_id, reserved;
+    uint64_t strings_offset, json_size;
+    int64_t json_mtime;
+    read(pos, end, byte_order_mark);
+    read(pos, end, format_version);
+    read(pos, end, cache_version);
+    read(pos, end, game_count_);
+    read(pos, end, strings_offset);
+    read(pos, end, strings_size_);
+    read(pos, end, date_id);
+    read(pos, end, reserved);
+    read(pos, end, json_size);
+    read(pos, end, json_mtime);
+
+    if (std::memcmp(data_, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || byte_order_mark != CACHE_BYTE_ORDER_MARK)
+    {
+        this->close();
+        return 2;
+    }
+
+    if (format_version != GlobalConstants::GAMEDETAILS_BINARY_CACHE_VERSION || cache_version != static_cast<uint32_t>(GlobalConstants::GAMEDETAILS_CACHE_VERSION))
+    {
+        this->close();
+        return 5;
+    }
+
+    uint64_t current_json_size;
+    int64_t current_json_mtime;
+    if (!getSourceStat(json_filepath, current_json_size, current_json_mtime) || current_json_size != json_size || current_json_mtime != json_mtime)
+    {
+        this->close();
+        return 6;
+    }
+
+    uint64_t index_size = static_cast<uint64_t>(game_count_) * CACHE_INDEX_ENTRY_SIZE;
+    if (CACHE_HEADER_SIZE + index_size > strings_offset || strings_offset > size_ || strings_size_ > size_ - strings_offset)
+    {
+        this->close();
+        return 2;
+    }
+    index_ = data_ + CACHE_HEADER_SIZE;
+    strings_ = data_ + strings_offset;
+
+    if (!this->getString(date_id, date_))
+    {
+        this->close();
+        return 2;
+    }
+
+    return 0;
+}
+
+bool GameDetailsCache::getString(const uint32_t& id, std::string& str) const
+{
+    const unsigned char* pos = strings_ + id;
+    const unsigned char* end = strings_ + strings_size_;
+    uint32_t length;
+    if (id >= strings_size_ || !read(pos, end, length) || length > static_cast<size_t>(end - pos))
+        return false;
+
+    str.assign(reinterpret_cast<const char*>(pos), length);
+    return true;
+}
+
+std::string GameDetailsCache::getGamename(const uint32_t& index) const
+{
+    std::string gamename;
+    if (index >= game_count_)
+        return gamename;
+
+    uint32_t gamename_id;
+    std::memcpy(&gamename_id, index_ + index * CACHE_INDEX_ENTRY_SIZE, sizeof(gamename_id));
+    this->getString(gamename_id, gamename);
+
+    return gamename;
+}
+
+bool GameDetailsCache::getGameJson(const uint32_t& index, Json::Value& json) const
+{
+    if (index >= game_count_)
+        return false;
+
+    const unsigned char* entry = index_ + index * CACHE_INDEX_ENTRY_SIZE;
+    uint32_t record_size;
+    uint64_t record_offset;
+    std::memcpy(&record_size, entry + 4, sizeof(record_size));
+    std::memcpy(&record_offset, entry + 8, sizeof(record_offset));
+
+    uint64_t records_end = strings_ - data_;
+    if (record_offset > records_end || record_size > records_end - record_offset)
+        return false;
+
+    const unsigned char* pos = data_ + record_offset;
+    json = Json::Value();
+    return this->decodeValue(pos, pos + record_size, json, 0);
+}
+
+bool GameDetailsCache::decodeValue(const unsigned char*& pos, const unsigned char* end, Json::Value& value, const unsigned int& depth) const
+{
+    unsigned char tag;
+    if (depth > CACHE_MAX_DEPTH || !read(pos, end, tag))
+        return false;
+
+    switch (tag)
+    {
+        case TAG_NULL:
+            value = Json::Value();
+            return true;
+        case TAG_INT:
+        {
+            int64_t i;
+            if (!read(pos, end, i))
+                return false;
+            value = Json::Value(static_cast<Json::Int64>(i));
+            return true;
+        }
+        case TAG_UINT:
+        {
+            uint64_t u;
+            if (!read(pos, end, u))
+                return false;
+            value = Json::Value(static_cast<Json::UInt64>(u));
+            return true;
+        }
+        case TAG_REAL:
+        {
+            double d;
+            if (!read(pos, end, d))
+                return false;
+            value = Json::Value(d);
+            return true;
+        }
+        case TAG_STRING:
+        {
+            uint32_t id;
+            std::string str;
+            if (!read(pos, end, id) || !this->getString(id, str))
+                return false;
+            value = Json::Value(str);
+            return true;
+        }
+        case TAG_FALSE:
+        case TAG_TRUE:
+            value = Json::Value(tag == TAG_TRUE);
+            return true;
+        case TAG_ARRAY:
+        {
+            uint32_t count;
+            if (!read(pos, end, count))
+                return false;
+            value = Json::Value(Json::arrayValue);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (!this->decodeValue(pos, end, value[i], depth + 1))
+                    return false;
+            }
+            return true;
+        }
+        case TAG_OBJECT:
+        {
+            uint32_t count;
+            if (!read(pos, end, count))
+                return false;
+            value = Json::Value(Json::objectValue);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                uint32_t key_id;
+                std::string key;
+                if (!read(pos, end, key_id) || !this->getString(key_id, key))
+                    return false;
+                if (!this->decodeValue(pos, end, value[key], depth + 1))
+                    return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,345 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "metrics.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+struct metricDefinition
+{
+    const char* name;
+    const char* type;
+    const char* help;
+    std::vector<double> buckets;
+};
+
+static const std::vector<double> BUCKETS_REQUEST = { 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30 };
+static const std::vector<double> BUCKETS_DISK = { 0.00001, 0.0001, 0.001, 0.01, 0.1, 1 };
+static const std::vector<double> BUCKETS_HASH = { 0.001, 0.01, 0.1, 1, 10, 60, 300 };
+
+static const std::vector<metricDefinition> METRIC_DEFINITIONS =
+{
+    { "lgogdownloader_downloaded_bytes_total", "counter", "Bytes downloaded by queue", {} },
+    { "lgogdownloader_transfers_total", "counter", "Finished transfers by queue, curl result code and HTTP status", {} },
+    { "lgogdownloader_retries_total", "counter", "Retried transfers by queue, curl result code and HTTP status", {} },
+    { "lgogdownloader_host_downloaded_bytes_total", "counter", "Bytes downloaded by host", {} },
+    { "lgogdownloader_host_transfer_seconds_total", "counter", "Time spent in transfers by host", {} },
+    { "lgogdownloader_api_request_duration_seconds", "histogram", "API request latency including retries", BUCKETS_REQUEST },
+    { "lgogdownloader_api_request_errors_total", "counter", "Failed API requests by curl result code", {} },
+    { "lgogdownloader_hash_duration_seconds", "histogram", "Time spent calculating hashes", BUCKETS_HASH },
+    { "lgogdownloader_hashed_bytes_total", "counter", "Bytes hashed", {} },
+    { "lgogdownloader_disk_write_duration_seconds", "histogram", "Time spent writing downloaded data to disk", BUCKETS_DISK },
+    { "lgogdownloader_disk_written_bytes_total", "counter", "Downloaded bytes written to disk", {} }
+};
+
+static std::string formatValue(const double& value)
+{
+    std::ostringstream ss;
+    if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0)
+        ss << static_cast<long long>(value);
+    else
+        ss << std::setprecision(15) << value;
+    return ss.str();
+}
+
+static std::string escapeLabelValue(const std::string& value)
+{
+    std::string escaped;
+    for (auto c : value)
+    {
+        if (c == '\\' || c == '"')
+            escaped.push_back('\\');
+        if (c == '\n')
+        {
+            escaped += "\\n";
+            continue;
+        }
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+static bool isIdSegment(const std::string& segment)
+{
+    if (segment.empty())
+        return false;
+    if (segment.size() >= 16)
+        return true;
+
+    bool bHasDigit = false;
+    bool bIsHex = true;
+    for (auto c : segment)
+    {
+        if (c >= '0' && c <= '9')
+            bHasDigit = true;
+        else if (!((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')))
+            bIsHex = false;
+    }
+
+    return bHasDigit && bIsHex;
+}
+
+Metrics::~Metrics()
+{
+    this->stopWriter();
+}
+
+Metrics::metricFamily* Metrics::getFamily(const std::string& name)
+{
+    auto it = families_.find(name);
+    if (it != families_.end())
+        return &it->second;
+
+    for (auto& def : METRIC_DEFINITIONS)
+    {
+        if (name == def.name)
+        {
+            metricFamily& family = families_[name];
+            family.type = def.type;
+            family.help = def.help;
+            family.buckets = def.buckets;
+            return &family;
+        }
+    }
+
+    return nullptr;
+}
+
+std::string Metrics::labelString(const metricLabels& labels)
+{
+    std::string str;
+    for (auto& label : labels)
+    {
+        if (!str.empty())
+            str += ",";
+        str += label.first + "=\"" + escapeLabelValue(label.second) + "\"";
+    }
+    return str;
+}
+
+void Metrics::addCounter(const std::string& name, const metricLabels& labels, const double& value)
+{
+    if (!enabled_)
+        return;
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    metricFamily* family = this->getFamily(name);
+    if (family)
+        family->series[labelString(labels)].value += value;
+}
+
+void Metrics::observe(const std::string& name, const metricLabels& labels, const double& value)
+{
+    if (!enabled_)
+        return;
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    metricFamily* family = this->getFamily(name);
+    if (!family)
+        return;
+
+    metricSeries& series = family->series[labelString(labels)];
+    if (series.buckets.empty())
+        series.buckets.resize(family->buckets.size(), 0);
+
+    for (size_t i = 0; i < family->buckets.size(); ++i)
+    {
+        if (value <= family->buckets[i])
+        {
+            series.buckets[i]++;
+            break;
+        }
+    }
+    series.sum += value;
+    series.count++;
+}
+
+void Metrics::transfer(CURL* curlhandle, const std::string& queue, const CURLcode& result)
+{
+    if (!enabled_)
+        return;
+
+    curl_off_t bytes = 0;
+    double seconds = 0;
+    long int response_code = 0;
+    char* url = NULL;
+    curl_easy_getinfo(curlhandle, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+    curl_easy_getinfo(curlhandle, CURLINFO_TOTAL_TIME, &seconds);
+    curl_easy_getinfo(curlhandle, CURLINFO_RESPONSE_CODE, &response_code);
+    curl_easy_getinfo(curlhandle, CURLINFO_EFFECTIVE_URL, &url);
+
+    this->addCounter("lgogdownloader_downloaded_bytes_total", { {"queue", queue} }, bytes);
+    this->addCounter("lgogdownloader_transfers_total", { {"queue", queue}, {"curlcode", std::to_string(result)}, {"http_status", std::to_string(response_code)} }, 1);
+
+    std::string host = url ? Metrics::host(url) : std::string();
+    if (!host.empty())
+    {
+        this->addCounter("lgogdownloader_host_downloaded_bytes_total", { {"host", host} }, bytes);
+        this->addCounter("lgogdownloader_host_transfer_seconds_total", { {"host", host} }, seconds);
+    }
+}
+
+void Metrics::retry(const std::string& queue, const CURLcode& result, const long int& response_code)
+{
+    this->addCounter("lgogdownloader_retries_total", { {"queue", queue}, {"curlcode", std::to_string(result)}, {"http_status", std::to_string(response_code)} }, 1);
+}
+
+void Metrics::apiRequest(const std::string& api, const std::string& url, const double& seconds, const CURLcode& result)
+{
+    if (!enabled_)
+        return;
+
+    std::string endpoint = Metrics::endpoint(url);
+    this->observe("lgogdownloader_api_request_duration_seconds", { {"api", api}, {"endpoint", endpoint} }, seconds);
+    if (result != CURLE_OK)
+        this->addCounter("lgogdownloader_api_request_errors_total", { {"api", api}, {"endpoint", endpoint}, {"curlcode", std::to_string(result)} }, 1);
+}
+
+void Metrics::hash(const double& seconds, const uintmax_t& bytes)
+{
+    this->observe("lgogdownloader_hash_duration_seconds", {}, seconds);
+    this->addCounter("lgogdownloader_hashed_bytes_total", {}, bytes);
+}
+
+void Metrics::diskWrite(const double& seconds, const uintmax_t& bytes)
+{
+    this->observe("lgogdownloader_disk_write_duration_seconds", {}, seconds);
+    this->addCounter("lgogdownloader_disk_written_bytes_total", {}, bytes);
+}
+
+std::string Metrics::format()
+{
+    std::ostringstream ss;
+    std::unique_lock<std::mutex> lock(mtx_);
+
+    for (auto& family_iter : families_)
+    {
+        const std::string& name = family_iter.first;
+        const metricFamily& family = family_iter.second;
+        ss << "# HELP " << name << " " << family.help << "\n";
+        ss << "# TYPE " << name << " " << family.type << "\n";
+
+        for (auto& series_iter : family.series)
+        {
+            const std::string& labels = series_iter.first;
+            const metricSeries& series = series_iter.second;
+            if (family.type != "histogram")
+            {
+                ss << name << (labels.empty() ? "" : "{" + labels + "}") << " " << formatValue(series.value) << "\n";
+                continue;
+            }
+
+            std::string prefix = labels.empty() ? "" : labels + ",";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < family.buckets.size(); ++i)
+            {
+                cumulative += series.buckets[i];
+                ss << name << "_bucket{" << prefix << "le=\"" << formatValue(family.buckets[i]) << "\"} " << cumulative << "\n";
+            }
+            ss << name << "_bucket{" << prefix << "le=\"+Inf\"} " << series.count << "\n";
+            ss << name << "_sum" << (labels.empty() ? "" : "{" + labels + "}") << " " << formatValue(series.sum) << "\n";
+            ss << name << "_count" << (labels.empty() ? "" : "{" + labels + "}") << " " << series.count << "\n";
+        }
+    }
+    ss << "# EOF\n";
+
+    return ss.str();
+}
+
+bool Metrics::writeFile(const std::string& filepath)
+{
+    // Write to temporary file and rename so that readers never see partial file
+    std::string filepath_tmp = filepath + ".tmp";
+    std::ofstream ofs(filepath_tmp, std::ofstream::out | std::ofstream::trunc);
+    if (!ofs)
+        return false;
+
+    ofs << this->format();
+    ofs.close();
+    if (!ofs)
+        return false;
+
+    return std::rename(filepath_tmp.c_str(), filepath.c_str()) == 0;
+}
+
+void Metrics::startWriter(const std::string& filepath, const unsigned int& interval)
+{
+    this->stopWriter();
+    this->enable();
+    filepath_ = filepath;
+    writer_stop_ = false;
+
+    writer_ = std::thread([this, interval]()
+    {
+        std::unique_lock<std::mutex> lock(writer_mtx_);
+        while (!writer_stop_)
+        {
+            writer_cv_.wait_for(lock, std::chrono::seconds(interval > 0 ? interval : 1));
+            if (!writer_stop_)
+                this->writeFile(filepath_);
+        }
+    });
+}
+
+void Metrics::stopWriter()
+{
+    if (!writer_.joinable())
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(writer_mtx_);
+        writer_stop_ = true;
+    }
+    writer_cv_.notify_all();
+    writer_.join();
+
+    if (!this->writeFile(filepath_))
+        std::cerr << "Failed to write metrics to " << filepath_ << std::endl;
+}
+
+std::string Metrics::host(const std::string& url)
+{
+    size_t start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    size_t end = url.find_first_of(":/?#", start);
+    return url.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+std::string Metrics::endpoint(const std::string& url)
+{
+    std::string endpoint = Metrics::host(url);
+
+    size_t start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    size_t path_start = url.find('/', start);
+    if (path_start == std::string::npos)
+        return endpoint;
+
+    size_t path_end = url.find_first_of("?#", path_start);
+    std::string path = url.substr(path_start, path_end == std::string::npos ? std::string::npos : path_end - path_start);
+
+    std::istringstream segments(path);
+    std::string segment;
+    while (std::getline(segments, segment, '/'))
+    {
+        if (segment.empty())
+            continue;
+
+        // Keep file extension of segments like "12345.json"
+        size_t dot = segment.find('.');
+        std::string name = segment.substr(0, dot);
+        std::string extension = (dot == std::string::npos) ? "" : segment.substr(dot);
+        endpoint += "/" + (isIdSegment(name) ? "{id}" + extension : segment);
+    }
+
+    return endpoint;
+}
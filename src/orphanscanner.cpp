@@ -0,0 +1,214 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "orphanscanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Collapse repeated slashes so that paths built as "dir/" + "/" + "file"
+// compare equal to paths found on disk
+static std::string normalizePath(const std::string& path)
+{
+    std::string normalized;
+    normalized.reserve(path.size());
+    for (std::string::size_type i = 0; i < path.size(); ++i)
+    {
+        if (path[i] == '/' && !normalized.empty() && normalized.back() == '/')
+            continue;
+        normalized.push_back(path[i]);
+    }
+    return normalized;
+}
+
+static std::string joinPath(const std::string& directory, const char* name)
+{
+    if (!directory.empty() && directory.back() == '/')
+        return directory + name;
+    return directory + "/" + name;
+}
+
+// Use d_type from readdir and only stat when filesystem doesn't report type or entry is a symlink.
+// Symlinks to regular files count as files but symlinked directories are not followed.
+static unsigned char getEntryType(const std::string& path, const unsigned char& d_type)
+{
+    if (d_type != DT_UNKNOWN && d_type != DT_LNK)
+        return d_type;
+
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0)
+        return DT_UNKNOWN;
+
+    if (S_ISDIR(st.st_mode))
+        return DT_DIR;
+    else if (S_ISREG(st.st_mode))
+        return DT_REG;
+    else if (S_ISLNK(st.st_mode) && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+        return DT_REG;
+
+    return DT_UNKNOWN;
+}
+
+OrphanScanner::OrphanScanner(const Blacklist& blacklist, const Blacklist& ignorelist, const std::size_t& iPrefixLength, const std::string& sOrphanRegex)
+    : blacklist_(blacklist), ignorelist_(ignorelist), prefix_length_(iPrefixLength), running_threads_(0)
+{
+    orphan_filter_ = PatternMatcher::get(sOrphanRegex);
+}
+
+void OrphanScanner::addExpectedPath(const std::string& path)
+{
+    expected_.insert(normalizePath(path));
+}
+
+void OrphanScanner::addDirectory(const std::string& path)
+{
+    std::string directory = normalizePath(path);
+    while (directory.size() > 1 && directory.back() == '/')
+        directory.pop_back();
+    directories_.push_back(directory);
+}
+
+void OrphanScanner::processFile(const std::string& filepath)
+{
+    std::string relative_path;
+    if (filepath.size() >= prefix_length_)
+        relative_path = filepath.substr(prefix_length_);
+
+    orphanScanResult result;
+    result.path = filepath;
+    const BlacklistItem* item;
+    if ((item = ignorelist_.getMatchingItem(relative_path)) != nullptr)
+    {
+        result.type = ORPHANSCAN_IGNORELISTED;
+        result.linenr = item->linenr;
+        results_.push(result);
+    }
+    else if ((item = blacklist_.getMatchingItem(relative_path)) != nullptr)
+    {
+        result.type = ORPHANSCAN_BLACKLISTED;
+        result.linenr = item->linenr;
+        results_.push(result);
+    }
+    else if (orphan_filter_->search(filepath))
+    {
+        if (expected_.count(normalizePath(filepath)) == 0)
+        {
+            result.type = ORPHANSCAN_ORPHAN;
+            results_.push(result);
+        }
+    }
+}
+
+void OrphanScanner::walkDirectory(const std::string& path)
+{
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+    {
+        orphanScanResult result;
+        result.type = ORPHANSCAN_ERROR;
+        result.path = path + ": " + std::strerror(errno);
+        results_.push(result);
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        std::string entry_path = joinPath(path, entry->d_name);
+        unsigned char type = getEntryType(entry_path, entry->d_type);
+        if (type == DT_DIR)
+            this->walkDirectory(entry_path);
+        else if (type == DT_REG)
+            this->processFile(entry_path);
+    }
+    closedir(dir);
+}
+
+void OrphanScanner::scanThread()
+{
+    std::string directory;
+    while (jobs_.try_pop(directory))
+        this->walkDirectory(directory);
+
+    running_threads_.fetch_sub(1);
+}
+
+void OrphanScanner::scan(const unsigned int& iThreads, const std::function<void(const orphanScanResult&)>& callback)
+{
+    // Remove duplicate directories and directories that are inside other directories
+    std::sort(directories_.begin(), directories_.end());
+    directories_.erase(std::unique(directories_.begin(), directories_.end()), directories_.end());
+    std::vector<std::string> roots;
+    for (auto dir : directories_)
+    {
+        if (!roots.empty())
+        {
+            const std::string& prev = roots.back();
+            std::string prefix = (prev.back() == '/') ? prev : prev + "/";
+            if (dir.compare(0, prefix.size(), prefix) == 0)
+                continue;
+        }
+        roots.push_back(dir);
+    }
+
+    // Files in top level directories are handled here, subdirectories become jobs for worker threads
+    for (auto root : roots)
+    {
+        DIR* dir = opendir(root.c_str());
+        if (!dir)
+        {
+            orphanScanResult result;
+            result.type = ORPHANSCAN_ERROR;
+            result.path = root + ": " + std::strerror(errno);
+            callback(result);
+            continue;
+        }
+
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            std::string entry_path = joinPath(root, entry->d_name);
+            unsigned char type = getEntryType(entry_path, entry->d_type);
+            if (type == DT_DIR)
+                jobs_.push(entry_path);
+            else if (type == DT_REG)
+                this->processFile(entry_path);
+        }
+        closedir(dir);
+    }
+
+    unsigned int iThreadCount = std::max(1u, std::min(iThreads, static_cast<unsigned int>(jobs_.size())));
+    std::vector<std::thread> vThreads;
+    running_threads_.store(iThreadCount);
+    for (unsigned int i = 0; i < iThreadCount; ++i)
+        vThreads.push_back(std::thread(&OrphanScanner::scanThread, this));
+
+    orphanScanResult result;
+    while (running_threads_.load() > 0)
+    {
+        if (results_.try_pop(result))
+            callback(result);
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    for (unsigned int i = 0; i < vThreads.size(); ++i)
+        vThreads[i].join();
+
+    while (results_.try_pop(result))
+        callback(result);
+}
@@ -0,0 +1,194 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "patternmatcher.h"
+
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <utility>
+
+PatternMatcher::PatternMatcher(const std::string& pattern, const unsigned int& flags)
+{
+    this->source_ = pattern;
+    this->flags_ = flags;
+    this->mode_ = MODE_REGEX;
+
+    if (!this->analyze(pattern))
+    {
+        boost::regex::flag_type rx_flags = boost::regex::perl;
+        if (flags & PATTERN_ICASE)
+            rx_flags |= boost::regex::icase;
+
+        this->mode_ = MODE_REGEX;
+        this->literals_.clear();
+        this->regex_.assign(pattern, rx_flags);
+    }
+}
+
+std::string PatternMatcher::foldCase(const std::string& str) const
+{
+    if (!(this->flags_ & PATTERN_ICASE))
+        return str;
+
+    std::string folded = str;
+    for (std::string::size_type i = 0; i < folded.size(); ++i)
+        folded[i] = std::tolower(static_cast<unsigned char>(folded[i]));
+    return folded;
+}
+
+// Check if pattern can be matched without regex engine
+// Returns false if regex is needed
+bool PatternMatcher::analyze(const std::string& pattern)
+{
+    if (pattern.empty() || pattern == ".*")
+    {
+        this->mode_ = MODE_ALL;
+        return true;
+    }
+
+    std::string p = pattern;
+    bool bAnchorStart = false;
+    bool bAnchorEnd = false;
+    if (p[0] == '^')
+    {
+        bAnchorStart = true;
+        p.erase(0, 1);
+    }
+    if (!p.empty() && p.back() == '$')
+    {
+        // Make sure that '$' is not escaped
+        unsigned int backslashes = 0;
+        for (std::string::size_type i = p.size() - 1; i > 0 && p[i-1] == '\\'; --i)
+            ++backslashes;
+        if (backslashes % 2 == 0)
+        {
+            bAnchorEnd = true;
+            p.pop_back();
+        }
+    }
+
+    // Strip a single enclosing group without nested groups
+    bool bGroup = false;
+    if (p.size() >= 2 && p.front() == '(' && p.back() == ')')
+    {
+        std::string inner = p.substr(1, p.size() - 2);
+        if (inner.find_first_of("()") == std::string::npos)
+        {
+            p = inner;
+            bGroup = true;
+        }
+    }
+
+    std::vector<std::string> alternatives;
+    std::string current;
+    for (std::string::size_type i = 0; i < p.size(); ++i)
+    {
+        char c = p[i];
+        if (c == '\\')
+        {
+            // Only escaped regex metacharacters are literal
+            // Other escapes are character classes, backreferences or anchors like \< \> \` \'
+            if (i + 1 >= p.size() || p[i+1] == '\0' || std::strchr(".[]{}()*+?^$|\\/-", p[i+1]) == NULL)
+                return false;
+            current += p[++i];
+        }
+        else if (c == '|')
+        {
+            // "^a|b$" means "(^a)|(b$)" so alternatives are only safe inside anchored group
+            if (!bGroup && (bAnchorStart || bAnchorEnd))
+                return false;
+            alternatives.push_back(current);
+            current.clear();
+        }
+        else if (std::strchr(".[]{}()*+?^$", c) != NULL)
+            return false;
+        else
+            current += c;
+    }
+    alternatives.push_back(current);
+
+    for (auto alternative : alternatives)
+    {
+        if (alternative.empty())
+            return false;
+
+        // Only ASCII case folding is done here
+        if (this->flags_ & PATTERN_ICASE)
+        {
+            for (std::string::size_type i = 0; i < alternative.size(); ++i)
+                if (static_cast<unsigned char>(alternative[i]) >= 0x80)
+                    return false;
+        }
+    }
+
+    for (auto alternative : alternatives)
+        this->literals_.push_back(this->foldCase(alternative));
+
+    if (bAnchorStart && bAnchorEnd)
+    {
+        this->mode_ = MODE_EXACT;
+        this->literal_set_.insert(this->literals_.begin(), this->literals_.end());
+    }
+    else if (bAnchorStart)
+        this->mode_ = MODE_PREFIX;
+    else if (bAnchorEnd)
+        this->mode_ = MODE_SUFFIX;
+    else
+        this->mode_ = MODE_SUBSTRING;
+
+    return true;
+}
+
+bool PatternMatcher::search(const std::string& str) const
+{
+    if (this->mode_ == MODE_ALL)
+        return true;
+    else if (this->mode_ == MODE_REGEX)
+        return boost::regex_search(str, this->regex_);
+
+    std::string s = this->foldCase(str);
+    if (this->mode_ == MODE_EXACT)
+        return this->literal_set_.count(s) > 0;
+
+    for (auto literal : this->literals_)
+    {
+        if (this->mode_ == MODE_PREFIX)
+        {
+            if (s.size() >= literal.size() && s.compare(0, literal.size(), literal) == 0)
+                return true;
+        }
+        else if (this->mode_ == MODE_SUFFIX)
+        {
+            if (s.size() >= literal.size() && s.compare(s.size() - literal.size(), literal.size(), literal) == 0)
+                return true;
+        }
+        else if (s.find(literal) != std::string::npos)
+            return true;
+    }
+
+    return false;
+}
+
+std::shared_ptr<const PatternMatcher> PatternMatcher::get(const std::string& pattern, const unsigned int& flags)
+{
+    static std::mutex m;
+    static std::map<std::pair<std::string, unsigned int>, std::shared_ptr<const PatternMatcher>> cache;
+
+    std::pair<std::string, unsigned int> key(pattern, flags);
+    std::unique_lock<std::mutex> lock(m);
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return it->second;
+    lock.unlock();
+
+    // Compile outside the lock, regex compilation can be slow
+    std::shared_ptr<const PatternMatcher> matcher = std::make_shared<PatternMatcher>(pattern, flags);
+
+    lock.lock();
+    return cache.insert(std::make_pair(key, matcher)).first->second;
+}
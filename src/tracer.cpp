@@ -0,0 +1,159 @@
+/* This program is free software. It comes without any warranty, to
+ * the extent permitted by applicable law. You can redistribute it
+ * and/or modify it under the terms of the Do What The Fuck You Want
+ * To Public License, Version 2, as published by Sam Hocevar. See
+ * http://www.wtfpl.net/ for more details. */
+
+#include "tracer.h"
+#include "globals.h"
+
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+// Buffer of current thread, shared with tracer so that it outlives the thread
+static thread_local std::shared_ptr<traceThread> currentThread;
+
+static void writeJsonString(std::ostream& os, const std::string& str)
+{
+    static const char digits[] = "0123456789abcdef";
+    os << '"';
+    for (auto c : str)
+    {
+        unsigned char uc = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\')
+            os << '\\' << c;
+        else if (uc < 0x20)
+            os << "\\u00" << digits[uc >> 4] << digits[uc & 0x0F];
+        else
+            os << c;
+    }
+    os << '"';
+}
+
+Tracer::~Tracer()
+{
+    this->stop();
+}
+
+void Tracer::start(const std::string& filepath)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    filepath_ = filepath;
+    epoch_ = std::chrono::steady_clock::now();
+    enabled_ = true;
+}
+
+traceThread* Tracer::getThread()
+{
+    if (!currentThread)
+    {
+        currentThread = std::make_shared<traceThread>();
+        std::unique_lock<std::mutex> lock(mtx_);
+        currentThread->tid = threads_.size() + 1;
+        if (threads_.empty())
+            currentThread->name = "main";
+        threads_.push_back(currentThread);
+    }
+    return currentThread.get();
+}
+
+void Tracer::setThreadName(const std::string& name)
+{
+    if (!enabled_)
+        return;
+
+    traceThread* thread = this->getThread();
+    std::unique_lock<std::mutex> lock(thread->mtx);
+    thread->name = name;
+}
+
+void Tracer::add(const char* name, const std::string& detail, const std::chrono::steady_clock::time_point& start, const std::chrono::steady_clock::time_point& end)
+{
+    if (!enabled_)
+        return;
+
+    traceEvent event;
+    event.name = name;
+    event.detail = detail;
+    event.start_us = std::chrono::duration_cast<std::chrono::microseconds>(start - epoch_).count();
+    event.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    traceThread* thread = this->getThread();
+    std::unique_lock<std::mutex> lock(thread->mtx);
+    thread->events.push_back(std::move(event));
+}
+
+bool Tracer::stop()
+{
+    if (!enabled_)
+        return true;
+    enabled_ = false;
+
+    std::ofstream ofs(filepath_, std::ofstream::out | std::ofstream::trunc);
+    if (!ofs)
+    {
+        std::cerr << "Failed to write trace to " << filepath_ << std::endl;
+        return false;
+    }
+
+    int pid = getpid();
+    bool bFirst = true;
+    ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    for (auto& thread : threads_)
+    {
+        std::unique_lock<std::mutex> thread_lock(thread->mtx);
+        if (!thread->name.empty())
+        {
+            ofs << (bFirst ? "\n" : ",\n");
+            ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << thread->tid << ",\"args\":{\"name\":";
+            writeJsonString(ofs, thread->name);
+            ofs << "}}";
+            bFirst = false;
+        }
+
+        for (auto& event : thread->events)
+        {
+            ofs << (bFirst ? "\n" : ",\n");
+            ofs << "{\"name\":";
+            writeJsonString(ofs, event.name);
+            ofs << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << thread->tid << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us;
+            if (!event.detail.empty())
+            {
+                ofs << ",\"args\":{\"detail\":";
+                writeJsonString(ofs, event.detail);
+                ofs << "}";
+            }
+            ofs << "}";
+            bFirst = false;
+        }
+        thread->events.clear();
+    }
+    ofs << "\n]}\n";
+    ofs.close();
+
+    return ofs.good();
+}
+
+TraceSpan::TraceSpan(const char* name) : name_(name), bEnabled_(Globals::tracer.isEnabled())
+{
+    if (bEnabled_)
+        start_ = std::chrono::steady_clock::now();
+}
+
+TraceSpan::TraceSpan(const char* name, const std::string& detail) : name_(name), bEnabled_(Globals::tracer.isEnabled())
+{
+    if (bEnabled_)
+    {
+        detail_ = detail;
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (bEnabled_)
+        Globals::tracer.add(name_, detail_, start_, std::chrono::steady_clock::now());
+}
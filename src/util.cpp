@@ -5,6 +5,7 @@
  * http://www.wtfpl.net/ for more details. */
 
 #include "util.h"
+#include "patternmatcher.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
@@ -13,26 +14,41 @@
 #include <boost/iostreams/copy.hpp>
 #include <json/json.h>
 #include <fstream>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include <sys/ioctl.h>
 #include <tidy.h>
 #include <tidybuffio.h>
 
 std::string Util::getFileHash(const std::string& filename, unsigned hash_id)
 {
+    TraceSpan span("hash", filename);
     unsigned char digest[rhash_get_digest_size(hash_id)];
     char result[rhash_get_hash_length(hash_id) + 1];
 
+    auto start = std::chrono::steady_clock::now();
     int i = rhash_file(hash_id, filename.c_str(), digest);
     if (i < 0)
         std::cerr << "LibRHash error: " << strerror(errno) << std::endl;
     else
         rhash_print_bytes(result, digest, rhash_get_digest_size(hash_id), RHPR_HEX);
 
+    if (i >= 0 && Globals::metrics.isEnabled())
+    {
+        boost::system::error_code ec;
+        uintmax_t filesize = boost::filesystem::file_size(filename, ec);
+        Globals::metrics.hash(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), ec ? 0 : filesize);
+    }
+    EventLog::addHashTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
     return result;
 }
 
 std::string Util::getFileHashRange(const std::string& filepath, unsigned hash_id, off_t range_start, off_t range_end)
 {
+    TraceSpan span("hash", filepath);
     char result[rhash_get_hash_length(hash_id) + 1];
 
     if (!boost::filesystem::exists(filepath))
@@ -55,6 +71,7 @@ std::string Util::getFileHashRange(const std::string& filepath, unsigned hash_id
     off_t remaining = rangesize % chunk_size;
     int chunks = (remaining == 0) ? rangesize/chunk_size : (rangesize/chunk_size)+1;
 
+    auto start = std::chrono::steady_clock::now();
     rhash rhash_context;
     rhash_context = rhash_init(hash_id);
 
@@ -92,26 +109,37 @@ std::string Util::getFileHashRange(const std::string& filepath, unsigned hash_id
     rhash_print(result, rhash_context, hash_id, RHPR_HEX);
     rhash_free(rhash_context);
 
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Globals::metrics.hash(seconds, rangesize);
+    EventLog::addHashTime(seconds);
+
     return result;
 }
 
 std::string Util::getChunkHash(unsigned char *chunk, uintmax_t chunk_size, unsigned hash_id)
 {
+    TraceSpan span("hash chunk");
     unsigned char digest[rhash_get_digest_size(hash_id)];
     char result[rhash_get_hash_length(hash_id) + 1];
 
+    auto start = std::chrono::steady_clock::now();
     int i = rhash_msg(hash_id, chunk, chunk_size, digest);
     if (i < 0)
         std::cerr << "LibRHash error: " << strerror(errno) << std::endl;
     else
         rhash_print_bytes(result, digest, rhash_get_digest_size(hash_id), RHPR_HEX);
 
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Globals::metrics.hash(seconds, chunk_size);
+    EventLog::addHashTime(seconds);
+
     return result;
 }
 
 // Create GOG XML
 int Util::createXML(std::string filepath, uintmax_t chunk_size, std::string xml_dir)
 {
+    TraceSpan span("createXML", filepath);
     int res = 0;
     FILE *infile;
     FILE *xmlfile;
@@ -228,6 +256,13 @@ int Util::createXML(std::string filepath, uintmax_t chunk_size, std::string xml_
         xml.Print(&printer);
         fclose(xmlfile);
         res = 1;
+
+        // Store entries take precedence over XML files so update the store as well
+        tinyxml2::XMLPrinter printer_store;
+        xml.Print(&printer_store);
+        checksumEntry entry;
+        if (ChecksumStore::parseXML(printer_store.CStr(), entry))
+            Globals::checksumStore.save(filenameXML, entry);
     } else {
         std::cerr << "Can't create " << filenameXML << std::endl;
         return res;
@@ -236,6 +271,71 @@ int Util::createXML(std::string filepath, uintmax_t chunk_size, std::string xml_
     return res;
 }
 
+// Parsed game specific config files by directory
+// Directory is scanned on first lookup and rescanned after GAMESPECIFIC_RESCAN_INTERVAL
+// so that lookups don't open and parse the file every time.
+// Only files with changed mtime are parsed again on rescan.
+struct gameSpecificConfigFile
+{
+    std::time_t mtime = 0;
+    Json::Value root;
+    bool bValid = false; // false if parsing failed, kept to avoid parsing again before file changes
+};
+
+struct gameSpecificConfigDir
+{
+    std::unordered_map<std::string, gameSpecificConfigFile> files;
+    std::chrono::steady_clock::time_point lastScan;
+};
+
+static const std::chrono::seconds GAMESPECIFIC_RESCAN_INTERVAL(5);
+static std::mutex mtxGameSpecificConfig;
+static std::map<std::string, gameSpecificConfigDir> mGameSpecificConfigDirs;
+
+static void scanGameSpecificConfigDir(const std::string& directory, gameSpecificConfigDir& dir)
+{
+    std::unordered_map<std::string, gameSpecificConfigFile> files;
+    boost::system::error_code ec;
+
+    if (boost::filesystem::is_directory(directory, ec))
+    {
+        boost::filesystem::directory_iterator end_iter;
+        for (boost::filesystem::directory_iterator dir_iter(directory, ec); !ec && dir_iter != end_iter; dir_iter.increment(ec))
+        {
+            boost::filesystem::path path = dir_iter->path();
+            if (path.extension() != ".conf" || !boost::filesystem::is_regular_file(path, ec))
+                continue;
+
+            std::time_t mtime = boost::filesystem::last_write_time(path, ec);
+            if (ec)
+                continue;
+
+            std::string gamename = path.stem().string();
+            auto it = dir.files.find(gamename);
+            if (it != dir.files.end() && it->second.mtime == mtime)
+            {
+                files[gamename] = std::move(it->second);
+                continue;
+            }
+
+            gameSpecificConfigFile file;
+            file.mtime = mtime;
+            std::ifstream json(path.string(), std::ifstream::binary);
+            try {
+                json >> file.root;
+            } catch (const Json::Exception& exc) {
+                std::cerr << "Failed to parse game specific config " << path.string() << std::endl;
+                std::cerr << exc.what() << std::endl;
+            }
+            file.bValid = !file.root.isNull();
+            files[gamename] = std::move(file);
+        }
+    }
+
+    dir.files.swap(files);
+    dir.lastScan = std::chrono::steady_clock::now();
+}
+
 /*
     Overrides global settings with game specific settings
     returns 0 if fails
@@ -252,21 +352,23 @@ int Util::getGameSpecificConfig(std::string gamename, gameSpecificConfig* conf,
 
     std::string filepath = directory + "/" + gamename + ".conf";
 
-    // Make sure file exists
-    boost::filesystem::path path = filepath;
-    if (!boost::filesystem::exists(path)) {
-        return res;
+    std::unique_lock<std::mutex> lock(mtxGameSpecificConfig);
+    auto dir_iter = mGameSpecificConfigDirs.find(directory);
+    if (dir_iter == mGameSpecificConfigDirs.end())
+    {
+        dir_iter = mGameSpecificConfigDirs.emplace(directory, gameSpecificConfigDir()).first;
+        scanGameSpecificConfigDir(directory, dir_iter->second);
+    }
+    else if (std::chrono::steady_clock::now() - dir_iter->second.lastScan > GAMESPECIFIC_RESCAN_INTERVAL)
+    {
+        scanGameSpecificConfigDir(directory, dir_iter->second);
     }
 
-    std::ifstream json(filepath, std::ifstream::binary);
-    Json::Value root;
-    try {
-        json >> root;
-    } catch (const Json::Exception& exc) {
-        std::cerr << "Failed to parse game specific config " << filepath << std::endl;
-        std::cerr << exc.what() << std::endl;
+    auto file_iter = dir_iter->second.files.find(gamename);
+    if (file_iter == dir_iter->second.files.end() || !file_iter->second.bValid)
         return res;
-    }
+
+    const Json::Value& root = file_iter->second.root;
 
     if (root.isMember("language"))
     {
@@ -513,14 +615,12 @@ std::vector<std::string> Util::tokenize(const std::string& str, const std::strin
 unsigned int Util::getOptionValue(const std::string& str, const std::vector<GlobalConstants::optionsStruct>& options, const bool& bAllowStringToIntConversion)
 {
     unsigned int value = 0;
-    boost::regex expression("^[+-]?\\d+$", boost::regex::perl);
-    boost::match_results<std::string::const_iterator> what;
     if (str == "all")
     {
         for (unsigned int i = 0; i < options.size(); ++i)
             value |= options[i].id;
     }
-    else if (boost::regex_search(str, what, expression) && bAllowStringToIntConversion)
+    else if (PatternMatcher::get("^[+-]?\\d+$")->search(str) && bAllowStringToIntConversion)
     {
         value = std::stoi(str);
     }
@@ -530,8 +630,7 @@ unsigned int Util::getOptionValue(const std::string& str, const std::vector<Glob
         {
             if (!options[i].regexp.empty())
             {
-                boost::regex expr("^(" + options[i].regexp + ")$", boost::regex::perl | boost::regex::icase);
-                if (boost::regex_search(str, what, expr))
+                if (PatternMatcher::get("^(" + options[i].regexp + ")$", PATTERN_ICASE)->search(str))
                 {
                     value = options[i].id;
                     break;
@@ -588,16 +687,10 @@ std::string Util::getLocalFileHash(const std::string& xml_dir, const std::string
     else
         local_xml_file = xml_dir + "/" + path.filename().string() + ".xml";
 
-    if (boost::filesystem::exists(local_xml_file) && useFastCheck)
+    checksumEntry entry;
+    if (useFastCheck && Globals::checksumStore.getEntry(local_xml_file.string(), entry))
     {
-        tinyxml2::XMLDocument local_xml;
-        local_xml.LoadFile(local_xml_file.string().c_str());
-        tinyxml2::XMLElement *fileElem = local_xml.FirstChildElement("file");
-
-        if (fileElem)
-        {
-            localHash = fileElem->Attribute("md5");
-        }
+        localHash = entry.md5;
     }
     else if (boost::filesystem::exists(path) && boost::filesystem::is_regular_file(path))
     {
@@ -725,6 +818,9 @@ void Util::CurlHandleSetDefaultOptions(CURL* curlhandle, const CurlConfig& conf)
         curl_easy_setopt(curlhandle, CURLOPT_DNS_INTERFACE, conf.sInterface.c_str());
         curl_easy_setopt(curlhandle, CURLOPT_INTERFACE, conf.sInterface.c_str());
     }
+
+    if (conf.connectTo)
+        curl_easy_setopt(curlhandle, CURLOPT_CONNECT_TO, conf.connectTo.get());
 }
 
 std::string Util::CurlHandleGetInfoString(CURL* curlhandle, CURLINFO info)
@@ -803,6 +899,8 @@ CURLcode Util::CurlHandleGetResponse(CURL* curlhandle, std::string& response, in
         }
         if (retries >= max_retries)
             bShouldRetry = false;
+        if (bShouldRetry)
+            Globals::metrics.retry("api", result, (result == CURLE_HTTP_RETURNED_ERROR) ? response_code : 0);
     } while (bShouldRetry);
 
     return result;
@@ -933,9 +1031,7 @@ std::string Util::transformGamename(const std::string& gamename)
     std::string gamename_transformed = gamename;
     for (auto transformMatch : Globals::globalConfig.transformationsJSON.getMemberNames())
     {
-        boost::regex expression(transformMatch);
-        boost::match_results<std::string::const_iterator> what;
-        if (boost::regex_search(gamename_transformed, what, expression))
+        if (PatternMatcher::get(transformMatch)->search(gamename_transformed))
         {
             // Get list of exceptions
             std::vector<std::string> vExceptions;
@@ -7,9 +7,11 @@
 #include "website.h"
 #include "globalconstants.h"
 #include "message.h"
+#include "patternmatcher.h"
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <tinyxml2.h>
+#include <chrono>
 
 #ifdef USE_QT_GUI_LOGIN
     #include "gui_login.h"
@@ -31,12 +33,15 @@ Website::~Website()
 
 std::string Website::getResponse(const std::string& url)
 {
+    TraceSpan span("website request", url);
     std::string response;
 
     curl_easy_setopt(curlhandle, CURLOPT_URL, url.c_str());
     int max_retries = std::min(3, Globals::globalConfig.iRetries);
 
+    auto start = std::chrono::steady_clock::now();
     CURLcode result = Util::CurlHandleGetResponse(curlhandle, response, max_retries);
+    Globals::metrics.apiRequest("website", url, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), result);
 
     if (result != CURLE_OK)
     {
@@ -112,6 +117,7 @@ std::vector<gameItem> Website::getGames()
 
     Globals::vOwnedGamesIds = this->getOwnedGamesIds();
     std::vector<Json::Value> jsonProductInfo;
+    std::shared_ptr<const PatternMatcher> gameFilter = PatternMatcher::get(Globals::globalConfig.sGameRegex);
     do
     {
         std::string url = "https://www.gog.com/account/getFilteredProducts?hiddenFlag=" + std::to_string(iHidden) + "&isUpdated=" + std::to_string(iUpdated) + "&mediaType=1&sortBy=title&system=&page=" + std::to_string(iPage);
@@ -154,6 +160,7 @@ std::vector<gameItem> Website::getGames()
         game.name = product["slug"].asString();
         game.id = product["id"].isInt() ? std::to_string(product["id"].asInt()) : product["id"].asString();
         game.isnew = product["isNew"].asBool();
+        game.dlccount = product["dlcCount"].asInt();
 
         if (product.isMember("updates"))
         {
@@ -199,9 +206,7 @@ std::vector<gameItem> Website::getGames()
         // Filter the game list
         if (!Globals::globalConfig.sGameRegex.empty())
         {
-            boost::regex expression(Globals::globalConfig.sGameRegex);
-            boost::match_results<std::string::const_iterator> what;
-            if (!boost::regex_search(game.name, what, expression)) // Check if name matches the specified regex
+            if (!gameFilter->search(game.name)) // Check if name matches the specified regex
                 continue;
         }
 
@@ -213,9 +218,7 @@ std::vector<gameItem> Website::getGames()
 
             if (!bDownloadDLCInfo && !Globals::globalConfig.sIgnoreDLCCountRegex.empty())
             {
-                boost::regex expression(Globals::globalConfig.sIgnoreDLCCountRegex);
-                boost::match_results<std::string::const_iterator> what;
-                if (boost::regex_search(game.name, what, expression)) // Check if name matches the specified regex
+                if (PatternMatcher::get(Globals::globalConfig.sIgnoreDLCCountRegex)->search(game.name)) // Check if name matches the specified regex
                 {
                     bDownloadDLCInfo = true;
                 }
@@ -233,14 +236,16 @@ std::vector<gameItem> Website::getGames()
             if (bDownloadDLCInfo && !Globals::globalConfig.sGameRegex.empty())
             {
                 // don't download unnecessary info if user is only interested in a subset of his account
-                boost::regex expression(Globals::globalConfig.sGameRegex);
-                boost::match_results<std::string::const_iterator> what;
-                if (!boost::regex_search(game.name, what, expression))
+                if (!gameFilter->search(game.name))
                 {
                     bDownloadDLCInfo = false;
                 }
             }
 
+            // Incremental cache update gets details only for games that are refetched
+            if (Globals::globalConfig.bUpdateCacheIncremental)
+                bDownloadDLCInfo = false;
+
             if (bDownloadDLCInfo)
             {
                 game.gamedetailsjson = this->getGameDetailsJSON(game.id);
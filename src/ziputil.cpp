@@ -633,3 +633,139 @@ bool ZipUtil::isSymlink(const uint16_t& attributes)
     bool bSymlink = ((attributes & S_IFMT) == S_IFLNK);
     return bSymlink;
 }
+
+ZipUtil::EntryExtractor::EntryExtractor(std::ostream* output_stream, const uint64_t& comp_size) : output(output_stream), comp_remaining(comp_size)
+{
+    zs = z_stream();
+    crc32 = ::crc32(0L, Z_NULL, 0);
+}
+
+ZipUtil::EntryExtractor::~EntryExtractor()
+{
+    if (bZlibInit)
+        inflateEnd(&zs);
+}
+
+int ZipUtil::EntryExtractor::parseHeader()
+{
+    std::istringstream header_stream(header);
+
+    // local file header signature <4 bytes>
+    if (readUInt32(&header_stream) != ZIP_LOCAL_HEADER_SIGNATURE)
+        return 1;
+
+    // version needed to extract <2 bytes>, general purpose bit flag <2 bytes>
+    header_stream.seekg(4, header_stream.cur);
+
+    // compression method <2 bytes>
+    compression_method = readUInt16(&header_stream);
+
+    // last mod file time, last mod file date, crc-32, compressed size, uncompressed size <16 bytes>
+    header_stream.seekg(16, header_stream.cur);
+
+    // file name length <2 bytes>, extra field length <2 bytes>
+    uint16_t filename_length = readUInt16(&header_stream);
+    uint16_t extra_length = readUInt16(&header_stream);
+    header_size = ZIP_LOCAL_HEADER_SIZE + filename_length + extra_length;
+
+    if (compression_method == boost::iostreams::zlib::deflated)
+    {
+        // Raw deflate stream, zlib header and trailing adler-32 checksum is omitted
+        if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+            return 4;
+        bZlibInit = true;
+        buffer.resize(256 << 10);
+    }
+    else if (compression_method != boost::iostreams::zlib::no_compression)
+    {
+        return 2;
+    }
+
+    return 0;
+}
+
+bool ZipUtil::EntryExtractor::writeOutput(const char* data, const size_t& size)
+{
+    if (size == 0)
+        return true;
+
+    crc32 = ::crc32(crc32, reinterpret_cast<const Bytef*>(data), size);
+    uncomp_size += size;
+    output->write(data, size);
+
+    return output->good();
+}
+
+int ZipUtil::EntryExtractor::write(const char* data, const size_t& size)
+{
+    if (result != 0 || bFinished)
+        return result;
+
+    size_t pos = 0;
+    while (!bHeaderDone && pos < size)
+    {
+        size_t len = std::min(header_size - header.size(), size - pos);
+        header.append(data + pos, len);
+        pos += len;
+
+        if (header.size() == ZIP_LOCAL_HEADER_SIZE && header_size == ZIP_LOCAL_HEADER_SIZE)
+        {
+            result = this->parseHeader();
+            if (result != 0)
+                return result;
+        }
+
+        if (header.size() == header_size)
+        {
+            bHeaderDone = true;
+            std::string().swap(header);
+            if (comp_remaining == 0)
+                bFinished = true;
+        }
+    }
+
+    while (pos < size && !bFinished)
+    {
+        size_t len = std::min(static_cast<uint64_t>(size - pos), comp_remaining);
+        size_t consumed = len;
+        if (compression_method == boost::iostreams::zlib::no_compression)
+        {
+            if (!this->writeOutput(data + pos, len))
+                return result = 3;
+        }
+        else
+        {
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data + pos));
+            zs.avail_in = len;
+            int ret;
+            do
+            {
+                zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+                zs.avail_out = buffer.size();
+                ret = inflate(&zs, Z_NO_FLUSH);
+                if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+                    return result = 4;
+
+                if (!this->writeOutput(buffer.data(), buffer.size() - zs.avail_out))
+                    return result = 3;
+            } while (ret == Z_OK && (zs.avail_in > 0 || zs.avail_out == 0));
+
+            consumed = len - zs.avail_in;
+            if (ret == Z_STREAM_END)
+                bFinished = true;
+        }
+        pos += len;
+        comp_remaining -= consumed;
+
+        if (comp_remaining == 0 && !bFinished)
+        {
+            // Stored data ends at compressed size, deflate stream must have ended there too
+            if (compression_method == boost::iostreams::zlib::no_compression)
+                bFinished = true;
+            else
+                return result = 4;
+        }
+    }
+
+    return result;
+}